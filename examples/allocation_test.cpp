@@ -0,0 +1,116 @@
+#include "nmpc.hpp"
+#include "allocation_counter.hpp"
+#include <cstdlib>
+#include <new>
+
+/** replacement global allocation functions: every allocation of the executable is counted */
+void* operator new(std::size_t size)
+{
+    ++polympc::allocation_count();
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if(!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    ++polympc::allocation_count();
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+/** damped pendulum, the full state is the output */
+class Pendulum
+{
+public:
+    Pendulum()
+    {
+        casadi::SX x = casadi::SX::sym("x", 2);
+        casadi::SX u = casadi::SX::sym("u", 1);
+        casadi::SX dynamics = casadi::SX::vertcat({x(1), -9.81 * sin(x(0)) - 0.1 * x(1) + u});
+        NumDynamics = casadi::Function("pendulum", {x, u}, {dynamics});
+        OutputMap   = casadi::Function("output", {x}, {x});
+    }
+    ~Pendulum(){}
+
+    casadi::Function getDynamics(){return NumDynamics;}
+    casadi::Function getOutputMapping(){return OutputMap;}
+
+private:
+    casadi::Function NumDynamics;
+    casadi::Function OutputMap;
+};
+
+int main(int argc, char **argv)
+{
+    /** IPOPT allocates internally: the check uses CasADi's SQP method with its own QP solver and no printing */
+    casadi::DMDict mpc_options = {{"mpc.hot_path", 1}};
+    casadi::Dict solver_options = {{"polympc.solver", "sqpmethod"}, {"qpsol", "qrqp"}, {"print_header", false},
+                                   {"print_iteration", false}, {"print_status", false}, {"print_time", false},
+                                   {"qpsol_options", casadi::Dict{{"print_iter", false}, {"print_header", false},
+                                                                  {"print_info", false}}}};
+    polympc::nmpc<Pendulum, 2, 1, 2, 3> controller(casadi::DM::zeros(2), 1.0, mpc_options, solver_options);
+    controller.setLBU(-5);
+    controller.setUBU(5);
+
+    /** warm-up: the first calls synchronize the arguments and fill the warm start */
+    Eigen::VectorXd x0(2);
+    x0 << 0.5, 0.0;
+    for(int k = 0; k < 3; ++k)
+        controller.computeControl(x0);
+
+    unsigned long allocations = 0;
+    for(int k = 0; k < 10; ++k)
+    {
+        x0[0] = 0.5 - 0.01 * k;
+        polympc::AllocationScope scope;
+        controller.computeControl(x0);
+        allocations += scope.allocations();
+    }
+
+    std::cout << "heap allocations in computeControl after warm-up: " << allocations << "\n";
+    std::cout << (allocations == 0 ? "PASSED" : "FAILED") << "\n";
+    return (allocations == 0) ? 0 : 1;
+}
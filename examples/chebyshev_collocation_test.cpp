@@ -0,0 +1,95 @@
+#include "chebyshev_collocation.hpp"
+#include "eigen3/unsupported/Eigen/KroneckerProduct"
+#include <iostream>
+#include <random>
+
+/** damped pendulum with a cubic actuator */
+struct Pendulum
+{
+    template<typename Scalar>
+    void operator()(const Eigen::Matrix<Scalar, 2, 1> &x, const Eigen::Matrix<Scalar, 1, 1> &u,
+                    Eigen::Matrix<Scalar, 2, 1> &xdot) const
+    {
+        using std::sin;
+        xdot[0] = x[1];
+        xdot[1] = -9.81 * sin(x[0]) - 0.1 * x[1] + u[0] + 0.1 * u[0] * u[0] * u[0];
+    }
+};
+
+typedef polymath::ChebyshevCollocation<Pendulum, 4, 3, 2, 1> collocation_t;
+
+/** vec(G) = kron(CompD, I) vec(X) - t_scale * vec(F(X, U)) */
+Eigen::VectorXd residual_reference(const collocation_t::states_t &X, const collocation_t::controls_t &U,
+                                   const double &t_scale)
+{
+    const int NX = 2;
+    Eigen::MatrixXd D = Eigen::MatrixXd(collocation_t::tables_t::CompD());
+    Eigen::MatrixXd I = Eigen::MatrixXd::Identity(NX, NX);
+    Eigen::MatrixXd kron_D = Eigen::kroneckerProduct(D, I);
+
+    Eigen::VectorXd F(X.size());
+    Pendulum model;
+    for(int k = 0; k < collocation_t::NumNodes; ++k)
+    {
+        Eigen::Matrix<double, 2, 1> x = X.col(k), xdot;
+        Eigen::Matrix<double, 1, 1> u = U.col(k);
+        model(x, u, xdot);
+        F.segment<2>(k * NX) = xdot;
+    }
+    return kron_D * Eigen::Map<const Eigen::VectorXd>(X.data(), X.size()) - t_scale * F;
+}
+
+int main(int argc, char **argv)
+{
+    const double t0 = 0.0, tf = 2.0;
+    const double t_scale = (tf - t0) / (2 * 3);
+    collocation_t collocation(Pendulum(), t0, tf);
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    collocation_t::states_t X = collocation_t::states_t::NullaryExpr([&](){return dist(gen);});
+    collocation_t::controls_t U = collocation_t::controls_t::NullaryExpr([&](){return dist(gen);});
+
+    /** residual against the Kronecker product formula */
+    collocation_t::residual_t G;
+    collocation.residual(X, U, G);
+    double residual_error = (Eigen::Map<const Eigen::VectorXd>(G.data(), G.size()) -
+                             residual_reference(X, U, t_scale)).cwiseAbs().maxCoeff();
+    std::cout << "residual vs kron(CompD, I) formula: max error " << residual_error << "\n";
+
+    /** Jacobian against central differences of the residual in w = [vec(X); vec(U)] */
+    collocation_t::sparse_t J;
+    collocation.jacobian(X, U, J);
+    Eigen::MatrixXd J_dense = Eigen::MatrixXd(J);
+
+    const int n_x = X.size(), n_w = X.size() + U.size();
+    const double h = 1e-6;
+    Eigen::MatrixXd J_fd(G.size(), n_w);
+    for(int j = 0; j < n_w; ++j)
+    {
+        collocation_t::states_t X_p = X, X_m = X;
+        collocation_t::controls_t U_p = U, U_m = U;
+        if(j < n_x)
+        {
+            X_p.data()[j] += h;
+            X_m.data()[j] -= h;
+        }
+        else
+        {
+            U_p.data()[j - n_x] += h;
+            U_m.data()[j - n_x] -= h;
+        }
+
+        collocation_t::residual_t G_p, G_m;
+        collocation.residual(X_p, U_p, G_p);
+        collocation.residual(X_m, U_m, G_m);
+        J_fd.col(j) = Eigen::Map<const Eigen::VectorXd>(G_p.data(), G_p.size()) / (2 * h)
+                    - Eigen::Map<const Eigen::VectorXd>(G_m.data(), G_m.size()) / (2 * h);
+    }
+    double jacobian_error = (J_dense - J_fd).cwiseAbs().maxCoeff();
+    std::cout << "jacobian vs finite differences: max error " << jacobian_error << "\n";
+
+    bool passed = (residual_error < 1e-12) && (jacobian_error < 1e-5) && (J.rows() == n_x) && (J.cols() == n_w);
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed ? 0 : 1;
+}
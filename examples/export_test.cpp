@@ -0,0 +1,88 @@
+#include "nmpc.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+/** damped pendulum, the full state is the output */
+class Pendulum
+{
+public:
+    Pendulum()
+    {
+        casadi::SX x = casadi::SX::sym("x", 2);
+        casadi::SX u = casadi::SX::sym("u", 1);
+        casadi::SX dynamics = casadi::SX::vertcat({x(1), -9.81 * sin(x(0)) - 0.1 * x(1) + u});
+        NumDynamics = casadi::Function("pendulum", {x, u}, {dynamics});
+        OutputMap   = casadi::Function("output", {x}, {x});
+    }
+    ~Pendulum(){}
+
+    casadi::Function getDynamics(){return NumDynamics;}
+    casadi::Function getOutputMapping(){return OutputMap;}
+
+private:
+    casadi::Function NumDynamics;
+    casadi::Function OutputMap;
+};
+
+/** export the controller, build <name>_bench with the C compiler and compare its first control with the
+ *  in-process solve of the same problem; usage: export_test [dir] */
+int main(int argc, char **argv)
+{
+    const std::string dir  = (argc > 1) ? argv[1] : ".";
+    const std::string name = "pendulum_mpc";
+
+    casadi::Dict solver_options = {{"ipopt.tol", 1e-8}, {"ipopt.acceptable_tol", 1e-8}, {"ipopt.print_level", 0}};
+    polympc::nmpc<Pendulum, 2, 1, 2, 3> controller(casadi::DM::zeros(2), 1.0, casadi::DMDict(), solver_options);
+    controller.setLBU(-5);
+    controller.setUBU(5);
+
+    /** the export takes the current bounds, including the fixed initial state */
+    casadi::DM x0 = casadi::DM::vertcat({0.5, 0.0});
+    controller.computeControl(x0);
+    casadi::DM controls = controller.getOptimalControl();
+    double u_process = static_cast<double>(controls(0, controls.size2() - 1));
+
+    if(!controller.exportController(dir, name))
+    {
+        std::cout << "export failed \n";
+        return 1;
+    }
+
+    const std::string bench_file = polympc::shell_quote(dir + "/" + name + "_bench");
+    const std::string compiler   = (std::getenv("CC") != NULL) ? std::getenv("CC") : "cc";
+    std::string cmd = compiler + " -O2 -o " + bench_file + " "
+                    + polympc::shell_quote(dir + "/" + name + "_bench.c") + " "
+                    + polympc::shell_quote(dir + "/" + name + "_solver.c") + " "
+                    + polympc::shell_quote(dir + "/" + name + "_kernels.c") + " -lm";
+    if(std::system(cmd.c_str()) != 0)
+    {
+        std::cout << "compilation failed: " << cmd << "\n";
+        return 1;
+    }
+
+    /** the bench prints "first control: u_0 ..." last */
+    FILE *bench = popen((bench_file + " 1").c_str(), "r");
+    if(!bench)
+    {
+        std::cout << "could not run " << bench_file << "\n";
+        return 1;
+    }
+
+    char line[512];
+    double u_export = 0;
+    bool found = false;
+    while(fgets(line, sizeof(line), bench))
+    {
+        std::cout << line;
+        found = found || (std::sscanf(line, "first control: %lf", &u_export) == 1);
+    }
+    int status = pclose(bench);
+
+    double error = std::fabs(u_export - u_process);
+    std::cout << "first control: in-process " << u_process << ", exported " << u_export << ", difference " << error << "\n";
+
+    bool passed = found && (status == 0) && (error < 1e-4 * std::max(1.0, std::fabs(u_process)));
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#include "interior_point.hpp"
+#include <random>
+
+using namespace casadi;
+
+/** random KKT system with the collocation structure: per-node Hessian blocks, node k rows couple nodes k and k + 1 */
+bool check_structured_kkt(const double &delta_c)
+{
+    const int nx = 2, nu = 2, num_segments = 3, poly_order = 3;
+    const int num_nodes = num_segments * poly_order + 1;
+    const int n = num_nodes * (nx + nu);
+    const int m = (num_nodes - 1) * nx;
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    /** node variables: states k * nx..., control num_nodes * nx + k * nu... */
+    auto node_vars = [&](const int &k)
+    {
+        std::vector<int> idx;
+        for(int i = 0; i < nx; ++i)
+            idx.push_back(k * nx + i);
+        for(int i = 0; i < nu; ++i)
+            idx.push_back(num_nodes * nx + k * nu + i);
+        return idx;
+    };
+
+    Eigen::MatrixXd H = Eigen::MatrixXd::Zero(n, n);
+    for(int k = 0; k < num_nodes; ++k)
+    {
+        std::vector<int> idx = node_vars(k);
+        Eigen::MatrixXd B = Eigen::MatrixXd::NullaryExpr(idx.size(), idx.size(), [&](){return dist(gen);});
+        B = B * B.transpose();
+        for(std::size_t i = 0; i < idx.size(); ++i)
+            for(std::size_t j = 0; j < idx.size(); ++j)
+                H(idx[i], idx[j]) = B(i, j);
+    }
+
+    Eigen::MatrixXd J = Eigen::MatrixXd::Zero(m, n);
+    for(int k = 0; k < num_nodes - 1; ++k)
+    {
+        for(int r = 0; r < nx; ++r)
+        {
+            for(int i = 0; i < nx; ++i)
+            {
+                J(k * nx + r, k * nx + i)       = dist(gen) + ((i == r) ? 2.0 : 0.0);
+                J(k * nx + r, (k + 1) * nx + i) = dist(gen);
+            }
+            for(int i = 0; i < nu; ++i)
+                J(k * nx + r, num_nodes * nx + k * nu + i) = dist(gen);
+        }
+    }
+
+    Eigen::VectorXd sigma = Eigen::VectorXd::Constant(n, 0.5) + 0.5 * Eigen::VectorXd::Random(n).cwiseAbs();
+    Eigen::VectorXd rw = Eigen::VectorXd::Random(n);
+    Eigen::VectorXd rl = Eigen::VectorXd::Random(m);
+
+    /** the initial state slot (last node) is fixed */
+    std::vector<char> fixed(n, 0);
+    for(int i = 0; i < nx; ++i)
+        fixed[(num_nodes - 1) * nx + i] = 1;
+
+    polympc::StructuredKKT::sparse_t Hs = H.sparseView(), Js = J.sparseView();
+    polympc::StructuredKKT kkt;
+    if(!kkt.init(nx, nu, num_segments, poly_order, Hs, Js) || !kkt.structured())
+    {
+        std::cout << "StructuredKKT: the collocation structure was not recognized \n";
+        return false;
+    }
+
+    Eigen::VectorXd dw, dl;
+    if(!kkt.solve(Hs, Js, sigma, delta_c, fixed, rw, rl, dw, dl))
+    {
+        std::cout << "StructuredKKT: factorization failed \n";
+        return false;
+    }
+
+    /** dense reference: fixed variables get an identity row and column and a zero right hand side */
+    Eigen::MatrixXd K = Eigen::MatrixXd::Zero(n + m, n + m);
+    Eigen::VectorXd rhs(n + m);
+    K.topLeftCorner(n, n) = H;
+    K.topLeftCorner(n, n).diagonal() += sigma;
+    K.bottomLeftCorner(m, n) = J;
+    K.topRightCorner(n, m) = J.transpose();
+    K.bottomRightCorner(m, m).diagonal().setConstant(-delta_c);
+    rhs << rw, rl;
+    for(int i = 0; i < n; ++i)
+    {
+        if(!fixed[i])
+            continue;
+        K.row(i).setZero();
+        K.col(i).setZero();
+        K(i, i) = 1.0;
+        rhs[i] = 0.0;
+    }
+
+    Eigen::VectorXd sol = K.fullPivLu().solve(rhs);
+    double error = std::max((dw - sol.head(n)).cwiseAbs().maxCoeff(), (dl - sol.tail(m)).cwiseAbs().maxCoeff());
+    std::cout << "StructuredKKT vs dense solve (delta_c = " << delta_c << "): max error " << error << "\n";
+    return error < 1e-8;
+}
+
+/** small collocation-structured NLP: x_{k+1} = x_k - 0.1 * (0.1 * x_k^3 + u_k) backwards from the fixed last node */
+bool check_nlp_solve()
+{
+    const int nx = 1, nu = 1, num_segments = 2, poly_order = 2;
+    const int num_nodes = num_segments * poly_order + 1;
+
+    SX X = SX::sym("X", num_nodes * nx);
+    SX U = SX::sym("U", num_nodes * nu);
+    SXVector rows;
+    for(int k = 0; k < num_nodes - 1; ++k)
+        rows.push_back(X(k) - X(k + 1) + 0.1 * (0.1 * pow(X(k), 3) + U(k)));
+
+    SXDict nlp = {{"x", SX::vertcat({X, U})}, {"f", SX::dot(X, X) + SX::dot(U, U)}, {"g", SX::vertcat(rows)}};
+    polympc::InteriorPointSolver solver("ip_solver", nlp, nx, nu, num_segments, poly_order, Dict{{"ipopt.tol", 1e-10}});
+
+    DM lbx = DM::repmat(-DM::inf(), num_nodes * (nx + nu), 1);
+    DM ubx = DM::repmat(DM::inf(), num_nodes * (nx + nu), 1);
+    lbx(num_nodes - 1) = 1.0;
+    ubx(num_nodes - 1) = 1.0;
+
+    DMDict res = solver(DMDict{{"x0", DM::zeros(num_nodes * (nx + nu))}, {"lbx", lbx}, {"ubx", ubx},
+                               {"lbg", DM::zeros(num_nodes - 1)}, {"ubg", DM::zeros(num_nodes - 1)}});
+    Dict stats = solver.get_stats();
+    std::cout << "InteriorPointSolver: " << stats << "\n";
+
+    double infeasibility = static_cast<double>(DM::norm_inf(res.at("g")));
+    std::cout << "constraint violation " << infeasibility << "\n";
+    return stats.at("success").as_bool() && stats.at("structured").as_bool() && (infeasibility < 1e-8);
+}
+
+int main(int argc, char **argv)
+{
+    bool kkt_ok = check_structured_kkt(0.0) && check_structured_kkt(1e-8);
+    bool nlp_ok = check_nlp_solve();
+
+    std::cout << (kkt_ok && nlp_ok ? "PASSED" : "FAILED") << "\n";
+    return (kkt_ok && nlp_ok) ? 0 : 1;
+}
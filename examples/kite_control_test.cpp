@@ -5,7 +5,8 @@ using namespace casadi;
 
 struct Path
 {
-    SXVector operator()(const SXVector &arg)
+    /** the path function is built once */
+    Path()
     {
         SX x = SX::sym("x");
         double h = M_PI / 6.0;
@@ -13,10 +14,15 @@ struct Path
         double L = 5;
         SX theta = h + a * sin(2 * x);
         SX phi   = 4 * a * cos(x);
-        SX Path  = SX::vertcat({theta, phi, L});
-        Function path = Function("path", {x}, {Path});
+        path = Function("path", {x}, {SX::vertcat({theta, phi, L})});
+    }
+
+    SXVector operator()(const SXVector &arg)
+    {
         return path(arg);
     }
+
+    Function path;
 };
 
 
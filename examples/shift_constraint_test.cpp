@@ -0,0 +1,60 @@
+#include "nmpc.hpp"
+
+/** damped pendulum, the full state is the output */
+class Pendulum
+{
+public:
+    Pendulum()
+    {
+        casadi::SX x = casadi::SX::sym("x", 2);
+        casadi::SX u = casadi::SX::sym("u", 1);
+        casadi::SX dynamics = casadi::SX::vertcat({x(1), -9.81 * sin(x(0)) - 0.1 * x(1) + u});
+        NumDynamics = casadi::Function("pendulum", {x, u}, {dynamics});
+        OutputMap   = casadi::Function("output", {x}, {x});
+    }
+    ~Pendulum(){}
+
+    casadi::Function getDynamics(){return NumDynamics;}
+    casadi::Function getOutputMapping(){return OutputMap;}
+
+private:
+    casadi::Function NumDynamics;
+    casadi::Function OutputMap;
+};
+
+/** the time-shifted warm start ("mpc.sampling_time") with path constraint multipliers in lam_g: consecutive solves,
+ *  through the DM interface and the hot path */
+bool check_consecutive_solves(const bool &hot_path)
+{
+    casadi::DMDict mpc_options = {{"mpc.sampling_time", 0.05}, {"mpc.hot_path", hot_path ? 1 : 0}};
+    casadi::Dict solver_options = {{"ipopt.print_level", 0}};
+    polympc::nmpc<Pendulum, 2, 1, 2, 3> controller(casadi::DM::zeros(2), 1.0, mpc_options, solver_options);
+    controller.setLBU(-5);
+    controller.setUBU(5);
+
+    /** speed limit |x_2| <= 2 as one inequality h(x, u) = x_2^2 - 4 <= 0 */
+    casadi::SX x = casadi::SX::sym("x", 2);
+    casadi::SX u = casadi::SX::sym("u", 1);
+    controller.addPathConstraint(casadi::Function("speed_limit", {x, u}, {x(1) * x(1) - 4}));
+
+    Eigen::VectorXd x0(2);
+    x0 << 0.5, 0.0;
+    bool success = true;
+    for(int k = 0; k < 3; ++k)
+    {
+        x0[0] -= 0.02;
+        controller.computeControl(x0);
+        success = success && (controller.getSolveStatus() == polympc::SOLVE_SUCCESS);
+    }
+
+    std::cout << (hot_path ? "hot path" : "DM interface") << ": three shifted solves "
+              << (success ? "succeeded" : "failed") << "\n";
+    return success;
+}
+
+int main(int argc, char **argv)
+{
+    bool passed = check_consecutive_solves(false) && check_consecutive_solves(true);
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+#include "solution_database.hpp"
+#include <cstdio>
+#include <random>
+
+/** record n: key (n, -n), the primal-dual values are affine in n */
+void record(const int &n, Eigen::VectorXd &key, Eigen::VectorXd &w, Eigen::VectorXd &lam_g, Eigen::VectorXd &lam_x)
+{
+    key = Eigen::Vector2d(n, -n);
+    w = Eigen::VectorXd::LinSpaced(4, n, n + 3);
+    lam_g = Eigen::VectorXd::Constant(3, 0.5 * n);
+    lam_x = Eigen::VectorXd::Constant(4, -n);
+}
+
+int main(int argc, char **argv)
+{
+    const std::string fname = (argc > 1) ? argv[1] : "solution_database_test.db";
+    const int capacity = 5, num_records = 8;
+    bool passed = true;
+
+    /** insert past the capacity: the ring buffer keeps the newest records */
+    polympc::SolutionDatabase db;
+    db.init(capacity, 2, 4, 3);
+    Eigen::VectorXd key, w, lam_g, lam_x;
+    for(int n = 0; n < num_records; ++n)
+    {
+        record(n, key, w, lam_g, lam_x);
+        db.insert(key, w, lam_g, lam_x);
+    }
+    passed = passed && (db.size() == capacity);
+
+    /** an exact key returns its record, an evicted one the closest kept record */
+    Eigen::VectorXd w_db, lam_g_db, lam_x_db;
+    Eigen::VectorXd w_ref, lam_g_ref, lam_x_ref;
+    record(num_records - 1, key, w_ref, lam_g_ref, lam_x_ref);
+    passed = passed && db.lookup(key, 1, w_db, lam_g_db, lam_x_db) && (w_db - w_ref).isZero(0);
+    record(num_records - capacity, key, w_ref, lam_g_ref, lam_x_ref);
+    passed = passed && db.lookup(Eigen::Vector2d(0, 0), 1, w_db, lam_g_db, lam_x_db) && (w_db - w_ref).isZero(0);
+    std::cout << "ring buffer: " << db.size() << " records, oldest kept " << w_db[0] << "\n";
+
+    /** round trip: a fresh database returns identical lookups */
+    passed = passed && db.save(fname);
+    polympc::SolutionDatabase loaded;
+    loaded.init(capacity, 2, 4, 3);
+    passed = passed && loaded.load(fname) && (loaded.size() == db.size());
+
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> dist(-2.0, 10.0);
+    double error = 0;
+    for(int q = 0; q < 20; ++q)
+    {
+        Eigen::Vector2d query(dist(gen), dist(gen));
+        Eigen::VectorXd w_l, lam_g_l, lam_x_l;
+        passed = passed && db.lookup(query, 3, w_db, lam_g_db, lam_x_db) && loaded.lookup(query, 3, w_l, lam_g_l, lam_x_l);
+        error = std::max(error, (w_db - w_l).cwiseAbs().maxCoeff());
+        error = std::max(error, (lam_g_db - lam_g_l).cwiseAbs().maxCoeff());
+        error = std::max(error, (lam_x_db - lam_x_l).cwiseAbs().maxCoeff());
+    }
+    passed = passed && (error == 0);
+    std::cout << "save / load round trip: max lookup difference " << error << "\n";
+
+    /** the replacement order survives the round trip: the next insert evicts the same record in both */
+    record(num_records, key, w, lam_g, lam_x);
+    db.insert(key, w, lam_g, lam_x);
+    loaded.insert(key, w, lam_g, lam_x);
+    db.lookup(Eigen::Vector2d(0, 0), 1, w_db, lam_g_db, lam_x_db);
+    Eigen::VectorXd w_l, lam_g_l, lam_x_l;
+    loaded.lookup(Eigen::Vector2d(0, 0), 1, w_l, lam_g_l, lam_x_l);
+    passed = passed && (w_db - w_l).isZero(0);
+
+    /** a rebuild with the same sizes keeps the records, a smaller capacity the newest ones */
+    loaded.init(capacity - 2, 2, 4, 3);
+    loaded.lookup(Eigen::Vector2d(0, 0), 1, w_l, lam_g_l, lam_x_l);
+    record(num_records - capacity + 3, key, w_ref, lam_g_ref, lam_x_ref);
+    passed = passed && (loaded.size() == capacity - 2) && (w_l - w_ref).isZero(0);
+    std::cout << "rebuild with capacity " << capacity - 2 << ": oldest kept " << w_l[0] << "\n";
+
+    /** a file of another problem size is rejected */
+    polympc::SolutionDatabase other;
+    other.init(capacity, 2, 5, 3);
+    bool rejected = !other.load(fname) && (other.size() == 0);
+    std::cout << "file of another problem size " << (rejected ? "rejected" : "accepted") << "\n";
+    passed = passed && rejected;
+
+    std::remove(fname.c_str());
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <atomic>
+
+/** Test hook counting heap allocations. The counter is only advanced by replacement global allocation functions,
+ *  which are defined once in the test executable (examples/allocation_test.cpp), not in this header:
+ *
+ *  polympc::AllocationScope scope;
+ *  controller.computeControl(x0);
+ *  assert(scope.allocations() == 0);
+ */
+namespace polympc {
+
+inline std::atomic<unsigned long>& allocation_count()
+{
+    static std::atomic<unsigned long> count(0);
+    return count;
+}
+
+/** number of allocations since construction */
+class AllocationScope
+{
+public:
+    AllocationScope() : m_start(allocation_count().load()) {}
+    unsigned long allocations() const {return allocation_count().load() - m_start;}
+
+private:
+    unsigned long m_start;
+};
+
+} // polympc namespace
+
+#endif // ALLOCATION_COUNTER_HPP
@@ -0,0 +1,214 @@
+#ifndef ASYNC_MPC_HPP
+#define ASYNC_MPC_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "chebyshev_tables.hpp"
+#include "integrator.h"
+
+namespace polympc {
+
+/** Runs nmpc / nmpf solves on a dedicated worker thread. Measurements are posted with setMeasurement() and return
+ *  immediately; the worker forward-predicts the state by the expected latency (if a predictor is given), solves
+ *  and publishes the optimal control polynomial through a double buffer. getControl() never blocks: it interpolates the latest published
+ *  polynomial at the requested time. The wrapped controller must not be used by other threads while running. */
+template<typename Controller>
+class AsyncController
+{
+public:
+    typedef typename Controller::control_t            control_t;
+    typedef typename Controller::control_trajectory_t control_trajectory_t;
+    typedef polymath::ChebyshevTables<Controller::PolynomialOrder, Controller::NumberOfSegments> tables;
+
+    /** 'latency' < 0 : use a running estimate of the solve time; 'predictor' integrates the first
+     *  predictor->dim_x() states with the first predictor->dim_u() controls */
+    AsyncController(Controller &controller, ODESolver *predictor = NULL, const double &latency = -1);
+    ~AsyncController(){stop();}
+
+    void start();
+    void stop();
+    bool running() const {return m_running;}
+
+    /** post a state measured at time 't' (caller's time base, seconds) */
+    void setMeasurement(const Eigen::Ref<const Eigen::VectorXd> &x, const double &t);
+
+    /** latest control applicable at time 't', false if no solution has been published yet */
+    bool getControl(const double &t, control_t &u) const;
+
+    void setLatency(const double &latency){m_latency = latency;}
+    double getLatency() const {double latency = m_latency.load(); return (latency >= 0) ? latency : m_solve_time.load();}
+
+private:
+    Controller &m_controller;
+    ODESolver  *m_predictor;
+    double      m_horizon;
+    std::atomic<double> m_latency;
+    std::atomic<double> m_solve_time;
+
+    /** single producer double buffer behind an atomic index: readers pin the published slot with a counter,
+     *  the writer fills the other slot once its readers have left */
+    struct Solution
+    {
+        control_trajectory_t controls;
+        double               t0;
+    };
+    Solution                 m_buffer[2];
+    mutable std::atomic<int> m_readers[2];
+    std::atomic<int>         m_published;
+    void publish(const control_trajectory_t &controls, const double &t0);
+    bool read(Solution &solution) const;
+
+    /** measurement handoff */
+    std::mutex               m_mutex;
+    std::condition_variable  m_cond;
+    Eigen::VectorXd          m_measurement;
+    double                   m_measurement_time;
+    bool                     m_pending;
+
+    std::atomic<bool>        m_running;
+    std::thread              m_worker;
+    void worker();
+};
+
+template<typename Controller>
+AsyncController<Controller>::AsyncController(Controller &controller, ODESolver *predictor, const double &latency) :
+    m_controller(controller), m_predictor(predictor), m_latency(latency), m_solve_time(0),
+    m_published(-1), m_measurement_time(0), m_pending(false), m_running(false)
+{
+    m_horizon = controller.getHorizon();
+    m_readers[0] = 0;
+    m_readers[1] = 0;
+}
+
+template<typename Controller>
+void AsyncController<Controller>::start()
+{
+    if(m_running)
+        return;
+    m_running = true;
+    m_worker = std::thread(&AsyncController::worker, this);
+}
+
+template<typename Controller>
+void AsyncController<Controller>::stop()
+{
+    if(!m_running)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_cond.notify_one();
+    if(m_worker.joinable())
+        m_worker.join();
+}
+
+template<typename Controller>
+void AsyncController<Controller>::setMeasurement(const Eigen::Ref<const Eigen::VectorXd> &x, const double &t)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_measurement = x;
+        m_measurement_time = t;
+        m_pending = true;
+    }
+    m_cond.notify_one();
+}
+
+template<typename Controller>
+void AsyncController<Controller>::publish(const control_trajectory_t &controls, const double &t0)
+{
+    /** write into the slot readers are not directed to, after the readers that pinned it earlier are done */
+    int slot = (m_published.load() == 0) ? 1 : 0;
+    while(m_readers[slot].load() != 0)
+        std::this_thread::yield();
+    m_buffer[slot].controls = controls;
+    m_buffer[slot].t0 = t0;
+    m_published.store(slot);
+}
+
+template<typename Controller>
+bool AsyncController<Controller>::read(Solution &solution) const
+{
+    for(;;)
+    {
+        int slot = m_published.load(std::memory_order_acquire);
+        if(slot < 0)
+            return false;
+
+        /** the pin holds if the slot is still published afterwards: the writer only fills unpublished slots */
+        m_readers[slot].fetch_add(1);
+        if(m_published.load() == slot)
+        {
+            solution = m_buffer[slot];
+            m_readers[slot].fetch_sub(1);
+            return true;
+        }
+        m_readers[slot].fetch_sub(1);
+    }
+}
+
+template<typename Controller>
+bool AsyncController<Controller>::getControl(const double &t, control_t &u) const
+{
+    Solution solution;
+    if(!read(solution))
+        return false;
+
+    int offset;
+    typename tables::nodes_t weights;
+    tables::InterpolationWeights(t - solution.t0, 0, m_horizon, offset, weights);
+    u = solution.controls.template middleCols<Controller::PolynomialOrder + 1>(offset) * weights;
+    return true;
+}
+
+template<typename Controller>
+void AsyncController<Controller>::worker()
+{
+    Eigen::VectorXd x;
+    control_t u;
+    double t_meas;
+
+    while(m_running)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]{return m_pending || !m_running;});
+            if(!m_running)
+                break;
+            x = m_measurement;
+            t_meas = m_measurement_time;
+            m_pending = false;
+        }
+
+        /** forward-predict the state to the time the new control will be applied, otherwise the solution
+         *  starts at the measurement */
+        double latency = getLatency();
+        bool predicted = m_predictor && (latency > 0);
+        if(predicted)
+        {
+            if(!getControl(t_meas, u))
+                u.setZero();
+            int nx = m_predictor->dim_x();
+            int nu = m_predictor->dim_u();
+            x.head(nx) = m_predictor->solve(x.head(nx), u.head(nu), latency).head(nx);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        m_controller.computeControl(x);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        /** running estimate of the solve time */
+        double estimate = m_solve_time.load();
+        m_solve_time = (estimate > 0) ? 0.8 * estimate + 0.2 * elapsed : elapsed;
+
+        publish(m_controller.getOptimalControlMap(), predicted ? t_meas + latency : t_meas);
+    }
+}
+
+} // polympc namespace
+
+#endif // ASYNC_MPC_HPP
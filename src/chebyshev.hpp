@@ -2,6 +2,33 @@
 #define CHEBYSHEV_HPP
 
 #include "polymath.h"
+#include "chebyshev_tables.hpp"
+
+namespace polymath
+{
+    /** cast a dense Eigen matrix to a CasADi matrix */
+    template<class BaseClass, typename Derived>
+    BaseClass eigen2casadi(const Eigen::MatrixBase<Derived> &mat)
+    {
+        Eigen::MatrixXd dense = mat;
+        std::vector<double> data(dense.data(), dense.data() + dense.size());
+        return BaseClass::reshape(BaseClass(data), dense.rows(), dense.cols());
+    }
+
+    /** cast a sparse Eigen matrix to a CasADi matrix, structural zeros are preserved */
+    template<class BaseClass>
+    BaseClass eigen2casadi(const Eigen::SparseMatrix<double> &mat)
+    {
+        casadi::DM sparse = casadi::DM::zeros(mat.rows(), mat.cols());
+        for(int k = 0; k < mat.outerSize(); ++k)
+            for(Eigen::SparseMatrix<double>::InnerIterator it(mat, k); it; ++it)
+                sparse(it.row(), it.col()) = it.value();
+        return BaseClass(casadi::DM::sparsify(sparse));
+    }
+}
+
+/** evaluation of the model at the collocation nodes: C++ loop or casadi::Function::map */
+enum CollocationMap {NO_MAP, MAP_SERIAL, MAP_UNROLL, MAP_THREAD};
 
 template<class BaseClass,
          int PolyOrder,
@@ -28,8 +55,23 @@ public:
     BaseClass CollocateDynamics(casadi::Function &dynamics, const double &t0, const double &tf);
     BaseClass CollocateCost(casadi::Function &MayerTerm, casadi::Function &LagrangeTerm,
                             const double &t0, const double &tf);
+    /** cost terms with node-wise parameters: column k of NodeParams is passed to the terms at node k */
+    BaseClass CollocateCost(casadi::Function &MayerTerm, casadi::Function &LagrangeTerm, const BaseClass &NodeParams,
+                            const double &t0, const double &tf);
     BaseClass CollocateIdCost(casadi::Function &IdCost, casadi::DM data, const double &t0, const double &tf);
 
+    /** evaluate the model over all nodes in one mapped call; only with casadi::MX the map stays a single
+     *  call node (graph size independent of the number of nodes, "thread" evaluates in parallel), SX inlines it */
+    void SetCollocationMap(const CollocationMap &mode){_map_mode = mode;}
+    CollocationMap GetCollocationMap(){return _map_mode;}
+
+    /** time instants of the collocation nodes, ordered as in the decision variables */
+    static std::vector<double> NodeTimes(const double &t0, const double &tf);
+    /** barycentric interpolation of the nodal values at given time instants */
+    static casadi::DM InterpolationMatrix(const std::vector<double> &times, const double &t0, const double &tf);
+    /** re-evaluate the nodal polynomials at the nodes shifted forward in time by 'shift' */
+    static casadi::DM ShiftOperator(const double &t0, const double &tf, const double &shift);
+
     typedef std::function<BaseClass(BaseClass, BaseClass, BaseClass)> functor;
     /** right hand side function of the ODE */
     functor _ode;
@@ -59,6 +101,9 @@ private:
 
     /** helper functions */
     BaseClass range(const uint &first, const uint &last, const uint &step);
+    casadi::Function map_nodes(const casadi::Function &func);
+
+    CollocationMap _map_mode;
 
     /** state in terms of Chebyshev coefficients */
     BaseClass _X;
@@ -84,9 +129,29 @@ Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::Chebyshev()
     _ComD        = CompDiffMatrix();
 
     /** create discretized states and controls */
-    _X = casadi::SX::sym("X", (NumSegments * PolyOrder + 1) * NX );
-    _U = casadi::SX::sym("U", (NumSegments * PolyOrder + 1) * NU );
-    _P = casadi::SX::sym("P", NP);
+    _X = BaseClass::sym("X", (NumSegments * PolyOrder + 1) * NX );
+    _U = BaseClass::sym("U", (NumSegments * PolyOrder + 1) * NU );
+    _P = BaseClass::sym("P", NP);
+
+    _map_mode = NO_MAP;
+}
+
+/** @brief vectorize a node function over all collocation nodes */
+template<class BaseClass,
+         int PolyOrder,
+         int NumSegments,
+         int NX,
+         int NU,
+         int NP>
+casadi::Function Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::map_nodes(const casadi::Function &func)
+{
+    std::string parallelization = "serial";
+    if(_map_mode == MAP_UNROLL)
+        parallelization = "unroll";
+    else if(_map_mode == MAP_THREAD)
+        parallelization = "thread";
+
+    return func.map(NumSegments * PolyOrder + 1, parallelization);
 }
 
 /** @brief range */
@@ -119,10 +184,7 @@ template<class BaseClass,
 BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CollocPoints()
 {
     /** Chebyshev collocation points for the interval [-1, 1]*/
-    auto grid_int = polymath::range<double>(0, PolyOrder);
-    /** cast grid to Casadi type */
-    BaseClass grid(grid_int);
-    BaseClass X = cos(grid * (M_PI / PolyOrder));
+    static const BaseClass X = polymath::eigen2casadi<BaseClass>(polymath::ChebyshevTables<PolyOrder, NumSegments>::Nodes());
     return X;
 }
 
@@ -135,21 +197,8 @@ template<class BaseClass,
          int NP>
 BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::DiffMatrix()
 {
-    /** Chebyshev collocation points for the interval [-1, 1]*/
-    auto grid_int = polymath::range<double>(0, PolyOrder);
-    /** cast grid to Casadi type */
-    BaseClass grid(grid_int);
-    BaseClass cpoints = cos(grid * (M_PI / PolyOrder));
-
-    /** Diff Matrix */
-    BaseClass c = BaseClass::vertcat({2, BaseClass::ones(PolyOrder - 1, 1), 2});
-    c = BaseClass::mtimes(BaseClass::diag( pow(-1, grid)), c);
-
-    BaseClass XM = BaseClass::repmat(cpoints, 1, PolyOrder + 1);
-    BaseClass dX = XM - XM.T();
-    BaseClass Dn  = BaseClass::mtimes(c, (1 / c).T() ) / (dX + (BaseClass::eye(PolyOrder + 1)));      /** off-diagonal entries */
-
-    return Dn - BaseClass::diag( BaseClass::sum1(Dn.T() ));               /**  diagonal entries */
+    static const BaseClass D = polymath::eigen2casadi<BaseClass>(polymath::ChebyshevTables<PolyOrder, NumSegments>::D());
+    return D;
 }
 
 /** @brief compute weights for Clenshaw-Curtis quadrature / ref {L. Trefethen "Spectral Methods in Matlab"}*/
@@ -161,36 +210,7 @@ template<class BaseClass,
          int NP>
 BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::QuadWeights()
 {
-    /** Chebyshev collocation points for the interval [-1, 1]*/
-    auto grid_int = polymath::range<double>(0, PolyOrder);
-    /** cast grid to Casadi type */
-    BaseClass theta(grid_int);
-    theta = theta * (M_PI / PolyOrder);
-
-    BaseClass w = BaseClass::zeros(1, PolyOrder + 1);
-    BaseClass v = BaseClass::ones(PolyOrder - 1, 1);
-
-    if ( PolyOrder % 2 == 0 )
-    {
-        w(0)         = 1 / (pow(PolyOrder, 2) - 1);
-        w(PolyOrder) = w(0);
-
-        for(int k = 1; k <= PolyOrder / 2 - 1; ++k)
-        {
-            v = v - 2 * cos(2 * k * theta(casadi::Slice(1, PolyOrder))) / (4 * pow(k, 2) - 1);
-        }
-        v = v - cos( PolyOrder * theta(casadi::Slice(1, PolyOrder))) / (pow(PolyOrder, 2) - 1);
-    }
-    else
-    {
-        w(0) = 1 / std::pow(PolyOrder, 2);
-        w(PolyOrder) = w(0);
-        for (int k = 1; k <= (PolyOrder - 1) / 2; ++k)
-        {
-            v = v - 2 * cos(2 * k * theta(casadi::Slice(1, PolyOrder))) / (4 * pow(k, 2) - 1);
-        }
-    }
-    w(casadi::Slice(1, PolyOrder)) =  2 * v / PolyOrder;
+    static const BaseClass w = polymath::eigen2casadi<BaseClass>(polymath::ChebyshevTables<PolyOrder, NumSegments>::QuadWeights());
     return w;
 }
 
@@ -203,32 +223,9 @@ template<class BaseClass,
          int NP>
 BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CompDiffMatrix()
 {
-    int comp_rows = NumSegments * PolyOrder + 1;
-    int comp_cols = NumSegments * PolyOrder + 1;
-
-    BaseClass CompDiff = BaseClass::zeros(comp_rows, comp_cols);
-    BaseClass D        = DiffMatrix();
-    BaseClass D0       = D;
-    BaseClass E        = BaseClass::eye(NX);
-
-    if(NumSegments < 2)
-    {
-        CompDiff = D0;
-    }
-    else
-    {
-        /** insert first matrix */
-        CompDiff(casadi::Slice(CompDiff.size1() - D0.size1(), CompDiff.size1()),
-                 casadi::Slice(CompDiff.size2() - D0.size2(), CompDiff.size2())) = D0;
-        /** fill in diagonal terms */
-        for(int k = 0; k < (NumSegments - 1) * PolyOrder; k += PolyOrder)
-        {
-            CompDiff(casadi::Slice(k, k + PolyOrder), casadi::Slice(k, k + PolyOrder + 1)) =
-                    D(casadi::Slice(0, PolyOrder), casadi::Slice(0, D.size2()));
-        }
-    }
-
-    return BaseClass::kron(CompDiff, E);
+    static const BaseClass CompDiff = BaseClass::kron(polymath::eigen2casadi<BaseClass>(polymath::ChebyshevTables<PolyOrder, NumSegments>::CompD()),
+                                                      BaseClass::eye(NX));
+    return CompDiff;
 }
 
 /** @brief collocate differential constraints */
@@ -244,26 +241,40 @@ BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CollocateDyn
     /** evaluate RHS at the collocation points */
     int DIMX = _X.size1();
     BaseClass F_XU = BaseClass::zeros(DIMX);
-    casadi::SXVector tmp;
+    std::vector<BaseClass> tmp;
     int j = 0;
     double t_scale = (tf - t0) / (2 * NumSegments);
 
-    for (int i = 0; i <= DIMX - NX; i += NX)
+    if(_map_mode != NO_MAP)
     {
-        if(NP == 0)
-        {
-            tmp = dynamics(casadi::SXVector{_X(casadi::Slice(i, i + NX)),
-                                            _U(casadi::Slice(j, j + NU)) });
-        }
-        else
+        const int num_nodes = NumSegments * PolyOrder + 1;
+        casadi::Function mapped = map_nodes(dynamics);
+        std::vector<BaseClass> args = {BaseClass::reshape(_X, NX, num_nodes), BaseClass::reshape(_U, NU, num_nodes)};
+        if(NP != 0)
+            args.push_back(BaseClass::repmat(_P, 1, num_nodes));
+
+        tmp  = mapped(args);
+        F_XU = t_scale * BaseClass::vec(tmp[0]);
+    }
+    else
+    {
+        for (int i = 0; i <= DIMX - NX; i += NX)
         {
-            tmp = dynamics(casadi::SXVector{_X(casadi::Slice(i, i + NX)),
-                                            _U(casadi::Slice(j, j + NU)),
-                                            _P});
-        }
+            if(NP == 0)
+            {
+                tmp = dynamics(std::vector<BaseClass>{_X(casadi::Slice(i, i + NX)),
+                                                      _U(casadi::Slice(j, j + NU)) });
+            }
+            else
+            {
+                tmp = dynamics(std::vector<BaseClass>{_X(casadi::Slice(i, i + NX)),
+                                                      _U(casadi::Slice(j, j + NU)),
+                                                      _P});
+            }
 
             F_XU(casadi::Slice(i, i + NX)) = t_scale * tmp[0];
             j += NU;
+        }
     }
 
     BaseClass G_XU = BaseClass::mtimes(_ComD, _X) - F_XU;
@@ -281,19 +292,50 @@ BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CollocateCos
                                                                                   casadi::Function &LagrangeTerm,
                                                                                   const double &t0, const double &tf)
 {
-    casadi::SXVector value;
+    return CollocateCost(MayerTerm, LagrangeTerm, BaseClass(), t0, tf);
+}
+
+/** @brief collocate cost function with node-wise parameters */
+template<class BaseClass,
+         int PolyOrder,
+         int NumSegments,
+         int NX,
+         int NU,
+         int NP>
+BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CollocateCost(casadi::Function &MayerTerm,
+                                                                                  casadi::Function &LagrangeTerm,
+                                                                                  const BaseClass &NodeParams,
+                                                                                  const double &t0, const double &tf)
+{
+    std::vector<BaseClass> value;
     BaseClass Mayer    = {0};
     BaseClass Lagrange = {0};
+    bool node_params = !NodeParams.is_empty();
 
     /** collocate Mayer term */
     if(!MayerTerm.is_null())
     {
-        value = MayerTerm(casadi::SXVector{_X(casadi::Slice(0, NX))});
+        std::vector<BaseClass> args = {_X(casadi::Slice(0, NX))};
+        if(node_params)
+            args.push_back(NodeParams(casadi::Slice(), 0));
+        value = MayerTerm(args);
         Mayer = value[0];
     }
 
-    /** collocate Lagrange term */
-    if(!LagrangeTerm.is_null())
+    /** collocate Lagrange term: one mapped evaluation weighted by the composite quadrature */
+    if(!LagrangeTerm.is_null() && (_map_mode != NO_MAP))
+    {
+        const int num_nodes = NumSegments * PolyOrder + 1;
+        double t_scale = (tf - t0) / (2 * NumSegments);
+        BaseClass node_weights = polymath::eigen2casadi<BaseClass>(polymath::ChebyshevTables<PolyOrder, NumSegments>::NodeWeights());
+
+        std::vector<BaseClass> args = {BaseClass::reshape(_X, NX, num_nodes), BaseClass::reshape(_U, NU, num_nodes)};
+        if(node_params)
+            args.push_back(NodeParams);
+        value = map_nodes(LagrangeTerm)(args);
+        Lagrange = t_scale * BaseClass::mtimes(value[0], node_weights);
+    }
+    else if(!LagrangeTerm.is_null())
     {
         /** for each segment */
         double t_scale = (tf - t0) / (2 * NumSegments);
@@ -313,11 +355,14 @@ BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CollocateCos
                     for(int n = 0; n < PolyOrder * NU; n += NU)
                         U0 += pow(-1, n) * U(casadi::Slice(n, n + NU));
 
-                    value = LagrangeTerm(casadi::SXVector{_X(casadi::Slice(i, i + NX)), U0});
+                    value = LagrangeTerm(std::vector<BaseClass>{_X(casadi::Slice(i, i + NX)), U0});
                 }
                 else
                 {
-                    value = LagrangeTerm(casadi::SXVector{_X(casadi::Slice(i, i + NX)), _U(casadi::Slice(j, j + NU))});
+                    std::vector<BaseClass> args = {_X(casadi::Slice(i, i + NX)), _U(casadi::Slice(j, j + NU))};
+                    if(node_params)
+                        args.push_back(NodeParams(casadi::Slice(), k * PolyOrder + m));
+                    value = LagrangeTerm(args);
                 }
 
                 local_int += _QuadWeights(m) * value[0];
@@ -346,16 +391,31 @@ BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CollocateIdC
     if ( (data.size1() != NX) || (data.size2() != (NumSegments * PolyOrder + 1)) )
     {
         std::cout << "CollocateIdCost: Inconsistent data size! \n";
-        return casadi::SX({0});
+        return BaseClass::zeros(1);
     }
 
     /** collocate Integral cost */
     BaseClass IntCost = {0};
-    casadi::SXVector value;
+    std::vector<BaseClass> value;
     casadi::DM _data = casadi::DM::vec(data);
     int size_x = _X.size1();
 
-    if(!IdCost.is_null())
+    /** data is given forward in time, nodes are ordered backwards */
+    if(!IdCost.is_null() && (_map_mode != NO_MAP))
+    {
+        const int num_nodes = NumSegments * PolyOrder + 1;
+        double t_scale = (tf - t0) / (2 * NumSegments);
+        BaseClass node_weights = polymath::eigen2casadi<BaseClass>(polymath::ChebyshevTables<PolyOrder, NumSegments>::NodeWeights());
+
+        casadi::DMVector columns;
+        for(int k = 0; k < num_nodes; ++k)
+            columns.push_back(data(casadi::Slice(), num_nodes - 1 - k));
+        casadi::DM data_nodes = casadi::DM::horzcat(columns);
+
+        value = map_nodes(IdCost)(std::vector<BaseClass>{BaseClass::reshape(_X, NX, num_nodes), BaseClass(data_nodes)});
+        IntCost = t_scale * BaseClass::mtimes(value[0], node_weights);
+    }
+    else if(!IdCost.is_null())
     {
         /** for each segment */
         double t_scale = (tf - t0) / (2 * NumSegments);
@@ -366,7 +426,7 @@ BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CollocateIdC
             for (int i = k * NX * PolyOrder; i <= (k + 1) * NX * PolyOrder; i += NX)
             {
                 int idx = size_x - i;
-                value = IdCost(casadi::SXVector{_X(casadi::Slice(i, i + NX)), _data(casadi::Slice(idx, idx - NX)) });
+                value = IdCost(std::vector<BaseClass>{_X(casadi::Slice(i, i + NX)), BaseClass(_data(casadi::Slice(idx - NX, idx))) });
 
                 local_int += _QuadWeights[m] * value[0];
                 ++m;
@@ -377,6 +437,68 @@ BaseClass Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::CollocateIdC
     return IntCost;
 }
 
+/** @brief time instants of the collocation nodes: node 0 is the end of the interval */
+template<class BaseClass,
+         int PolyOrder,
+         int NumSegments,
+         int NX,
+         int NU,
+         int NP>
+std::vector<double> Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::NodeTimes(const double &t0, const double &tf)
+{
+    typedef polymath::ChebyshevTables<PolyOrder, NumSegments> tables;
+    double h = (tf - t0) / NumSegments;
+    std::vector<double> times(NumSegments * PolyOrder + 1);
+    for(int k = 0; k <= NumSegments * PolyOrder; ++k)
+    {
+        int segment = std::min(k / PolyOrder, NumSegments - 1);
+        int j = k - segment * PolyOrder;
+        double t_low = tf - (segment + 1) * h;
+        times[k] = t_low + 0.5 * h * (tables::Nodes()[j] + 1);
+    }
+    return times;
+}
+
+/** @brief barycentric interpolation on the composite Chebyshev grid / ref {J.P. Berrut, L. Trefethen "Barycentric Lagrange Interpolation"}*/
+template<class BaseClass,
+         int PolyOrder,
+         int NumSegments,
+         int NX,
+         int NU,
+         int NP>
+casadi::DM Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::InterpolationMatrix(const std::vector<double> &times,
+                                                                                          const double &t0, const double &tf)
+{
+    typedef polymath::ChebyshevTables<PolyOrder, NumSegments> tables;
+    casadi::DM S = casadi::DM::zeros(times.size(), NumSegments * PolyOrder + 1);
+
+    int offset;
+    typename tables::nodes_t weights;
+    for(int i = 0; i < times.size(); ++i)
+    {
+        tables::InterpolationWeights(times[i], t0, tf, offset, weights);
+        for(int j = 0; j <= PolyOrder; ++j)
+            S(i, offset + j) = weights[j];
+    }
+    return S;
+}
+
+/** @brief shift operator for receding horizon warm start */
+template<class BaseClass,
+         int PolyOrder,
+         int NumSegments,
+         int NX,
+         int NU,
+         int NP>
+casadi::DM Chebyshev<BaseClass, PolyOrder, NumSegments, NX, NU, NP>::ShiftOperator(const double &t0, const double &tf,
+                                                                                    const double &shift)
+{
+    std::vector<double> times = NodeTimes(t0, tf);
+    for(double &t : times)
+        t += shift;
+    return InterpolationMatrix(times, t0, tf);
+}
+
 /** set up collocation function */
 template<class BaseClass,
          int PolyOrder,
@@ -0,0 +1,166 @@
+#ifndef CHEBYSHEV_COLLOCATION_HPP
+#define CHEBYSHEV_COLLOCATION_HPP
+
+#include <vector>
+#include "eigen3/Eigen/Dense"
+#include "eigen3/Eigen/Sparse"
+#include "eigen3/unsupported/Eigen/AutoDiff"
+#include "chebyshev_tables.hpp"
+
+namespace polymath
+{
+
+/** Numeric Chebyshev collocation without a symbolic runtime: fixed-size Eigen storage, the model is a functor
+ *  templated on the scalar type
+ *
+ *  struct Model
+ *  {
+ *      template<typename Scalar>
+ *      void operator()(const Eigen::Matrix<Scalar, NX, 1> &x, const Eigen::Matrix<Scalar, NU, 1> &u,
+ *                      Eigen::Matrix<Scalar, NX, 1> &xdot) const;
+ *  };
+ *
+ *  Nodes are the columns of X (NX x NumNodes) and U (NU x NumNodes), ordered as in Chebyshev (node 0 at tf), so
+ *  [vec(X); vec(U)] is the decision vector of the CasADi formulation and the residual G matches CollocateDynamics.
+ *  The residual is one small GEMM X_s * D' per segment instead of the Kronecker product with the composite matrix,
+ *  the model Jacobians come from forward-mode AutoDiffScalar with a fixed-size derivative vector. Evaluation of the
+ *  residual and of the node Jacobians does not allocate. */
+template<class Model, int PolyOrder, int NumSegments, int NX, int NU>
+class ChebyshevCollocation
+{
+public:
+    enum
+    {
+        NumNodes = NumSegments * PolyOrder + 1,
+        NZ       = NX + NU
+    };
+
+    typedef ChebyshevTables<PolyOrder, NumSegments>     tables_t;
+    typedef Eigen::Matrix<double, NX, 1>                state_t;
+    typedef Eigen::Matrix<double, NU, 1>                control_t;
+    typedef Eigen::Matrix<double, NX, NumNodes>         states_t;
+    typedef Eigen::Matrix<double, NU, NumNodes>         controls_t;
+    typedef Eigen::Matrix<double, NX, NumNodes>         residual_t;
+    typedef Eigen::Matrix<double, NX, NZ * NumNodes>    node_jacobians_t;
+    typedef Eigen::Matrix<double, 1, NumNodes>          node_values_t;
+    typedef Eigen::SparseMatrix<double>                 sparse_t;
+
+    typedef Eigen::Matrix<double, NZ, 1>                derivative_t;
+    typedef Eigen::AutoDiffScalar<derivative_t>         ad_scalar_t;
+
+    ChebyshevCollocation(const Model &model = Model(), const double &t0 = 0.0, const double &tf = 1.0)
+        : m_model(model), m_t0(t0), m_tf(tf), m_t_scale((tf - t0) / (2 * NumSegments)) {}
+    ~ChebyshevCollocation(){}
+
+    void setTimeInterval(const double &t0, const double &tf)
+    {
+        m_t0 = t0;
+        m_tf = tf;
+        m_t_scale = (tf - t0) / (2 * NumSegments);
+    }
+
+    const Model& model() const {return m_model;}
+
+    /** collocation residual G = X * CompD' - t_scale * F(X, U) */
+    void residual(const states_t &X, const controls_t &U, residual_t &G) const;
+
+    /** node-wise model Jacobians: block k (NX x NZ, columns k * NZ ...) is t_scale * [df/dx, df/du] at node k */
+    void node_jacobians(const states_t &X, const controls_t &U, node_jacobians_t &J) const;
+
+    /** residual Jacobian w.r.t. [vec(X); vec(U)] in the layout of the CasADi formulation */
+    void jacobian(const states_t &X, const controls_t &U, sparse_t &J) const;
+
+    /** composite Clenshaw-Curtis quadrature of node values over [t0, tf] */
+    double integrate(const node_values_t &values) const
+    {
+        return m_t_scale * values.dot(tables_t::NodeWeights().transpose());
+    }
+
+private:
+    Model  m_model;
+    double m_t0, m_tf, m_t_scale;
+};
+
+template<class Model, int PolyOrder, int NumSegments, int NX, int NU>
+void ChebyshevCollocation<Model, PolyOrder, NumSegments, NX, NU>::residual(const states_t &X, const controls_t &U,
+                                                                          residual_t &G) const
+{
+    const typename tables_t::diff_matrix_t &D = tables_t::D();
+
+    /** the shared boundary node belongs to the next segment, the last segment keeps all of its rows */
+    for(int k = 0; k < NumSegments - 1; ++k)
+        G.template middleCols<PolyOrder>(k * PolyOrder).noalias() =
+                X.template middleCols<PolyOrder + 1>(k * PolyOrder) * D.template topRows<PolyOrder>().transpose();
+    G.template middleCols<PolyOrder + 1>((NumSegments - 1) * PolyOrder).noalias() =
+            X.template middleCols<PolyOrder + 1>((NumSegments - 1) * PolyOrder) * D.transpose();
+
+    state_t x, xdot;
+    control_t u;
+    for(int k = 0; k < NumNodes; ++k)
+    {
+        x = X.col(k);
+        u = U.col(k);
+        m_model(x, u, xdot);
+        G.col(k) -= m_t_scale * xdot;
+    }
+}
+
+template<class Model, int PolyOrder, int NumSegments, int NX, int NU>
+void ChebyshevCollocation<Model, PolyOrder, NumSegments, NX, NU>::node_jacobians(const states_t &X, const controls_t &U,
+                                                                                node_jacobians_t &J) const
+{
+    Eigen::Matrix<ad_scalar_t, NX, 1> ad_x, ad_xdot;
+    Eigen::Matrix<ad_scalar_t, NU, 1> ad_u;
+
+    for(int k = 0; k < NumNodes; ++k)
+    {
+        for(int i = 0; i < NX; ++i)
+            ad_x[i] = ad_scalar_t(X(i, k), NZ, i);
+        for(int i = 0; i < NU; ++i)
+            ad_u[i] = ad_scalar_t(U(i, k), NZ, NX + i);
+
+        m_model(ad_x, ad_u, ad_xdot);
+
+        for(int i = 0; i < NX; ++i)
+            J.template block<1, NZ>(i, k * NZ) = m_t_scale * ad_xdot[i].derivatives().transpose();
+    }
+}
+
+template<class Model, int PolyOrder, int NumSegments, int NX, int NU>
+void ChebyshevCollocation<Model, PolyOrder, NumSegments, NX, NU>::jacobian(const states_t &X, const controls_t &U,
+                                                                          sparse_t &J) const
+{
+    node_jacobians_t J_nodes;
+    node_jacobians(X, U, J_nodes);
+
+    const typename tables_t::comp_diff_matrix_t &CompD = tables_t::CompD();
+    const int n_x = NX * NumNodes;
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(CompD.nonZeros() * NX + NumNodes * NX * NZ);
+
+    /** differentiation part: kron(CompD, I) */
+    for(int c = 0; c < CompD.outerSize(); ++c)
+        for(typename tables_t::comp_diff_matrix_t::InnerIterator it(CompD, c); it; ++it)
+            for(int i = 0; i < NX; ++i)
+                triplets.push_back(Eigen::Triplet<double>(it.row() * NX + i, it.col() * NX + i, it.value()));
+
+    /** model part: one dense block per node */
+    for(int k = 0; k < NumNodes; ++k)
+    {
+        for(int i = 0; i < NX; ++i)
+        {
+            for(int j = 0; j < NX; ++j)
+                triplets.push_back(Eigen::Triplet<double>(k * NX + i, k * NX + j, -J_nodes(i, k * NZ + j)));
+            for(int j = 0; j < NU; ++j)
+                triplets.push_back(Eigen::Triplet<double>(k * NX + i, n_x + k * NU + j, -J_nodes(i, k * NZ + NX + j)));
+        }
+    }
+
+    J.resize(n_x, n_x + NU * NumNodes);
+    J.setFromTriplets(triplets.begin(), triplets.end());
+}
+
+}
+
+#endif // CHEBYSHEV_COLLOCATION_HPP
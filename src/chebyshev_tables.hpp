@@ -0,0 +1,205 @@
+#ifndef CHEBYSHEV_TABLES_HPP
+#define CHEBYSHEV_TABLES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "eigen3/Eigen/Dense"
+#include "eigen3/Eigen/Sparse"
+
+namespace polymath
+{
+
+/** Numeric Chebyshev-Gauss-Lobatto tables on [-1, 1], computed once per (PolyOrder, NumSegments)
+ *  and shared by all collocation schemes. Nodes are ordered as in the decision variables: x_j = cos(j * pi / N) */
+template<int PolyOrder, int NumSegments = 1>
+struct ChebyshevTables
+{
+    enum
+    {
+        NumNodes = NumSegments * PolyOrder + 1
+    };
+
+    typedef Eigen::Matrix<double, PolyOrder + 1, 1>             nodes_t;
+    typedef Eigen::Matrix<double, PolyOrder + 1, PolyOrder + 1> diff_matrix_t;
+    typedef Eigen::Matrix<double, 1, PolyOrder + 1>             quad_weights_t;
+    typedef Eigen::SparseMatrix<double>                         comp_diff_matrix_t;
+    typedef Eigen::Matrix<double, NumNodes, 1>                  node_weights_t;
+
+    /** collocation points */
+    static const nodes_t& Nodes()
+    {
+        static const nodes_t nodes = compute_nodes();
+        return nodes;
+    }
+
+    /** differentiation matrix */
+    static const diff_matrix_t& D()
+    {
+        static const diff_matrix_t D = compute_diff_matrix();
+        return D;
+    }
+
+    /** Clenshaw-Curtis quadrature weights */
+    static const quad_weights_t& QuadWeights()
+    {
+        static const quad_weights_t weights = compute_quad_weights();
+        return weights;
+    }
+
+    /** barycentric interpolation weights */
+    static const nodes_t& BaryWeights()
+    {
+        static const nodes_t weights = compute_bary_weights();
+        return weights;
+    }
+
+    /** composite differentiation matrix (one state component) */
+    static const comp_diff_matrix_t& CompD()
+    {
+        static const comp_diff_matrix_t D = compute_comp_diff_matrix();
+        return D;
+    }
+
+    /** quadrature weights of the composite grid: shared boundary nodes collect both segments */
+    static const node_weights_t& NodeWeights()
+    {
+        static const node_weights_t weights = compute_node_weights();
+        return weights;
+    }
+
+    /** barycentric interpolation on the composite grid over [t0, tf] (node 0 at tf): the value at time 't' is
+     *  weights' * values(offset : offset + PolyOrder), times outside of the interval are clamped. Does not allocate */
+    static void InterpolationWeights(const double &t, const double &t0, const double &tf, int &offset, nodes_t &weights)
+    {
+        const nodes_t &w   = BaryWeights();
+        const nodes_t &tau = Nodes();
+
+        double h = (tf - t0) / NumSegments;
+        double t_c = std::max(t0, std::min(tf, t));
+        int segment = std::max(0, std::min(NumSegments - 1, static_cast<int>(std::floor((tf - t_c) / h))));
+        double t_low = tf - (segment + 1) * h;
+        double s = 2 * (t_c - t_low) / h - 1;
+        offset = segment * PolyOrder;
+
+        double denom = 0;
+        for(int j = 0; j <= PolyOrder; ++j)
+        {
+            if(std::fabs(s - tau[j]) < 1e-14)
+            {
+                weights.setZero();
+                weights[j] = 1;
+                return;
+            }
+            weights[j] = w[j] / (s - tau[j]);
+            denom += weights[j];
+        }
+        weights /= denom;
+    }
+
+private:
+    static nodes_t compute_nodes()
+    {
+        nodes_t x;
+        for(int j = 0; j <= PolyOrder; ++j)
+            x[j] = std::cos(j * M_PI / PolyOrder);
+        return x;
+    }
+
+    /** ref {L. Trefethen "Spectral Methods in Matlab"} */
+    static diff_matrix_t compute_diff_matrix()
+    {
+        const nodes_t x = compute_nodes();
+        nodes_t c;
+        for(int i = 0; i <= PolyOrder; ++i)
+            c[i] = ((i % 2 == 0) ? 1.0 : -1.0) * (((i == 0) || (i == PolyOrder)) ? 2.0 : 1.0);
+
+        diff_matrix_t D = diff_matrix_t::Zero();
+        for(int i = 0; i <= PolyOrder; ++i)
+        {
+            double diag = 0;
+            for(int j = 0; j <= PolyOrder; ++j)
+            {
+                if(i == j)
+                    continue;
+                D(i, j) = (c[i] / c[j]) / (x[i] - x[j]);
+                diag -= D(i, j);
+            }
+            D(i, i) = diag;
+        }
+        return D;
+    }
+
+    /** ref {L. Trefethen "Spectral Methods in Matlab"} */
+    static quad_weights_t compute_quad_weights()
+    {
+        quad_weights_t w = quad_weights_t::Zero();
+        const int N = PolyOrder;
+        std::vector<double> v(N + 1, 1.0);
+
+        if(N % 2 == 0)
+        {
+            w[0] = 1.0 / (N * N - 1);
+            for(int k = 1; k <= N / 2 - 1; ++k)
+                for(int i = 1; i < N; ++i)
+                    v[i] -= 2 * std::cos(2 * k * i * M_PI / N) / (4 * k * k - 1);
+            for(int i = 1; i < N; ++i)
+                v[i] -= std::cos(N * i * M_PI / N) / (N * N - 1);
+        }
+        else
+        {
+            w[0] = 1.0 / (N * N);
+            for(int k = 1; k <= (N - 1) / 2; ++k)
+                for(int i = 1; i < N; ++i)
+                    v[i] -= 2 * std::cos(2 * k * i * M_PI / N) / (4 * k * k - 1);
+        }
+        w[N] = w[0];
+        for(int i = 1; i < N; ++i)
+            w[i] = 2 * v[i] / N;
+        return w;
+    }
+
+    /** ref {J.P. Berrut, L. Trefethen "Barycentric Lagrange Interpolation"} */
+    static nodes_t compute_bary_weights()
+    {
+        nodes_t w;
+        for(int j = 0; j <= PolyOrder; ++j)
+            w[j] = ((j % 2 == 0) ? 1.0 : -1.0) * (((j == 0) || (j == PolyOrder)) ? 0.5 : 1.0);
+        return w;
+    }
+
+    static comp_diff_matrix_t compute_comp_diff_matrix()
+    {
+        const diff_matrix_t D = compute_diff_matrix();
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(NumSegments * (PolyOrder + 1) * (PolyOrder + 1));
+
+        /** the last segment keeps all rows, the others drop the row of the shared boundary node */
+        const int last = (NumSegments - 1) * PolyOrder;
+        for(int i = 0; i <= PolyOrder; ++i)
+            for(int j = 0; j <= PolyOrder; ++j)
+                triplets.push_back(Eigen::Triplet<double>(last + i, last + j, D(i, j)));
+
+        for(int k = 0; k < last; k += PolyOrder)
+            for(int i = 0; i < PolyOrder; ++i)
+                for(int j = 0; j <= PolyOrder; ++j)
+                    triplets.push_back(Eigen::Triplet<double>(k + i, k + j, D(i, j)));
+
+        comp_diff_matrix_t CompD(NumNodes, NumNodes);
+        CompD.setFromTriplets(triplets.begin(), triplets.end());
+        return CompD;
+    }
+
+    static node_weights_t compute_node_weights()
+    {
+        const quad_weights_t w = compute_quad_weights();
+        node_weights_t weights = node_weights_t::Zero();
+        for(int k = 0; k < NumSegments; ++k)
+            weights.template segment<PolyOrder + 1>(k * PolyOrder) += w.transpose();
+        return weights;
+    }
+};
+
+}
+
+#endif // CHEBYSHEV_TABLES_HPP
@@ -0,0 +1,174 @@
+#ifndef CONTROLLER_EXPORT_HPP
+#define CONTROLLER_EXPORT_HPP
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "casadi/casadi.hpp"
+#include "export_templates.hpp"
+
+namespace polympc {
+
+/** configured controller problem: the NLP of the controller with its current arguments */
+struct ControllerExport
+{
+    casadi::SXDict nlp;
+    casadi::DM lbx, ubx, lbg, ubg;
+    casadi::DM w0, p0;
+    /** physical state -> NLP units, NLP units -> physical control */
+    casadi::DM state_scaling, control_scaling;
+    /** position of the initial state and of the first control in w */
+    int state_index, control_index;
+    int nx, nu;
+    std::vector<double> node_times;
+    /** "ipopt.tol", "ipopt.max_iter" are used */
+    casadi::Dict opts;
+};
+
+namespace export_detail {
+
+inline std::string c_number(const double &value)
+{
+    if(std::isinf(value))
+        return (value > 0) ? "INFINITY" : "-INFINITY";
+    std::ostringstream out;
+    out << std::setprecision(17) << value;
+    return out.str();
+}
+
+inline std::string c_array(const std::string &name, const std::vector<double> &values)
+{
+    std::ostringstream out;
+    out << "static const double " << name << "[" << std::max<std::size_t>(values.size(), 1) << "] = {";
+    for(std::size_t k = 0; k < values.size(); ++k)
+        out << ((k == 0) ? "" : ",") << ((k % 8 == 0) ? "\n    " : " ") << c_number(values[k]);
+    out << (values.empty() ? "0" : "") << "\n};\n";
+    return out.str();
+}
+
+inline std::string c_array(const std::string &name, const std::vector<int> &values)
+{
+    std::ostringstream out;
+    out << "static const int " << name << "[" << std::max<std::size_t>(values.size(), 1) << "] = {";
+    for(std::size_t k = 0; k < values.size(); ++k)
+        out << ((k == 0) ? "" : ",") << ((k % 16 == 0) ? "\n    " : " ") << values[k];
+    out << (values.empty() ? "0" : "") << "\n};\n";
+    return out.str();
+}
+
+inline std::vector<double> dense(const casadi::DM &M)
+{
+    return casadi::DM::densify(M).nonzeros();
+}
+
+inline bool write_file(const std::string &fname, const std::string &text)
+{
+    std::ofstream file(fname);
+    if(!file.is_open())
+    {
+        std::cout << "export_controller: could not write " << fname << "\n";
+        return false;
+    }
+    file << text;
+    return file.good();
+}
+
+} // export_detail namespace
+
+/** Export a configured controller as a self-contained C library in 'dir': <name>.h (API), <name>_kernels.c/h (NLP
+ *  function, derivatives and Hessian of the Lagrangian generated by CasADi, the Chebyshev tables are constants in
+ *  them), <name>_solver.c (interior point method with a dense KKT factorization, the algorithm of
+ *  InteriorPointMethod) and <name>_bench.c. Sizes are fixed at export time, all buffers are static: no heap, no
+ *  exceptions, no dependencies besides libm. Inequality rows of g get slack variables. */
+inline bool export_controller(const std::string &dir, const std::string &name, const ControllerExport &problem)
+{
+    using namespace export_detail;
+
+    casadi::SX w = problem.nlp.at("x");
+    casadi::SX p = (problem.nlp.find("p") != problem.nlp.end()) ? problem.nlp.at("p") : casadi::SX::sym("p", 0);
+    casadi::SX f = problem.nlp.at("f");
+    casadi::SX g = problem.nlp.at("g");
+    const casadi_int n_w = w.size1();
+    const casadi_int n_g = g.size1();
+    const casadi_int n_p = p.size1();
+
+    /** kernels with dense outputs: the solver works on statically sized dense buffers */
+    casadi::SX lam = casadi::SX::sym("lam", n_g);
+    casadi::Function fg(name + "_fg", {w, p}, {f, g});
+    casadi::Function derivatives(name + "_derivatives", {w, p, lam},
+                                 {f, g, casadi::SX::gradient(f, w), casadi::SX::densify(casadi::SX::jacobian(g, w)),
+                                  casadi::SX::densify(casadi::SX::hessian(f + casadi::SX::dot(lam, g), w))});
+
+    try
+    {
+        casadi::CodeGenerator gen(name + "_kernels.c", casadi::Dict{{"with_header", true}});
+        gen.add(fg);
+        gen.add(derivatives);
+        gen.generate(dir + "/");
+    }
+    catch(std::exception &e)
+    {
+        std::cout << "export_controller: code generation failed: " << e.what() << "\n";
+        return false;
+    }
+
+    /** equality rows are kept, inequality rows get a slack variable */
+    std::vector<double> lbg = dense(problem.lbg), ubg = dense(problem.ubg);
+    std::vector<int> ineq_rows;
+    for(casadi_int j = 0; j < n_g; ++j)
+        if(ubg[j] - lbg[j] > 1e-12)
+            ineq_rows.push_back(j);
+
+    double tol = 1e-8;
+    int max_iter = 100;
+    if(problem.opts.find("ipopt.tol") != problem.opts.end())
+        tol = problem.opts.at("ipopt.tol").to_double();
+    if(problem.opts.find("ipopt.max_iter") != problem.opts.end())
+        max_iter = problem.opts.at("ipopt.max_iter").to_int();
+
+    std::ostringstream data;
+    data << c_array("lbx_default", dense(problem.lbx))
+         << c_array("ubx_default", dense(problem.ubx))
+         << c_array("lbg", lbg)
+         << c_array("ubg", ubg)
+         << c_array("ineq_rows", ineq_rows)
+         << c_array("w_init", dense(problem.w0))
+         << c_array("p_default", dense(problem.p0))
+         << c_array("node_times", problem.node_times)
+         << c_array("state_scaling", dense(problem.state_scaling))
+         << c_array("control_scaling", dense(problem.control_scaling));
+
+    const std::size_t sz_iw = std::max(fg.sz_iw(), derivatives.sz_iw());
+    const std::size_t sz_w  = std::max(fg.sz_w(), derivatives.sz_w());
+
+    std::map<std::string, std::string> values = {
+        {"NAME", name},
+        {"NW", std::to_string(n_w)},
+        {"NG", std::to_string(n_g)},
+        {"NP", std::to_string(n_p)},
+        {"NS", std::to_string(ineq_rows.size())},
+        {"NG_BUF", std::to_string(std::max<casadi_int>(n_g, 1))},
+        {"NP_BUF", std::to_string(std::max<casadi_int>(n_p, 1))},
+        {"NS_BUF", std::to_string(std::max<std::size_t>(ineq_rows.size(), 1))},
+        {"NX", std::to_string(problem.nx)},
+        {"NU", std::to_string(problem.nu)},
+        {"NUM_NODES", std::to_string(problem.node_times.size())},
+        {"STATE_INDEX", std::to_string(problem.state_index)},
+        {"CONTROL_INDEX", std::to_string(problem.control_index)},
+        {"TOL", c_number(tol)},
+        {"MAX_ITER", std::to_string(max_iter)},
+        {"SZ_ARG", std::to_string(std::max(fg.sz_arg(), derivatives.sz_arg()))},
+        {"SZ_RES", std::to_string(std::max(fg.sz_res(), derivatives.sz_res()))},
+        {"SZ_IW_BUF", std::to_string(std::max<std::size_t>(sz_iw, 1))},
+        {"SZ_W_BUF", std::to_string(std::max<std::size_t>(sz_w, 1))},
+        {"DATA", data.str()}};
+
+    return write_file(dir + "/" + name + ".h", export_templates::substitute(export_templates::header, values)) &&
+           write_file(dir + "/" + name + "_solver.c", export_templates::substitute(export_templates::solver, values)) &&
+           write_file(dir + "/" + name + "_bench.c", export_templates::substitute(export_templates::bench, values));
+}
+
+} // polympc namespace
+
+#endif // CONTROLLER_EXPORT_HPP
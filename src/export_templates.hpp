@@ -0,0 +1,674 @@
+#ifndef EXPORT_TEMPLATES_HPP
+#define EXPORT_TEMPLATES_HPP
+
+#include <map>
+#include <string>
+
+namespace polympc {
+
+/** C sources of an exported controller. Placeholders: @NAME@ (prefix of all symbols), @NW@, @NG@, @NP@, @NS@ (number
+ *  of inequality rows of g), @NX@, @NU@, @NUM_NODES@, @STATE_INDEX@, @CONTROL_INDEX@, @TOL@, @MAX_ITER@, the buffer
+ *  sizes @SZ_ARG@, @SZ_RES@, @SZ_IW_BUF@, @SZ_W_BUF@ of the generated kernels and @DATA@ (constant tables). Array
+ *  sizes use the *_BUF variants, which are at least one: C has no empty arrays. */
+namespace export_templates {
+
+static const std::string header = R"CODE(/* @NAME@: model predictive controller exported by polympc.
+ *
+ * Self-contained C99: generated NLP kernels (@NAME@_kernels.c), a primal-dual interior point solver with a dense
+ * KKT factorization (@NAME@_solver.c) and a benchmark (@NAME@_bench.c). All memory is static, there is one solver
+ * instance per library and the functions are not reentrant. No heap, no external dependencies besides libm:
+ *
+ *     cc -O2 -o @NAME@_bench @NAME@_bench.c @NAME@_solver.c @NAME@_kernels.c -lm
+ *
+ * Decision variables w = [X; U] (node-major, node 0 at the end of the horizon), NLP units (scaled).
+ */
+#ifndef @NAME@_H
+#define @NAME@_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define @NAME@_NW            @NW@
+#define @NAME@_NG            @NG@
+#define @NAME@_NP            @NP@
+#define @NAME@_NX            @NX@
+#define @NAME@_NU            @NU@
+#define @NAME@_NUM_NODES     @NUM_NODES@
+#define @NAME@_STATE_INDEX   @STATE_INDEX@
+#define @NAME@_CONTROL_INDEX @CONTROL_INDEX@
+
+enum
+{
+    @NAME@_SOLVE_SUCCEEDED = 0,
+    @NAME@_MAX_ITER_EXCEEDED = 1,
+    @NAME@_STEP_FAILED = 2,
+    @NAME@_EVALUATION_FAILED = 3
+};
+
+typedef struct
+{
+    int    status;
+    int    iter_count;
+    double f;
+} @NAME@_stats_t;
+
+/** initial guess, bounds and parameters of the export, the next solve is cold-started */
+void @NAME@_reset(void);
+/** NLP parameters (@NAME@_NP values) */
+void @NAME@_set_parameters(const double *p);
+/** bounds of the decision variables (@NAME@_NW values each, NLP units) */
+void @NAME@_set_bounds(const double *lbx, const double *ubx);
+/** solve from the last solution and multipliers, returns the status */
+int @NAME@_solve(@NAME@_stats_t *stats);
+/** fix the initial state (@NAME@_NX values, physical units), solve and return the first control (physical units) */
+int @NAME@_control(const double *state, double *control, @NAME@_stats_t *stats);
+/** last solution (@NAME@_NW values) */
+const double* @NAME@_solution(void);
+/** first control of the last solution (@NAME@_NU values, physical units) */
+void @NAME@_first_control(double *control);
+/** time instants of the collocation nodes (@NAME@_NUM_NODES values) */
+const double* @NAME@_node_times(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* @NAME@_H */
+)CODE";
+
+static const std::string solver = R"CODE(/* @NAME@: interior point solver, see @NAME@.h */
+#include <math.h>
+#include "@NAME@.h"
+#include "@NAME@_kernels.h"
+
+#define NW @NW@
+#define NG @NG@
+#define NP @NP@
+#define NS @NS@
+#define NZ (NW + NS)
+#define NK (NZ + NG)
+#define NG_BUF @NG_BUF@
+#define NP_BUF @NP_BUF@
+#define NS_BUF @NS_BUF@
+
+#define TOL      @TOL@
+#define MAX_ITER @MAX_ITER@
+
+/* ---- constant tables of the export ---- */
+@DATA@
+/* ---- solver state ---- */
+static double p[NP_BUF];
+static double lbz[NZ], ubz[NZ], has_lb[NZ], has_ub[NZ];
+static char   fixed[NZ];
+static double z[NZ], zl[NZ], zu[NZ], lam[NG_BUF];
+static int    warm;
+
+/* ---- work buffers ---- */
+static double f_val, f_trial;
+static double g[NG_BUF], grad[NW], J[NG_BUF * NW], H[NW * NW];
+static double c[NG_BUF], c_trial[NG_BUF], g_trial[NG_BUF];
+static double sl[NZ], su[NZ], r_d[NZ], sigma[NZ], barrier_grad[NZ];
+static double dz[NZ], dzl[NZ], dzu[NZ], dl[NG_BUF], z_trial[NZ];
+static double K[NK * NK], sol[NK];
+static int    piv[NK];
+
+static const casadi_real *kernel_arg[@SZ_ARG@];
+static casadi_real       *kernel_res[@SZ_RES@];
+static casadi_int         kernel_iw[@SZ_IW_BUF@];
+static casadi_real        kernel_w[@SZ_W_BUF@];
+
+/* f, g, grad_f, dense dg/dw (column-major), dense Hessian of f + lam' g */
+static int eval_derivatives(void)
+{
+    kernel_arg[0] = z; kernel_arg[1] = p; kernel_arg[2] = lam;
+    kernel_res[0] = &f_val; kernel_res[1] = g; kernel_res[2] = grad; kernel_res[3] = J; kernel_res[4] = H;
+    return @NAME@_derivatives(kernel_arg, kernel_res, kernel_iw, kernel_w, 0);
+}
+
+static int eval_objective(const double *w, double *f, double *gw)
+{
+    kernel_arg[0] = w; kernel_arg[1] = p;
+    kernel_res[0] = f; kernel_res[1] = gw;
+    return @NAME@_fg(kernel_arg, kernel_res, kernel_iw, kernel_w, 0);
+}
+
+/* equalities: g - lbg, inequalities: g - s with the slack s in [lbg, ubg] */
+static void constraints(const double *zz, const double *gw, double *cz)
+{
+    int j, k;
+    for(j = 0; j < NG; ++j)
+        cz[j] = gw[j] - lbg[j];
+    for(k = 0; k < NS; ++k)
+        cz[ineq_rows[k]] = gw[ineq_rows[k]] - zz[NW + k];
+}
+
+static double norm_inf(const double *v, int n)
+{
+    double r = 0;
+    int i;
+    for(i = 0; i < n; ++i)
+        r = fmax(r, fabs(v[i]));
+    return r;
+}
+
+static double norm_1(const double *v, int n)
+{
+    double r = 0;
+    int i;
+    for(i = 0; i < n; ++i)
+        r += fabs(v[i]);
+    return r;
+}
+
+static void slacks(const double *zz, double *s_l, double *s_u)
+{
+    int i;
+    for(i = 0; i < NZ; ++i)
+    {
+        s_l[i] = has_lb[i] ? zz[i] - lbz[i] : 1.0;
+        s_u[i] = has_ub[i] ? ubz[i] - zz[i] : 1.0;
+    }
+}
+
+/* in-place LU factorization with partial pivoting, row-major */
+static int lu_factor(double *A, int *perm, int n)
+{
+    int i, j, k;
+    for(k = 0; k < n; ++k)
+    {
+        int p_row = k;
+        double p_val = fabs(A[k * n + k]);
+        for(i = k + 1; i < n; ++i)
+        {
+            if(fabs(A[i * n + k]) > p_val)
+            {
+                p_val = fabs(A[i * n + k]);
+                p_row = i;
+            }
+        }
+        perm[k] = p_row;
+        if(p_val < 1e-300)
+            return 1;
+        if(p_row != k)
+        {
+            for(j = 0; j < n; ++j)
+            {
+                double tmp = A[k * n + j];
+                A[k * n + j] = A[p_row * n + j];
+                A[p_row * n + j] = tmp;
+            }
+        }
+        for(i = k + 1; i < n; ++i)
+        {
+            double l = A[i * n + k] / A[k * n + k];
+            A[i * n + k] = l;
+            if(l == 0)
+                continue;
+            for(j = k + 1; j < n; ++j)
+                A[i * n + j] -= l * A[k * n + j];
+        }
+    }
+    return 0;
+}
+
+static void lu_solve(const double *A, const int *perm, int n, double *b)
+{
+    int i, j;
+    for(i = 0; i < n; ++i)
+    {
+        double tmp = b[i];
+        b[i] = b[perm[i]];
+        b[perm[i]] = tmp;
+    }
+    for(i = 0; i < n; ++i)
+        for(j = 0; j < i; ++j)
+            b[i] -= A[i * n + j] * b[j];
+    for(i = n - 1; i >= 0; --i)
+    {
+        for(j = i + 1; j < n; ++j)
+            b[i] -= A[i * n + j] * b[j];
+        b[i] /= A[i * n + i];
+    }
+}
+
+/* Newton step of the barrier problem: [H + Sigma + delta_w I, A'; A, -delta_c I] [dz; dl] = [-(barrier_grad + A' lam); -c],
+ * A = [J, -E], fixed variables are eliminated */
+static int newton_step(double delta_w)
+{
+    int i, j, k;
+    const double delta_c = (delta_w > 0) ? 1e-8 : 0;
+
+    for(i = 0; i < NK * NK; ++i)
+        K[i] = 0;
+    for(i = 0; i < NW; ++i)
+        for(j = 0; j < NW; ++j)
+            K[i * NK + j] = H[i + j * NW];
+    for(i = 0; i < NZ; ++i)
+        K[i * NK + i] += sigma[i] + delta_w;
+    for(j = 0; j < NG; ++j)
+    {
+        for(i = 0; i < NW; ++i)
+        {
+            K[(NZ + j) * NK + i] = J[j + i * NG];
+            K[i * NK + NZ + j]   = J[j + i * NG];
+        }
+        K[(NZ + j) * NK + NZ + j] = -delta_c;
+    }
+    for(k = 0; k < NS; ++k)
+    {
+        K[(NZ + ineq_rows[k]) * NK + NW + k] = -1;
+        K[(NW + k) * NK + NZ + ineq_rows[k]] = -1;
+    }
+
+    for(i = 0; i < NZ; ++i)
+    {
+        double s = barrier_grad[i];
+        if(i < NW)
+            for(j = 0; j < NG; ++j)
+                s += J[j + i * NG] * lam[j];
+        sol[i] = -s;
+    }
+    for(k = 0; k < NS; ++k)
+        sol[NW + k] += lam[ineq_rows[k]];
+    for(j = 0; j < NG; ++j)
+        sol[NZ + j] = -c[j];
+
+    for(i = 0; i < NZ; ++i)
+    {
+        if(!fixed[i])
+            continue;
+        for(j = 0; j < NK; ++j)
+        {
+            K[i * NK + j] = 0;
+            K[j * NK + i] = 0;
+        }
+        K[i * NK + i] = 1;
+        sol[i] = 0;
+    }
+
+    if(lu_factor(K, piv, NK))
+        return 1;
+    lu_solve(K, piv, NK, sol);
+    for(i = 0; i < NZ; ++i)
+        dz[i] = sol[i];
+    for(j = 0; j < NG; ++j)
+        dl[j] = sol[NZ + j];
+
+    /* the step has to be a descent direction: nonnegative curvature of the regularized Hessian */
+    {
+        double curvature = 0, norm2 = 0;
+        for(i = 0; i < NW; ++i)
+        {
+            double hd = 0;
+            for(j = 0; j < NW; ++j)
+                hd += H[i + j * NW] * dz[j];
+            curvature += dz[i] * hd;
+        }
+        for(i = 0; i < NZ; ++i)
+        {
+            curvature += (sigma[i] + delta_w) * dz[i] * dz[i];
+            norm2 += dz[i] * dz[i];
+        }
+        return (curvature >= -1e-12 * norm2) ? 0 : 2;
+    }
+}
+
+static double merit(double f, const double *cz, const double *s_l, const double *s_u, double mu, double nu)
+{
+    double phi = f + nu * norm_1(cz, NG);
+    int i;
+    for(i = 0; i < NZ; ++i)
+    {
+        if(has_lb[i])
+            phi -= mu * log(s_l[i]);
+        if(has_ub[i])
+            phi -= mu * log(s_u[i]);
+    }
+    return phi;
+}
+
+void @NAME@_reset(void)
+{
+    int i, k;
+    for(i = 0; i < NP; ++i)
+        p[i] = p_default[i];
+    for(i = 0; i < NW; ++i)
+    {
+        z[i]   = w_init[i];
+        lbz[i] = lbx_default[i];
+        ubz[i] = ubx_default[i];
+    }
+    for(k = 0; k < NS; ++k)
+    {
+        lbz[NW + k] = lbg[ineq_rows[k]];
+        ubz[NW + k] = ubg[ineq_rows[k]];
+        z[NW + k]   = 0;
+    }
+    for(i = 0; i < NZ; ++i)
+        zl[i] = zu[i] = 0;
+    for(i = 0; i < NG; ++i)
+        lam[i] = 0;
+    warm = 0;
+
+    /* slack start: constraint values at the initial guess */
+    if((NS > 0) && (eval_objective(z, &f_val, g) == 0))
+        for(k = 0; k < NS; ++k)
+            z[NW + k] = g[ineq_rows[k]];
+}
+
+void @NAME@_set_parameters(const double *p_new)
+{
+    int i;
+    for(i = 0; i < NP; ++i)
+        p[i] = p_new[i];
+}
+
+void @NAME@_set_bounds(const double *lbx, const double *ubx)
+{
+    int i;
+    for(i = 0; i < NW; ++i)
+    {
+        lbz[i] = lbx[i];
+        ubz[i] = ubx[i];
+    }
+}
+
+const double* @NAME@_solution(void)
+{
+    return z;
+}
+
+const double* @NAME@_node_times(void)
+{
+    return node_times;
+}
+
+int @NAME@_solve(@NAME@_stats_t *stats)
+{
+    int i, j, iter, status = @NAME@_MAX_ITER_EXCEEDED;
+    double mu, nu = 1.0, delta_w = 0, delta_w_last = 0;
+
+    /* fixed variables, finite bounds and a strictly interior starting point */
+    for(i = 0; i < NZ; ++i)
+    {
+        double width = ubz[i] - lbz[i];
+        fixed[i] = (width < 1e-12);
+        if(fixed[i])
+        {
+            z[i] = lbz[i];
+            has_lb[i] = has_ub[i] = 0;
+            continue;
+        }
+        has_lb[i] = isinf(lbz[i]) ? 0 : 1;
+        has_ub[i] = isinf(ubz[i]) ? 0 : 1;
+        if(has_lb[i])
+            z[i] = fmax(z[i], lbz[i] + fmin(1e-2 * fmax(1.0, fabs(lbz[i])), 1e-2 * width));
+        if(has_ub[i])
+            z[i] = fmin(z[i], ubz[i] - fmin(1e-2 * fmax(1.0, fabs(ubz[i])), 1e-2 * width));
+    }
+
+    /* a warm start begins with a small barrier parameter */
+    mu = warm ? fmax(TOL, 1e-4) : 1e-1;
+    slacks(z, sl, su);
+    for(i = 0; i < NZ; ++i)
+    {
+        zl[i] = has_lb[i] ? fmax(mu / sl[i], warm ? zl[i] : 0) : 0;
+        zu[i] = has_ub[i] ? fmax(mu / su[i], warm ? zu[i] : 0) : 0;
+    }
+
+    for(iter = 0; iter <= MAX_ITER; ++iter)
+    {
+        double scale_d, error, inf_c, inf_d, alpha, alpha_max = 1, alpha_z = 1, tau, phi, slope, step_norm;
+        int attempt, solved = 0, ls;
+
+        if(eval_derivatives())
+        {
+            status = @NAME@_EVALUATION_FAILED;
+            break;
+        }
+        constraints(z, g, c);
+
+        /* optimality conditions */
+        for(i = 0; i < NZ; ++i)
+        {
+            double s = (i < NW) ? grad[i] : 0;
+            if(i < NW)
+                for(j = 0; j < NG; ++j)
+                    s += J[j + i * NG] * lam[j];
+            r_d[i] = s - zl[i] + zu[i];
+        }
+        for(j = 0; j < NS; ++j)
+            r_d[NW + j] -= lam[ineq_rows[j]];
+        for(i = 0; i < NZ; ++i)
+            if(fixed[i])
+                r_d[i] = 0;
+
+        scale_d = fmax(1.0, (norm_1(lam, NG) + norm_1(zl, NZ) + norm_1(zu, NZ)) / (100.0 * (NZ + NG)));
+        inf_d = norm_inf(r_d, NZ);
+        inf_c = 0;
+        for(i = 0; i < NZ; ++i)
+            inf_c = fmax(inf_c, fmax(has_lb[i] * sl[i] * zl[i], has_ub[i] * su[i] * zu[i]));
+        error = fmax(inf_d / scale_d, fmax(norm_inf(c, NG), inf_c / scale_d));
+        if(error <= TOL)
+        {
+            status = @NAME@_SOLVE_SUCCEEDED;
+            break;
+        }
+        if(iter == MAX_ITER)
+            break;
+
+        /* barrier update: monotone Fiacco-McCormick */
+        for(;;)
+        {
+            double e_mu = 0;
+            for(i = 0; i < NZ; ++i)
+                e_mu = fmax(e_mu, fmax(fabs(has_lb[i] * (sl[i] * zl[i] - mu)), fabs(has_ub[i] * (su[i] * zu[i] - mu))));
+            e_mu = fmax(inf_d / scale_d, fmax(norm_inf(c, NG), e_mu / scale_d));
+            if((e_mu > 10 * mu) || (mu <= TOL / 10))
+                break;
+            mu = fmax(TOL / 10, fmin(0.2 * mu, pow(mu, 1.5)));
+        }
+
+        for(i = 0; i < NZ; ++i)
+        {
+            sigma[i] = has_lb[i] * zl[i] / sl[i] + has_ub[i] * zu[i] / su[i];
+            barrier_grad[i] = ((i < NW) ? grad[i] : 0) - has_lb[i] * mu / sl[i] + has_ub[i] * mu / su[i];
+        }
+
+        /* Newton step, regularized until it is a descent direction */
+        delta_w = 0;
+        for(attempt = 0; attempt < 20; ++attempt)
+        {
+            if(newton_step(delta_w) == 0)
+            {
+                solved = 1;
+                break;
+            }
+            delta_w = (delta_w == 0) ? ((delta_w_last == 0) ? 1e-4 : fmax(1e-20, delta_w_last / 3)) : 8 * delta_w;
+        }
+        delta_w_last = delta_w;
+        if(!solved)
+        {
+            status = @NAME@_STEP_FAILED;
+            break;
+        }
+
+        /* bound multipliers and fraction to the boundary */
+        tau = fmax(0.99, 1 - mu);
+        for(i = 0; i < NZ; ++i)
+        {
+            dzl[i] = has_lb[i] * (mu / sl[i] - zl[i] - zl[i] / sl[i] * dz[i]);
+            dzu[i] = has_ub[i] * (mu / su[i] - zu[i] + zu[i] / su[i] * dz[i]);
+            if(has_lb[i] && dz[i] < 0)
+                alpha_max = fmin(alpha_max, -tau * sl[i] / dz[i]);
+            if(has_ub[i] && dz[i] > 0)
+                alpha_max = fmin(alpha_max, tau * su[i] / dz[i]);
+            if(has_lb[i] && dzl[i] < 0)
+                alpha_z = fmin(alpha_z, -tau * zl[i] / dzl[i]);
+            if(has_ub[i] && dzu[i] < 0)
+                alpha_z = fmin(alpha_z, -tau * zu[i] / dzu[i]);
+        }
+
+        /* backtracking on the l1 merit function */
+        for(j = 0; j < NG; ++j)
+            nu = fmax(nu, fabs(lam[j] + dl[j]) + 1);
+        phi = merit(f_val, c, sl, su, mu, nu);
+        slope = -nu * norm_1(c, NG);
+        for(i = 0; i < NZ; ++i)
+            slope += barrier_grad[i] * dz[i];
+
+        alpha = alpha_max;
+        for(ls = 0; ls < 40; ++ls)
+        {
+            for(i = 0; i < NZ; ++i)
+                z_trial[i] = z[i] + alpha * dz[i];
+            if(eval_objective(z_trial, &f_trial, g_trial) == 0)
+            {
+                double phi_trial;
+                constraints(z_trial, g_trial, c_trial);
+                slacks(z_trial, sl, su);
+                phi_trial = merit(f_trial, c_trial, sl, su, mu, nu);
+                if(isfinite(phi_trial) && (phi_trial <= phi + 1e-4 * alpha * fmin(slope, 0.0)))
+                    break;
+            }
+            alpha *= 0.5;
+        }
+
+        step_norm = alpha * norm_inf(dz, NZ);
+        if(step_norm < 1e-16 * (1 + norm_inf(z, NZ)))
+        {
+            slacks(z, sl, su);
+            status = @NAME@_STEP_FAILED;
+            break;
+        }
+
+        for(i = 0; i < NZ; ++i)
+            z[i] = z_trial[i];
+        for(j = 0; j < NG; ++j)
+            lam[j] += alpha * dl[j];
+        slacks(z, sl, su);
+
+        /* keep the bound multipliers close to the central path */
+        for(i = 0; i < NZ; ++i)
+        {
+            zl[i] += alpha_z * dzl[i];
+            zu[i] += alpha_z * dzu[i];
+            if(has_lb[i])
+                zl[i] = fmax(fmin(zl[i], 1e10 * mu / sl[i]), mu / (1e10 * sl[i]));
+            if(has_ub[i])
+                zu[i] = fmax(fmin(zu[i], 1e10 * mu / su[i]), mu / (1e10 * su[i]));
+        }
+    }
+
+    warm = (status == @NAME@_SOLVE_SUCCEEDED);
+    if(stats)
+    {
+        stats->status     = status;
+        stats->iter_count = iter;
+        stats->f          = f_val;
+    }
+    return status;
+}
+
+int @NAME@_control(const double *state, double *control, @NAME@_stats_t *stats)
+{
+    int i, j, status;
+    for(i = 0; i < @NAME@_NX; ++i)
+    {
+        double x = 0;
+        for(j = 0; j < @NAME@_NX; ++j)
+            x += state_scaling[i + j * @NAME@_NX] * state[j];
+        lbz[@NAME@_STATE_INDEX + i] = x;
+        ubz[@NAME@_STATE_INDEX + i] = x;
+    }
+
+    status = @NAME@_solve(stats);
+    @NAME@_first_control(control);
+    return status;
+}
+
+void @NAME@_first_control(double *control)
+{
+    int i, j;
+    for(i = 0; i < @NAME@_NU; ++i)
+    {
+        double u = 0;
+        for(j = 0; j < @NAME@_NU; ++j)
+            u += control_scaling[i + j * @NAME@_NU] * z[@NAME@_CONTROL_INDEX + j];
+        control[i] = u;
+    }
+}
+)CODE";
+
+static const std::string bench = R"CODE(/* @NAME@: benchmark of the exported controller, usage: @NAME@_bench [runs] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "@NAME@.h"
+
+int main(int argc, char **argv)
+{
+    int runs = (argc > 1) ? atoi(argv[1]) : 100;
+    int k, iter_cold = 0, iter_warm = 0, fail = 0;
+    double t_cold = 0, t_warm = 0, control[@NAME@_NU];
+    @NAME@_stats_t stats;
+
+    if(runs < 1)
+        runs = 1;
+
+    for(k = 0; k < runs; ++k)
+    {
+        clock_t start;
+
+        /* cold start from the exported initial guess */
+        @NAME@_reset();
+        start = clock();
+        fail += (@NAME@_solve(&stats) != @NAME@_SOLVE_SUCCEEDED);
+        t_cold += (double)(clock() - start) / CLOCKS_PER_SEC;
+        iter_cold += stats.iter_count;
+
+        /* warm start from the solution */
+        start = clock();
+        fail += (@NAME@_solve(&stats) != @NAME@_SOLVE_SUCCEEDED);
+        t_warm += (double)(clock() - start) / CLOCKS_PER_SEC;
+        iter_warm += stats.iter_count;
+    }
+
+    printf("@NAME@: %d runs, NW = %d, NG = %d\n", runs, @NAME@_NW, @NAME@_NG);
+    printf("cold start: %10.3f ms, %6.1f iterations\n", 1e3 * t_cold / runs, (double)iter_cold / runs);
+    printf("warm start: %10.3f ms, %6.1f iterations\n", 1e3 * t_warm / runs, (double)iter_warm / runs);
+    printf("failed solves: %d, objective: %g\n", fail, stats.f);
+
+    /* first control of the exported problem, e.g. to compare it with the in-process solve */
+    @NAME@_first_control(control);
+    printf("first control:");
+    for(k = 0; k < @NAME@_NU; ++k)
+        printf(" %.17g", control[k]);
+    printf("\n");
+    return fail ? 1 : 0;
+}
+)CODE";
+
+/** replace every "@KEY@" by its value */
+inline std::string substitute(const std::string &text, const std::map<std::string, std::string> &values)
+{
+    std::string result = text;
+    for(const auto &value : values)
+    {
+        const std::string key = "@" + value.first + "@";
+        std::size_t pos = 0;
+        while((pos = result.find(key, pos)) != std::string::npos)
+        {
+            result.replace(pos, key.size(), value.second);
+            pos += value.second.size();
+        }
+    }
+    return result;
+}
+
+} // export_templates namespace
+
+} // polympc namespace
+
+#endif // EXPORT_TEMPLATES_HPP
@@ -271,3 +271,12 @@ DM ODESolver::solve(const DM &x0, const DM &u, const double &dt)
 
     return solution;
 }
+
+Eigen::Map<const Eigen::VectorXd> ODESolver::solve(const Eigen::Ref<const Eigen::VectorXd> &x0,
+                                                   const Eigen::Ref<const Eigen::VectorXd> &u, const double &dt)
+{
+    DM solution = solve(DM(std::vector<double>(x0.data(), x0.data() + x0.size())),
+                        DM(std::vector<double>(u.data(), u.data() + u.size())), dt);
+    Solution = DM::densify(solution).nonzeros();
+    return Eigen::Map<const Eigen::VectorXd>(Solution.data(), Solution.size());
+}
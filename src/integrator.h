@@ -2,8 +2,12 @@
 #define INTEGRATOR_H
 
 #include "casadi/casadi.hpp"
+#include <iomanip>
+#include <sstream>
+#include <typeinfo>
 #include "eigen3/Eigen/Dense"
 #include "chebyshev.hpp"
+#include "nlp_cache.hpp"
 
 /** Solve ODE of the form : xdot = f(x, u) */
 class ODESolver
@@ -13,6 +17,9 @@ public:
     virtual ~ODESolver(){}
 
     casadi::DM solve(const casadi::DM &x0, const casadi::DM &u, const double &dt);
+    /** Eigen overload: returns a view into the internal solution buffer, valid until the next call */
+    Eigen::Map<const Eigen::VectorXd> solve(const Eigen::Ref<const Eigen::VectorXd> &x0,
+                                            const Eigen::Ref<const Eigen::VectorXd> &u, const double &dt);
 
     void updateParams(const casadi::Dict &params);
     casadi::Dict getParams(){return Parameters;}
@@ -38,6 +45,9 @@ private:
     bool             Restart;
     bool             UseWarmStart;
 
+    /** numeric solution buffer for the Eigen interface */
+    std::vector<double> Solution;
+
     /** stats */
     double           accuracy;
     int              num_iterations;
@@ -96,8 +106,11 @@ PSODESolver<PolyOrder, NumSegments, NX, NU>::PSODESolver(casadi::Function ODE, c
     if(props.find("R") != props.end())
         R = props.find("R")->second;
 
-    Chebyshev<casadi::SX, PolyOrder, NumSegments, NX, NU, 0>spectral;
+    CollocationMap collocation_map = NO_MAP;
+    if(props.find("collocation_map") != props.end())
+        collocation_map = static_cast<CollocationMap>(static_cast<int>(props.find("collocation_map")->second.nonzeros()[0]));
 
+    casadi::Function NodeODE = ODE;
     if(scale)
     {
         casadi::SX z = casadi::SX::sym("z", NX);
@@ -107,24 +120,11 @@ PSODESolver<PolyOrder, NumSegments, NX, NU>::PSODESolver(casadi::Function ODE, c
 
         casadi::SX SODE = ODE(casadi::SXVector{casadi::SX::mtimes(invP,z), casadi::SX::mtimes(invR, r)})[0];
         SODE = casadi::SX::mtimes(P, SODE);
-        casadi::Function FunSODE = casadi::Function("scaled_ode", {z, r}, {SODE});
-
-        G = spectral.CollocateDynamics(FunSODE, 0, dt);
-    }
-    else
-    {
-        G = spectral.CollocateDynamics(ODE, 0, dt);
+        NodeODE = casadi::Function("scaled_ode", {z, r}, {SODE});
     }
 
-    G = G(casadi::Slice(0, G.size1() - NX), 0);
-
-    casadi::SX varx = spectral.VarX();
-    casadi::SX varu = spectral.VarU();
-
-    opt_var = casadi::SX::vertcat(casadi::SXVector{varx, varu});
-
-    casadi::SX lbg = casadi::SX::zeros(G.size());
-    casadi::SX ubg = casadi::SX::zeros(G.size());
+    casadi::SX lbg = casadi::SX::zeros(NumSegments * PolyOrder * NX);
+    casadi::SX ubg = casadi::SX::zeros(NumSegments * PolyOrder * NX);
 
     /** set inequality (box) constraints */
     /** state */
@@ -141,18 +141,51 @@ PSODESolver<PolyOrder, NumSegments, NX, NU>::PSODESolver(casadi::Function ODE, c
     lbx = casadi::SX::vertcat( {lbx, casadi::SX::repmat(LBU, (NumSegments * PolyOrder + 1), 1)} );
     ubx = casadi::SX::vertcat( {ubx, casadi::SX::repmat(UBU, (NumSegments * PolyOrder + 1), 1)} );
 
-    /** formulate NLP */
-    NLP["x"] = opt_var;
-    NLP["f"] = 1e-3 * casadi::SX::dot(G,G);
-    NLP["g"] = G;
-
     OPTS["ipopt.linear_solver"]  = "ma97";
     OPTS["ipopt.print_level"]    = 5;
     OPTS["ipopt.tol"]            = 1e-4;
     OPTS["ipopt.acceptable_tol"] = 1e-4;
     OPTS["ipopt.max_iter"]       = 3000;
     OPTS["ipopt.hessian_approximation"] = "limited-memory";
-    NLP_Solver = nlpsol("solver", "ipopt", NLP, OPTS);
+
+    /** the compiled solver is identified by the node ODE, the discretization and the options */
+    std::ostringstream problem_key;
+    problem_key << std::setprecision(17) << typeid(*this).name() << " " << dt << " " << collocation_map << " "
+                << polympc::function_fingerprint(NodeODE) << " " << OPTS;
+
+    /** a mapped collocation stays one map node in MX up to nlpsol, SX would inline it node by node */
+    if(collocation_map != NO_MAP)
+    {
+        Chebyshev<casadi::MX, PolyOrder, NumSegments, NX, NU, 0> spectral;
+        spectral.SetCollocationMap(collocation_map);
+
+        casadi::MX G_mx = spectral.CollocateDynamics(NodeODE, 0, dt);
+        G_mx = G_mx(casadi::Slice(0, G_mx.size1() - NX), 0);
+
+        /** formulate NLP */
+        casadi::MXDict nlp;
+        nlp["x"] = casadi::MX::vertcat(casadi::MXVector{spectral.VarX(), spectral.VarU()});
+        nlp["f"] = 1e-3 * casadi::MX::dot(G_mx, G_mx);
+        nlp["g"] = G_mx;
+        NLP_Solver = polympc::cached_nlpsol("solver", "ipopt", nlp, problem_key.str(), OPTS);
+    }
+    else
+    {
+        Chebyshev<casadi::SX, PolyOrder, NumSegments, NX, NU, 0> spectral;
+        G = spectral.CollocateDynamics(NodeODE, 0, dt);
+        G = G(casadi::Slice(0, G.size1() - NX), 0);
+
+        casadi::SX varx = spectral.VarX();
+        casadi::SX varu = spectral.VarU();
+
+        opt_var = casadi::SX::vertcat(casadi::SXVector{varx, varu});
+
+        /** formulate NLP */
+        NLP["x"] = opt_var;
+        NLP["f"] = 1e-3 * casadi::SX::dot(G,G);
+        NLP["g"] = G;
+        NLP_Solver = polympc::cached_nlpsol("solver", "ipopt", NLP, problem_key.str(), OPTS);
+    }
 
     std::cout << "problem set \n";
 
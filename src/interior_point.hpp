@@ -0,0 +1,235 @@
+#ifndef INTERIOR_POINT_HPP
+#define INTERIOR_POINT_HPP
+
+#include <memory>
+#include <mutex>
+#include "casadi/casadi.hpp"
+#include "interior_point_method.hpp"
+
+namespace polympc {
+
+/** Structure-exploiting NLP solver for collocated optimal control problems: InteriorPointMethod on the derivatives
+ *  of an SX NLP, the KKT systems are factorized segment by segment (StructuredKKT), so the cost is linear in the
+ *  number of segments. The function has the nlpsol signature and replaces casadi::nlpsol("ipopt") in the controllers.
+ *  Only equality constraints lbg == ubg are supported. Options (IPOPT names): "ipopt.tol", "ipopt.max_iter",
+ *  "ipopt.print_level"; all other options are ignored. */
+class InteriorPointSolver : public casadi::Callback
+{
+public:
+    InteriorPointSolver(const std::string &name, const casadi::SXDict &nlp, const int &nx, const int &nu,
+                        const int &num_segments, const int &poly_order, const casadi::Dict &opts = casadi::Dict());
+    ~InteriorPointSolver(){}
+
+    casadi_int get_n_in() override {return casadi::nlpsol_n_in();}
+    casadi_int get_n_out() override {return casadi::nlpsol_n_out();}
+    std::string get_name_in(casadi_int i) override {return casadi::nlpsol_in(i);}
+    std::string get_name_out(casadi_int i) override {return casadi::nlpsol_out(i);}
+    casadi::Sparsity get_sparsity_in(casadi_int i) override;
+    casadi::Sparsity get_sparsity_out(casadi_int i) override;
+
+    std::vector<casadi::DM> eval(const std::vector<casadi::DM> &arg) const override;
+
+    /** statistics of the last solve on the calling thread: "return_status", "success", "iter_count", "structured" */
+    casadi::Dict get_stats() const {return last_stats();}
+    bool structured() const {return m_kkt.structured();}
+
+private:
+    casadi_int m_nw, m_ng, m_np;
+    IPSettings m_settings;
+
+    /** derivatives of the NLP: {w, p, lam_g} -> {f, g, grad_f, jac_g, hess_lag} and {w, p} -> {f, g} */
+    casadi::Function m_derivatives;
+    casadi::Function m_objective;
+
+    /** partition template; eval() is const and may run concurrently (shared solver cores, BatchController), every
+     *  call checks out a KKT workspace of its own and returns it to the pool */
+    StructuredKKT m_kkt;
+    mutable std::mutex m_pool_mutex;
+    mutable std::vector<std::unique_ptr<StructuredKKT>> m_pool;
+    std::unique_ptr<StructuredKKT> acquire_kkt() const;
+    void release_kkt(std::unique_ptr<StructuredKKT> kkt) const;
+
+    static casadi::Dict& last_stats();
+
+    static StructuredKKT::sparse_t to_sparse(const casadi::DM &M);
+    static Eigen::VectorXd to_vector(const casadi::DM &v);
+    static casadi::DM to_dm(const Eigen::VectorXd &v);
+};
+
+inline InteriorPointSolver::InteriorPointSolver(const std::string &name, const casadi::SXDict &nlp, const int &nx, const int &nu,
+                                                const int &num_segments, const int &poly_order, const casadi::Dict &opts)
+{
+    casadi::SX w = nlp.at("x");
+    casadi::SX p = (nlp.find("p") != nlp.end()) ? nlp.at("p") : casadi::SX::sym("p", 0);
+    casadi::SX f = nlp.at("f");
+    casadi::SX g = nlp.at("g");
+
+    m_nw = w.size1();
+    m_ng = g.size1();
+    m_np = p.size1();
+
+    casadi::SX lam = casadi::SX::sym("lam", m_ng);
+    casadi::SX lagrangian = f + casadi::SX::dot(lam, g);
+    casadi::SX jac_g  = casadi::SX::jacobian(g, w);
+    casadi::SX hess_l = casadi::SX::hessian(lagrangian, w);
+
+    m_derivatives = casadi::Function(name + "_derivatives", {w, p, lam}, {f, g, casadi::SX::gradient(f, w), jac_g, hess_l});
+    m_objective   = casadi::Function(name + "_objective", {w, p}, {f, g});
+
+    if(opts.find("ipopt.tol") != opts.end())
+        m_settings.tol = opts.at("ipopt.tol").to_double();
+    if(opts.find("ipopt.max_iter") != opts.end())
+        m_settings.max_iter = opts.at("ipopt.max_iter").to_int();
+    if(opts.find("ipopt.print_level") != opts.end())
+        m_settings.print_level = opts.at("ipopt.print_level").to_int();
+
+    /** the partition is checked once against the sparsity patterns */
+    casadi::DM H_pattern = casadi::DM::ones(hess_l.sparsity());
+    casadi::DM J_pattern = casadi::DM::ones(jac_g.sparsity());
+    if(!m_kkt.init(nx, nu, num_segments, poly_order, to_sparse(H_pattern), to_sparse(J_pattern)))
+        std::cout << "InteriorPointSolver: unexpected sparsity, using a general sparse factorization \n";
+
+    construct(name, casadi::Dict());
+}
+
+inline std::unique_ptr<StructuredKKT> InteriorPointSolver::acquire_kkt() const
+{
+    std::lock_guard<std::mutex> lock(m_pool_mutex);
+    if(m_pool.empty())
+        return std::unique_ptr<StructuredKKT>(new StructuredKKT(m_kkt));
+
+    std::unique_ptr<StructuredKKT> kkt = std::move(m_pool.back());
+    m_pool.pop_back();
+    return kkt;
+}
+
+inline void InteriorPointSolver::release_kkt(std::unique_ptr<StructuredKKT> kkt) const
+{
+    std::lock_guard<std::mutex> lock(m_pool_mutex);
+    m_pool.push_back(std::move(kkt));
+}
+
+inline casadi::Dict& InteriorPointSolver::last_stats()
+{
+    static thread_local casadi::Dict stats;
+    return stats;
+}
+
+inline casadi::Sparsity InteriorPointSolver::get_sparsity_in(casadi_int i)
+{
+    std::string name = casadi::nlpsol_in(i);
+    if(name == "p")
+        return casadi::Sparsity::dense(m_np);
+    else if(name == "lbg" || name == "ubg" || name == "lam_g0")
+        return casadi::Sparsity::dense(m_ng);
+    else
+        return casadi::Sparsity::dense(m_nw);
+}
+
+inline casadi::Sparsity InteriorPointSolver::get_sparsity_out(casadi_int i)
+{
+    std::string name = casadi::nlpsol_out(i);
+    if(name == "f")
+        return casadi::Sparsity::scalar();
+    else if(name == "g" || name == "lam_g")
+        return casadi::Sparsity::dense(m_ng);
+    else if(name == "lam_p")
+        return casadi::Sparsity::dense(m_np);
+    else
+        return casadi::Sparsity::dense(m_nw);
+}
+
+inline StructuredKKT::sparse_t InteriorPointSolver::to_sparse(const casadi::DM &M)
+{
+    const casadi_int *colind = M.sparsity().colind();
+    const casadi_int *row    = M.sparsity().row();
+    const std::vector<double> &nz = M.nonzeros();
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(nz.size());
+    for(casadi_int c = 0; c < M.size2(); ++c)
+        for(casadi_int k = colind[c]; k < colind[c + 1]; ++k)
+            triplets.push_back(Eigen::Triplet<double>(row[k], c, nz[k]));
+
+    StructuredKKT::sparse_t A(M.size1(), M.size2());
+    A.setFromTriplets(triplets.begin(), triplets.end());
+    return A;
+}
+
+inline Eigen::VectorXd InteriorPointSolver::to_vector(const casadi::DM &v)
+{
+    std::vector<double> data = casadi::DM::densify(v).nonzeros();
+    return Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+}
+
+inline casadi::DM InteriorPointSolver::to_dm(const Eigen::VectorXd &v)
+{
+    return casadi::DM(std::vector<double>(v.data(), v.data() + v.size()));
+}
+
+inline std::vector<casadi::DM> InteriorPointSolver::eval(const std::vector<casadi::DM> &arg) const
+{
+    casadi::DM p = arg.at(index_in("p"));
+    Eigen::VectorXd w    = to_vector(arg.at(index_in("x0")));
+    Eigen::VectorXd lbx  = to_vector(arg.at(index_in("lbx")));
+    Eigen::VectorXd ubx  = to_vector(arg.at(index_in("ubx")));
+    Eigen::VectorXd lbg  = to_vector(arg.at(index_in("lbg")));
+    Eigen::VectorXd ubg  = to_vector(arg.at(index_in("ubg")));
+    Eigen::VectorXd lam  = to_vector(arg.at(index_in("lam_g0")));
+    Eigen::VectorXd lamx = to_vector(arg.at(index_in("lam_x0")));
+
+    IPResult result;
+    if((m_ng > 0) && ((lbg - ubg).cwiseAbs().maxCoeff() > 0))
+    {
+        std::cout << "InteriorPointSolver: only equality constraints g(w) = lbg = ubg are supported \n";
+        result.status     = "Invalid_Option";
+        result.success    = false;
+        result.iter_count = 0;
+    }
+    else
+    {
+        InteriorPointMethod::derivatives_t derivatives = [&](const Eigen::VectorXd &x, const Eigen::VectorXd &l, double &f,
+                                                             Eigen::VectorXd &g, Eigen::VectorXd &grad,
+                                                             StructuredKKT::sparse_t &J, StructuredKKT::sparse_t &H)
+        {
+            std::vector<casadi::DM> res = m_derivatives(std::vector<casadi::DM>{to_dm(x), p, to_dm(l)});
+            f    = static_cast<double>(res[0]);
+            g    = to_vector(res[1]);
+            grad = to_vector(res[2]);
+            J    = to_sparse(res[3]);
+            H    = to_sparse(res[4]);
+        };
+        InteriorPointMethod::objective_t objective = [&](const Eigen::VectorXd &x, double &f, Eigen::VectorXd &g)
+        {
+            std::vector<casadi::DM> res = m_objective(std::vector<casadi::DM>{to_dm(x), p});
+            f = static_cast<double>(res[0]);
+            g = to_vector(res[1]);
+        };
+
+        std::unique_ptr<StructuredKKT> kkt = acquire_kkt();
+        result = InteriorPointMethod::solve(derivatives, objective, *kkt, m_settings, lbx, ubx, lbg, w, lam, lamx);
+        release_kkt(std::move(kkt));
+    }
+
+    casadi::Dict &stats = last_stats();
+    stats.clear();
+    stats["return_status"] = result.status;
+    stats["success"]       = result.success;
+    stats["iter_count"]    = result.iter_count;
+    stats["structured"]    = m_kkt.structured();
+
+    /** outputs in the nlpsol order */
+    std::vector<casadi::DM> fg = m_objective(std::vector<casadi::DM>{to_dm(w), p});
+    std::vector<casadi::DM> out(n_out());
+    out[index_out("x")]     = to_dm(w);
+    out[index_out("f")]     = fg[0];
+    out[index_out("g")]     = fg[1];
+    out[index_out("lam_x")] = to_dm(lamx);
+    out[index_out("lam_g")] = to_dm(lam);
+    out[index_out("lam_p")] = casadi::DM::zeros(m_np);
+    return out;
+}
+
+} // polympc namespace
+
+#endif // INTERIOR_POINT_HPP
@@ -0,0 +1,253 @@
+#ifndef INTERIOR_POINT_METHOD_HPP
+#define INTERIOR_POINT_METHOD_HPP
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include "structured_kkt.hpp"
+
+namespace polympc {
+
+struct IPSettings
+{
+    IPSettings() : tol(1e-8), max_iter(100), print_level(0) {}
+    double tol;
+    int    max_iter;
+    int    print_level;   /**< iteration output for print_level > 2 */
+};
+
+struct IPResult
+{
+    std::string status;
+    bool        success;
+    int         iter_count;
+};
+
+/** Primal-dual interior point method for
+ *
+ *  min f(w)  s.t.  g(w) = lbg,  lbx <= w <= ubx
+ *
+ *  The bounds are handled with a logarithmic barrier and a monotone barrier update, the Newton steps are solved with
+ *  StructuredKKT. Globalization: l1 merit function with backtracking and a fraction-to-boundary rule, the Hessian is
+ *  regularized until the step has nonnegative curvature. Variables with lbx == ubx are fixed. The multipliers follow
+ *  the nlpsol convention grad_f + J' lam + lam_x = 0, nonzero initial multipliers are treated as a warm start. */
+class InteriorPointMethod
+{
+public:
+    typedef StructuredKKT::sparse_t sparse_t;
+
+    /** (w, lam) -> f, g, grad_f, J = dg/dw, H = hessian of f + lam' g */
+    typedef std::function<void(const Eigen::VectorXd&, const Eigen::VectorXd&, double&, Eigen::VectorXd&,
+                               Eigen::VectorXd&, sparse_t&, sparse_t&)> derivatives_t;
+    /** w -> f, g */
+    typedef std::function<void(const Eigen::VectorXd&, double&, Eigen::VectorXd&)> objective_t;
+
+    static IPResult solve(const derivatives_t &derivatives, const objective_t &objective, StructuredKKT &kkt,
+                          const IPSettings &settings, const Eigen::VectorXd &lbx, const Eigen::VectorXd &ubx,
+                          const Eigen::VectorXd &lbg, Eigen::VectorXd &w, Eigen::VectorXd &lam, Eigen::VectorXd &lamx);
+};
+
+inline IPResult InteriorPointMethod::solve(const derivatives_t &derivatives, const objective_t &objective, StructuredKKT &kkt,
+                                           const IPSettings &settings, const Eigen::VectorXd &lbx, const Eigen::VectorXd &ubx,
+                                           const Eigen::VectorXd &lbg, Eigen::VectorXd &w, Eigen::VectorXd &lam, Eigen::VectorXd &lamx)
+{
+    const int n = w.size();
+    const int m = lbg.size();
+    const double inf = std::numeric_limits<double>::infinity();
+
+    /** fixed variables, finite bounds and a strictly interior starting point */
+    std::vector<char> fixed(n, 0);
+    Eigen::VectorXd has_lb = Eigen::VectorXd::Zero(n), has_ub = Eigen::VectorXd::Zero(n);
+    for(int i = 0; i < n; ++i)
+    {
+        if(ubx[i] - lbx[i] < 1e-12)
+        {
+            fixed[i] = 1;
+            w[i] = lbx[i];
+            continue;
+        }
+        has_lb[i] = (lbx[i] > -inf) ? 1 : 0;
+        has_ub[i] = (ubx[i] <  inf) ? 1 : 0;
+        double width = ubx[i] - lbx[i];
+        if(has_lb[i])
+            w[i] = std::max(w[i], lbx[i] + std::min(1e-2 * std::max(1.0, std::fabs(lbx[i])), 1e-2 * width));
+        if(has_ub[i])
+            w[i] = std::min(w[i], ubx[i] - std::min(1e-2 * std::max(1.0, std::fabs(ubx[i])), 1e-2 * width));
+    }
+
+    auto slack_lb = [&](const Eigen::VectorXd &x){return Eigen::VectorXd(has_lb.array() * (x - lbx).array().min(1e300) + (1 - has_lb.array()));};
+    auto slack_ub = [&](const Eigen::VectorXd &x){return Eigen::VectorXd(has_ub.array() * (ubx - x).array().min(1e300) + (1 - has_ub.array()));};
+
+    /** a warm start (nonzero multipliers) begins with a small barrier parameter */
+    const bool warm = (lam.lpNorm<Eigen::Infinity>() > 0) || (lamx.lpNorm<Eigen::Infinity>() > 0);
+    double mu = warm ? std::max(settings.tol, 1e-4) : 1e-1;
+
+    Eigen::VectorXd sl = slack_lb(w), su = slack_ub(w);
+    Eigen::VectorXd zl = has_lb.array() * (mu / sl.array()).max((-lamx).array());
+    Eigen::VectorXd zu = has_ub.array() * (mu / su.array()).max(lamx.array());
+
+    double nu = 1.0, delta_w = 0, delta_w_last = 0;
+    int iter = 0;
+    std::string status = "Maximum_Iterations_Exceeded";
+    double f = 0;
+    Eigen::VectorXd grad, g, r_d, dw, dl;
+    sparse_t J, H;
+
+    for(; iter <= settings.max_iter; ++iter)
+    {
+        derivatives(w, lam, f, g, grad, J, H);
+
+        /** optimality conditions */
+        r_d = grad + J.transpose() * lam - zl + zu;
+        for(int i = 0; i < n; ++i)
+            if(fixed[i])
+                r_d[i] = 0;
+        Eigen::VectorXd r_p = g - lbg;
+        Eigen::VectorXd r_cl = has_lb.array() * (sl.array() * zl.array());
+        Eigen::VectorXd r_cu = has_ub.array() * (su.array() * zu.array());
+
+        double scale_d = std::max(1.0, (lam.lpNorm<1>() + zl.lpNorm<1>() + zu.lpNorm<1>()) / (100.0 * (n + m)));
+        double error = std::max(r_d.lpNorm<Eigen::Infinity>() / scale_d,
+                                std::max(r_p.lpNorm<Eigen::Infinity>(),
+                                         std::max(r_cl.lpNorm<Eigen::Infinity>(), r_cu.lpNorm<Eigen::Infinity>()) / scale_d));
+
+        if(settings.print_level > 2)
+            std::cout << "ip iter " << iter << " f: " << f << " inf_pr: " << r_p.lpNorm<Eigen::Infinity>()
+                      << " inf_du: " << r_d.lpNorm<Eigen::Infinity>() << " mu: " << mu << "\n";
+
+        if(error <= settings.tol)
+        {
+            status = "Solve_Succeeded";
+            break;
+        }
+        if(iter == settings.max_iter)
+            break;
+
+        /** barrier update: monotone Fiacco-McCormick */
+        auto barrier_error = [&](const double &mu_k)
+        {
+            return std::max(r_d.lpNorm<Eigen::Infinity>() / scale_d,
+                            std::max(r_p.lpNorm<Eigen::Infinity>(),
+                                     std::max((r_cl.array() - has_lb.array() * mu_k).abs().maxCoeff(),
+                                              (r_cu.array() - has_ub.array() * mu_k).abs().maxCoeff()) / scale_d));
+        };
+        while((barrier_error(mu) <= 10 * mu) && (mu > settings.tol / 10))
+            mu = std::max(settings.tol / 10, std::min(0.2 * mu, std::pow(mu, 1.5)));
+
+        /** Newton step on the primal-dual system, regularized until it is a descent direction */
+        Eigen::VectorXd sigma = has_lb.array() * zl.array() / sl.array() + has_ub.array() * zu.array() / su.array();
+        Eigen::VectorXd barrier_grad = grad - (has_lb.array() * mu / sl.array()).matrix() + (has_ub.array() * mu / su.array()).matrix();
+        Eigen::VectorXd rw = -(barrier_grad + J.transpose() * lam);
+        Eigen::VectorXd rl = -r_p;
+
+        delta_w = 0;
+        bool solved = false;
+        for(int attempt = 0; attempt < 20; ++attempt)
+        {
+            Eigen::VectorXd diag = sigma.array() + delta_w;
+            double delta_c = (delta_w > 0) ? 1e-8 : 0;
+            if(kkt.solve(H, J, diag, delta_c, fixed, rw, rl, dw, dl))
+            {
+                double curvature = dw.dot(H * dw) + dw.dot(diag.cwiseProduct(dw));
+                if(curvature >= -1e-12 * dw.squaredNorm())
+                {
+                    solved = true;
+                    break;
+                }
+            }
+            delta_w = (delta_w == 0) ? ((delta_w_last == 0) ? 1e-4 : std::max(1e-20, delta_w_last / 3)) : 8 * delta_w;
+        }
+        delta_w_last = delta_w;
+        if(!solved)
+        {
+            status = "Error_In_Step_Computation";
+            break;
+        }
+
+        Eigen::VectorXd dzl = has_lb.array() * (mu / sl.array() - zl.array() - zl.array() / sl.array() * dw.array());
+        Eigen::VectorXd dzu = has_ub.array() * (mu / su.array() - zu.array() + zu.array() / su.array() * dw.array());
+
+        /** fraction to the boundary */
+        double tau = std::max(0.99, 1 - mu);
+        double alpha_max = 1, alpha_z = 1;
+        for(int i = 0; i < n; ++i)
+        {
+            if(has_lb[i] && dw[i] < 0)
+                alpha_max = std::min(alpha_max, -tau * sl[i] / dw[i]);
+            if(has_ub[i] && dw[i] > 0)
+                alpha_max = std::min(alpha_max, tau * su[i] / dw[i]);
+            if(has_lb[i] && dzl[i] < 0)
+                alpha_z = std::min(alpha_z, -tau * zl[i] / dzl[i]);
+            if(has_ub[i] && dzu[i] < 0)
+                alpha_z = std::min(alpha_z, -tau * zu[i] / dzu[i]);
+        }
+
+        /** backtracking on the l1 merit function */
+        nu = std::max(nu, (lam + dl).lpNorm<Eigen::Infinity>() + 1);
+        auto merit = [&](const double &fx, const Eigen::VectorXd &gx, const Eigen::VectorXd &sx_l, const Eigen::VectorXd &sx_u)
+        {
+            return fx - mu * (has_lb.array() * sx_l.array().log()).sum() - mu * (has_ub.array() * sx_u.array().log()).sum()
+                      + nu * (gx - lbg).lpNorm<1>();
+        };
+        double phi   = merit(f, g, sl, su);
+        double slope = barrier_grad.dot(dw) - nu * r_p.lpNorm<1>();
+
+        double alpha = alpha_max;
+        Eigen::VectorXd w_trial;
+        for(int ls = 0; ls < 40; ++ls)
+        {
+            w_trial = w + alpha * dw;
+            double f_trial;
+            Eigen::VectorXd g_trial;
+            objective(w_trial, f_trial, g_trial);
+            double phi_trial = merit(f_trial, g_trial, slack_lb(w_trial), slack_ub(w_trial));
+            if(std::isfinite(phi_trial) && (phi_trial <= phi + 1e-4 * alpha * std::min(slope, 0.0)))
+                break;
+            alpha *= 0.5;
+        }
+
+        if(alpha * dw.lpNorm<Eigen::Infinity>() < 1e-16 * (1 + w.lpNorm<Eigen::Infinity>()))
+        {
+            status = "Search_Direction_Becomes_Too_Small";
+            break;
+        }
+
+        w   = w_trial;
+        lam = lam + alpha * dl;
+        sl  = slack_lb(w);
+        su  = slack_ub(w);
+        zl  = zl + alpha_z * dzl;
+        zu  = zu + alpha_z * dzu;
+
+        /** keep the bound multipliers close to the central path */
+        for(int i = 0; i < n; ++i)
+        {
+            if(has_lb[i])
+                zl[i] = std::max(std::min(zl[i], 1e10 * mu / sl[i]), mu / (1e10 * sl[i]));
+            if(has_ub[i])
+                zu[i] = std::max(std::min(zu[i], 1e10 * mu / su[i]), mu / (1e10 * su[i]));
+        }
+    }
+
+    /** multipliers in the nlpsol convention: grad_f + J' lam_g + lam_x = 0 */
+    lamx = zu - zl;
+    if(J.rows() == m && J.cols() == n)
+    {
+        Eigen::VectorXd stationarity = grad + J.transpose() * lam;
+        for(int i = 0; i < n; ++i)
+            if(fixed[i])
+                lamx[i] = -stationarity[i];
+    }
+
+    IPResult result;
+    result.status     = status;
+    result.success    = (status == "Solve_Succeeded");
+    result.iter_count = iter;
+    return result;
+}
+
+} // polympc namespace
+
+#endif // INTERIOR_POINT_METHOD_HPP
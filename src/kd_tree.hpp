@@ -0,0 +1,187 @@
+#ifndef KD_TREE_HPP
+#define KD_TREE_HPP
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "eigen3/Eigen/Dense"
+
+namespace polympc {
+
+/** Static KD-tree over a point cloud (columns of a matrix) for nearest neighbour queries. The tree is stored
+ *  implicitly in a permutation of the point indices (median splits on the widest dimension), queries do not
+ *  allocate. */
+template<int Dim = Eigen::Dynamic>
+class KDTree
+{
+public:
+    typedef Eigen::Matrix<double, Dim, 1>              point_t;
+    typedef Eigen::Matrix<double, Dim, Eigen::Dynamic> points_t;
+
+    KDTree(){}
+    ~KDTree(){}
+
+    void build(const points_t &points);
+    bool empty() const {return m_index.empty();}
+    const points_t& points() const {return m_points;}
+
+    /** index of the closest point (-1 for an empty tree), squared distance in 'dist2' */
+    int nearest(const point_t &query, double &dist2) const;
+    /** the (at most) k closest points sorted by distance, returns their number */
+    int nearest(const point_t &query, const int &k, std::vector<int> &indices, std::vector<double> &dist2) const;
+
+private:
+    enum {MaxDepth = 64};
+
+    struct Node
+    {
+        int begin, end;    /**< range of m_index, the median at (begin + end) / 2 */
+        int axis;          /**< splitting dimension, -1 for a leaf */
+    };
+
+    points_t m_points;
+    std::vector<int> m_index;
+    std::vector<Node> m_nodes;   /**< implicit binary tree: children of node k are 2k + 1, 2k + 2 */
+
+    void build(const int &node, const int &begin, const int &end);
+    int search(const point_t &query, const int &k, int *indices, double *dist2) const;
+    static void insert(const int &index, const double &d, const int &k, int *indices, double *dist2, int &count);
+};
+
+template<int Dim>
+void KDTree<Dim>::build(const points_t &points)
+{
+    m_points = points;
+    m_index.resize(points.cols());
+    for(int k = 0; k < points.cols(); ++k)
+        m_index[k] = k;
+
+    int capacity = 1;
+    while(capacity < 2 * std::max<int>(1, points.cols()))
+        capacity *= 2;
+    m_nodes.assign(capacity, Node{0, 0, -1});
+
+    if(points.cols() > 0)
+        build(0, 0, points.cols());
+}
+
+template<int Dim>
+void KDTree<Dim>::build(const int &node, const int &begin, const int &end)
+{
+    m_nodes[node].begin = begin;
+    m_nodes[node].end   = end;
+    m_nodes[node].axis  = -1;
+    if(end - begin <= 1 || 2 * node + 2 >= static_cast<int>(m_nodes.size()))
+        return;
+
+    /** split on the dimension with the largest spread */
+    point_t lower = m_points.col(m_index[begin]), upper = lower;
+    for(int k = begin + 1; k < end; ++k)
+    {
+        lower = lower.cwiseMin(m_points.col(m_index[k]));
+        upper = upper.cwiseMax(m_points.col(m_index[k]));
+    }
+    int axis;
+    (upper - lower).maxCoeff(&axis);
+
+    const int mid = (begin + end) / 2;
+    std::nth_element(m_index.begin() + begin, m_index.begin() + mid, m_index.begin() + end,
+                     [this, axis](const int &a, const int &b){return m_points(axis, a) < m_points(axis, b);});
+
+    m_nodes[node].axis = axis;
+    build(2 * node + 1, begin, mid);
+    build(2 * node + 2, mid + 1, end);
+}
+
+template<int Dim>
+int KDTree<Dim>::nearest(const point_t &query, double &dist2) const
+{
+    int best = -1;
+    dist2 = std::numeric_limits<double>::infinity();
+    search(query, 1, &best, &dist2);
+    return best;
+}
+
+template<int Dim>
+int KDTree<Dim>::nearest(const point_t &query, const int &k, std::vector<int> &indices, std::vector<double> &dist2) const
+{
+    indices.assign(std::max(0, k), -1);
+    dist2.assign(std::max(0, k), std::numeric_limits<double>::infinity());
+    int count = (k > 0) ? search(query, k, indices.data(), dist2.data()) : 0;
+    indices.resize(count);
+    dist2.resize(count);
+    return count;
+}
+
+/** the k best candidates are kept sorted, the k-th distance bounds the search */
+template<int Dim>
+int KDTree<Dim>::search(const point_t &query, const int &k, int *indices, double *dist2) const
+{
+    if(m_index.empty())
+        return 0;
+
+    /** pending nodes with a lower bound of their squared distance */
+    int count = 0;
+    int stack[MaxDepth + 1];
+    double bound[MaxDepth + 1];
+    int top = 0;
+    stack[top] = 0;
+    bound[top++] = 0;
+
+    while(top > 0)
+    {
+        --top;
+        const int node_id = stack[top];
+        const double node_bound = bound[top];
+        const Node &node = m_nodes[node_id];
+        if(node.end <= node.begin || node_bound >= dist2[k - 1])
+            continue;
+
+        /** leaf: check all points of the range */
+        if(node.axis < 0)
+        {
+            for(int j = node.begin; j < node.end; ++j)
+                insert(m_index[j], (m_points.col(m_index[j]) - query).squaredNorm(), k, indices, dist2, count);
+            continue;
+        }
+
+        const int mid = (node.begin + node.end) / 2;
+        insert(m_index[mid], (m_points.col(m_index[mid]) - query).squaredNorm(), k, indices, dist2, count);
+
+        /** visit the near side first, the far side only if the splitting plane is closer than the k-th point */
+        double diff = query[node.axis] - m_points(node.axis, m_index[mid]);
+        int near_child = (diff < 0) ? 2 * node_id + 1 : 2 * node_id + 2;
+        int far_child  = (diff < 0) ? 2 * node_id + 2 : 2 * node_id + 1;
+
+        if(top + 2 > MaxDepth + 1)
+            continue;
+        stack[top] = far_child;
+        bound[top] = std::max(node_bound, diff * diff);
+        ++top;
+        stack[top] = near_child;
+        bound[top] = node_bound;
+        ++top;
+    }
+    return count;
+}
+
+template<int Dim>
+void KDTree<Dim>::insert(const int &index, const double &d, const int &k, int *indices, double *dist2, int &count)
+{
+    if(d >= dist2[k - 1])
+        return;
+
+    int j = std::min(count, k - 1);
+    for(; j > 0 && dist2[j - 1] > d; --j)
+    {
+        dist2[j]   = dist2[j - 1];
+        indices[j] = indices[j - 1];
+    }
+    dist2[j]   = d;
+    indices[j] = index;
+    count = std::min(count + 1, k);
+}
+
+} // polympc namespace
+
+#endif // KD_TREE_HPP
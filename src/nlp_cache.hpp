@@ -0,0 +1,213 @@
+#ifndef NLP_CACHE_HPP
+#define NLP_CACHE_HPP
+
+#include "casadi/casadi.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdint.h>
+#include "sys/stat.h"
+#include <unistd.h>
+
+namespace polympc {
+
+/** 64-bit FNV-1a hash: stable across platforms and runs, used to key the solver cache */
+inline uint64_t fnv1a_hash(const std::string &key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(std::string::const_iterator it = key.begin(); it != key.end(); ++it)
+    {
+        hash ^= static_cast<unsigned char>(*it);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/** textual fingerprint of a function including its full algorithm */
+inline std::string function_fingerprint(const casadi::Function &func)
+{
+    std::ostringstream fingerprint;
+    func.disp(fingerprint, true);
+    return fingerprint.str();
+}
+
+/** cache directory: solver option "polympc.cache_dir" or the POLYMPC_CACHE_DIR environment variable */
+inline std::string cache_directory(casadi::Dict &opts)
+{
+    std::string dir;
+    casadi::Dict::iterator it = opts.find("polympc.cache_dir");
+    if(it != opts.end())
+    {
+        dir = it->second.to_string();
+        opts.erase(it);
+    }
+    else if(std::getenv("POLYMPC_CACHE_DIR") != NULL)
+    {
+        dir = std::getenv("POLYMPC_CACHE_DIR");
+    }
+    return dir;
+}
+
+inline bool file_exists(const std::string &fname)
+{
+    struct stat buffer;
+    return (stat(fname.c_str(), &buffer) == 0);
+}
+
+/** create 'dir' and its missing parents (mkdir -p) */
+inline bool make_directories(const std::string &dir)
+{
+    for(std::string::size_type pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1))
+    {
+        std::string path = dir.substr(0, pos);
+        if(!path.empty() && !file_exists(path) && (mkdir(path.c_str(), 0755) != 0) && !file_exists(path))
+            return false;
+        if(pos == std::string::npos)
+            return true;
+    }
+}
+
+/** single-quoted shell argument */
+inline std::string shell_quote(const std::string &arg)
+{
+    std::string quoted = "'";
+    for(std::string::const_iterator it = arg.begin(); it != arg.end(); ++it)
+        quoted += (*it == '\'') ? std::string("'\\''") : std::string(1, *it);
+    return quoted + "'";
+}
+
+/** generate C code for 'funcs' in 'dir' and compile it into 'so_file': the library is built under a name unique
+ *  to this process and renamed into place, concurrent processes never load a partially written file */
+inline bool compile_functions(const std::vector<casadi::Function> &funcs, const std::string &c_name,
+                              const std::string &dir, const std::string &so_file)
+{
+    casadi::CodeGenerator gen(c_name + ".c");
+    for(std::size_t i = 0; i < funcs.size(); ++i)
+        gen.add(funcs[i]);
+
+    std::ostringstream tmp_name;
+    tmp_name << dir << "/" << c_name << "_" << getpid();
+    std::string c_file   = gen.generate(tmp_name.str() + "_");
+    std::string tmp_file = tmp_name.str() + ".so.tmp";
+    std::string compiler = (std::getenv("CC") != NULL) ? std::getenv("CC") : "gcc";
+    std::string cmd = compiler + " -fPIC -shared -O3 " + shell_quote(c_file) + " -o " + shell_quote(tmp_file);
+
+    int flag = std::system(cmd.c_str());
+    std::remove(c_file.c_str());
+    if((flag != 0) || (std::rename(tmp_file.c_str(), so_file.c_str()) != 0))
+    {
+        std::cout << "NLP cache: compilation failed: " << cmd << "\n";
+        std::remove(tmp_file.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** cache file prefix for a given key, creates the cache directory */
+inline std::string cache_prefix(const std::string &dir, const std::string &name, const std::string &key)
+{
+    std::ostringstream prefix;
+    prefix << name << "_" << std::hex << fnv1a_hash(key);
+    if(!make_directories(dir))
+        std::cout << "NLP cache: could not create " << dir << "\n";
+    return prefix.str();
+}
+
+/** SX form of an MX NLP in the symbols 'x' and 'p', for the consumers that need the expression graph
+ *  (sensitivity, condensation, the interior point backend, export) */
+inline casadi::SXDict expand_nlp(const casadi::MXDict &nlp, const casadi::SX &x, const casadi::SX &p)
+{
+    casadi::Function nlp_fun = casadi::Function("nlp", {nlp.at("x"), nlp.at("p")}, {nlp.at("f"), nlp.at("g")}).expand();
+    casadi::SXVector out = nlp_fun(casadi::SXVector{x, p});
+
+    casadi::SXDict expanded;
+    expanded["x"] = x;
+    expanded["p"] = p;
+    expanded["f"] = out[0];
+    expanded["g"] = out[1];
+    return expanded;
+}
+
+/** create an NLP solver: with a cache directory set, the NLP functions are code-generated and compiled once
+ *  per problem, later processes load the shared object instead of rebuilding the derivatives. 'problem_key'
+ *  identifies the problem from cheap inputs (model fingerprint, dimensions, bounds, flags); the symbolic NLP is
+ *  not printed */
+template<typename NLPDict>
+casadi::Function cached_nlpsol(const std::string &name, const std::string &solver, const NLPDict &nlp,
+                               const std::string &problem_key, const casadi::Dict &opts)
+{
+    casadi::Dict solver_opts = opts;
+    std::string dir = cache_directory(solver_opts);
+    if(dir.empty())
+        return casadi::nlpsol(name, solver, nlp, solver_opts);
+
+    /** the key adds the NLP dimensions, the solver and its options (a user Hessian is printed by name) */
+    std::ostringstream key;
+    key << problem_key << " " << nlp.at("x").size1() << " " << nlp.at("g").size1() << " "
+        << (nlp.find("p") != nlp.end() ? nlp.at("p").size1() : 0) << " " << solver << solver_opts;
+
+    std::string prefix  = cache_prefix(dir, name, key.str());
+    std::string so_file = dir + "/" + prefix + ".so";
+
+    if(file_exists(so_file))
+    {
+        try
+        {
+            return casadi::nlpsol(name, solver, so_file, solver_opts);
+        }
+        catch(std::exception &e)
+        {
+            std::cout << "NLP cache: could not load " << so_file << " : " << e.what() << "\n";
+        }
+    }
+
+    /** the library holds the oracle "nlp" and the functions the solver derived from it (nlp_f, nlp_jac_g, ...) */
+    typedef typename NLPDict::mapped_type Sym;
+    std::vector<Sym> nlp_in, nlp_out;
+    nlp_in.push_back(nlp.at("x"));
+    nlp_in.push_back(nlp.find("p") != nlp.end() ? nlp.at("p") : Sym());
+    nlp_out.push_back(nlp.at("f"));
+    nlp_out.push_back(nlp.at("g"));
+
+    casadi::Function nlp_solver = casadi::nlpsol(name, solver, nlp, solver_opts);
+    std::vector<casadi::Function> funcs(1, casadi::Function("nlp", nlp_in, nlp_out, {"x", "p"}, {"f", "g"}));
+    std::vector<std::string> names = nlp_solver.get_function();
+    for(std::size_t i = 0; i < names.size(); ++i)
+        funcs.push_back(nlp_solver.get_function(names[i]));
+
+    if(!compile_functions(funcs, prefix, dir, so_file))
+        return nlp_solver;
+
+    return casadi::nlpsol(name, solver, so_file, solver_opts);
+}
+
+/** compiled counterpart of an auxiliary function, stored next to the solver; 'key' identifies the function,
+ *  by default its printed algorithm (fine for node-sized functions) */
+inline casadi::Function cached_function(const casadi::Function &func, const casadi::Dict &opts,
+                                        const std::string &key = std::string())
+{
+    casadi::Dict tmp_opts = opts;
+    std::string dir = cache_directory(tmp_opts);
+    if(dir.empty())
+        return func;
+
+    std::string prefix  = cache_prefix(dir, func.name(), key.empty() ? function_fingerprint(func) : key);
+    std::string so_file = dir + "/" + prefix + ".so";
+
+    if(!file_exists(so_file) && !compile_functions(std::vector<casadi::Function>{func}, prefix, dir, so_file))
+        return func;
+
+    try
+    {
+        return casadi::external(func.name(), so_file);
+    }
+    catch(std::exception &e)
+    {
+        std::cout << "NLP cache: could not load " << so_file << " : " << e.what() << "\n";
+    }
+    return func;
+}
+
+} // polympc namespace
+
+#endif // NLP_CACHE_HPP
@@ -0,0 +1,207 @@
+#ifndef NLP_SENSITIVITY_HPP
+#define NLP_SENSITIVITY_HPP
+
+#include "casadi/casadi.hpp"
+#include "eigen3/Eigen/Dense"
+#include "eigen3/Eigen/Sparse"
+#include "eigen3/Eigen/SparseLU"
+
+namespace polympc {
+
+/** Parametric sensitivity of an NLP solution (tangential predictor). At a primal-dual solution (w, lam_g, lam_x)
+ *  with the active set taken from the multipliers, the solution derivative solves the KKT system
+ *
+ *  [ H    A' ] [ dw   ]   [ -H_wp dp          ]
+ *  [ A    0  ] [ dlam ] = [ db - A_p dp        ]
+ *
+ *  H: Hessian of the Lagrangian f + lam_g' g, A: Jacobian of the active constraints (equalities, rows with a nonzero
+ *  multiplier, active or fixed bounds), db: change of the active bound values (e.g. the initial state slot).
+ *  The matrix is factorized once per solution, every prediction is a back substitution. */
+class NLPSensitivity
+{
+public:
+    typedef Eigen::SparseMatrix<double> sparse_t;
+
+    NLPSensitivity() : m_factorized(false) {}
+    ~NLPSensitivity(){}
+
+    /** derivatives of the NLP: {w, p, lam_g} -> {hess_w L, jac_w g, jac_p grad_w L, jac_p g} */
+    static casadi::Function kkt_function(const casadi::SXDict &nlp);
+
+    void init(const casadi::Function &kkt_function){m_kkt_function = kkt_function; m_factorized = false;}
+
+    /** factorize at a solution; 'arg' holds the nlpsol arguments "p", "lbx", "ubx", "lbg", "ubg" of the solve */
+    bool factorize(const casadi::DMDict &arg, const casadi::DM &w, const casadi::DM &lam_x, const casadi::DM &lam_g,
+                   const double &active_tol = 1e-6);
+    bool factorized() const {return m_factorized;}
+
+    /** first-order change of the primal-dual solution for the parameter step dp and the bound shifts dbx
+     *  (only the entries of active bounds are used) */
+    void step(const Eigen::VectorXd &dp, const Eigen::VectorXd &dbx,
+              Eigen::VectorXd &dw, Eigen::VectorXd &dlam_g, Eigen::VectorXd &dlam_x) const;
+
+    /** primal step only */
+    Eigen::VectorXd primal_step(const Eigen::VectorXd &dp, const Eigen::VectorXd &dbx) const;
+
+    /** parameter and solution the factorization belongs to */
+    const Eigen::VectorXd& parameters() const {return m_p;}
+    const Eigen::VectorXd& solution() const {return m_w;}
+
+private:
+    casadi::Function m_kkt_function;
+    bool m_factorized;
+
+    Eigen::VectorXd m_w, m_p;
+    std::vector<int> m_active_g, m_active_x;
+    sparse_t m_Hwp, m_Jgp;
+    Eigen::SparseLU<sparse_t> m_lu;
+
+    static sparse_t to_sparse(const casadi::DM &M);
+    static Eigen::VectorXd to_vector(const casadi::DM &v);
+};
+
+inline casadi::Function NLPSensitivity::kkt_function(const casadi::SXDict &nlp)
+{
+    casadi::SX w = nlp.at("x");
+    casadi::SX p = (nlp.find("p") != nlp.end()) ? nlp.at("p") : casadi::SX::sym("p", 0);
+    casadi::SX g = nlp.at("g");
+    casadi::SX lam_g = casadi::SX::sym("lam_g", g.size1());
+
+    casadi::SX lagrangian = nlp.at("f") + casadi::SX::dot(lam_g, g);
+    casadi::SX grad_w = casadi::SX::gradient(lagrangian, w);
+
+    return casadi::Function("kkt_sensitivity", {w, p, lam_g},
+                            {casadi::SX::hessian(lagrangian, w), casadi::SX::jacobian(g, w),
+                             casadi::SX::jacobian(grad_w, p), casadi::SX::jacobian(g, p)});
+}
+
+inline NLPSensitivity::sparse_t NLPSensitivity::to_sparse(const casadi::DM &M)
+{
+    const casadi_int *colind = M.sparsity().colind();
+    const casadi_int *row    = M.sparsity().row();
+    const std::vector<double> &nz = M.nonzeros();
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(nz.size());
+    for(casadi_int c = 0; c < M.size2(); ++c)
+        for(casadi_int k = colind[c]; k < colind[c + 1]; ++k)
+            triplets.push_back(Eigen::Triplet<double>(row[k], c, nz[k]));
+
+    sparse_t A(M.size1(), M.size2());
+    A.setFromTriplets(triplets.begin(), triplets.end());
+    return A;
+}
+
+inline Eigen::VectorXd NLPSensitivity::to_vector(const casadi::DM &v)
+{
+    std::vector<double> data = casadi::DM::densify(v).nonzeros();
+    return Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+}
+
+inline bool NLPSensitivity::factorize(const casadi::DMDict &arg, const casadi::DM &w, const casadi::DM &lam_x,
+                                      const casadi::DM &lam_g, const double &active_tol)
+{
+    m_factorized = false;
+    if(m_kkt_function.is_null())
+        return false;
+
+    casadi::DM p = arg.at("p");
+    std::vector<casadi::DM> res = m_kkt_function(std::vector<casadi::DM>{w, p, lam_g});
+    sparse_t H   = to_sparse(res[0]);
+    sparse_t Jg  = to_sparse(res[1]);
+    m_Hwp = to_sparse(res[2]);
+    m_Jgp = to_sparse(res[3]);
+    m_w = to_vector(w);
+    m_p = to_vector(p);
+
+    /** active set: equalities, fixed variables and constraints with a nonzero multiplier */
+    Eigen::VectorXd lbx = to_vector(arg.at("lbx")), ubx = to_vector(arg.at("ubx"));
+    Eigen::VectorXd lbg = to_vector(arg.at("lbg")), ubg = to_vector(arg.at("ubg"));
+    Eigen::VectorXd lx = to_vector(lam_x), lg = to_vector(lam_g);
+
+    m_active_g.clear();
+    m_active_x.clear();
+    for(int j = 0; j < lg.size(); ++j)
+        if((ubg[j] - lbg[j] < active_tol) || (std::fabs(lg[j]) > active_tol))
+            m_active_g.push_back(j);
+    for(int i = 0; i < lx.size(); ++i)
+        if((ubx[i] - lbx[i] < active_tol) || (std::fabs(lx[i]) > active_tol))
+            m_active_x.push_back(i);
+
+    const int n  = m_w.size();
+    const int ng = m_active_g.size();
+    const int nb = m_active_x.size();
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(H.nonZeros() + 2 * Jg.nonZeros() + 2 * nb);
+    for(int k = 0; k < H.outerSize(); ++k)
+        for(sparse_t::InnerIterator it(H, k); it; ++it)
+            triplets.push_back(Eigen::Triplet<double>(it.row(), it.col(), it.value()));
+
+    /** rows of the active constraints: column-major Jacobian, map the row index */
+    std::vector<int> g_pos(Jg.rows(), -1);
+    for(int k = 0; k < ng; ++k)
+        g_pos[m_active_g[k]] = k;
+    for(int k = 0; k < Jg.outerSize(); ++k)
+    {
+        for(sparse_t::InnerIterator it(Jg, k); it; ++it)
+        {
+            if(g_pos[it.row()] < 0)
+                continue;
+            triplets.push_back(Eigen::Triplet<double>(n + g_pos[it.row()], it.col(), it.value()));
+            triplets.push_back(Eigen::Triplet<double>(it.col(), n + g_pos[it.row()], it.value()));
+        }
+    }
+    for(int k = 0; k < nb; ++k)
+    {
+        triplets.push_back(Eigen::Triplet<double>(n + ng + k, m_active_x[k], 1.0));
+        triplets.push_back(Eigen::Triplet<double>(m_active_x[k], n + ng + k, 1.0));
+    }
+
+    sparse_t K(n + ng + nb, n + ng + nb);
+    K.setFromTriplets(triplets.begin(), triplets.end());
+    K.makeCompressed();
+
+    m_lu.compute(K);
+    m_factorized = (m_lu.info() == Eigen::Success);
+    return m_factorized;
+}
+
+inline void NLPSensitivity::step(const Eigen::VectorXd &dp, const Eigen::VectorXd &dbx,
+                                 Eigen::VectorXd &dw, Eigen::VectorXd &dlam_g, Eigen::VectorXd &dlam_x) const
+{
+    const int n  = m_w.size();
+    const int ng = m_active_g.size();
+    const int nb = m_active_x.size();
+
+    Eigen::VectorXd rhs = Eigen::VectorXd::Zero(n + ng + nb);
+    if(dp.size() > 0)
+    {
+        rhs.head(n) = -(m_Hwp * dp);
+        Eigen::VectorXd dg = m_Jgp * dp;
+        for(int k = 0; k < ng; ++k)
+            rhs[n + k] = -dg[m_active_g[k]];
+    }
+    for(int k = 0; k < nb; ++k)
+        rhs[n + ng + k] = dbx[m_active_x[k]];
+
+    Eigen::VectorXd sol = m_lu.solve(rhs);
+    dw = sol.head(n);
+    dlam_g = Eigen::VectorXd::Zero(m_Jgp.rows());
+    dlam_x = Eigen::VectorXd::Zero(n);
+    for(int k = 0; k < ng; ++k)
+        dlam_g[m_active_g[k]] = sol[n + k];
+    for(int k = 0; k < nb; ++k)
+        dlam_x[m_active_x[k]] = sol[n + ng + k];
+}
+
+inline Eigen::VectorXd NLPSensitivity::primal_step(const Eigen::VectorXd &dp, const Eigen::VectorXd &dbx) const
+{
+    Eigen::VectorXd dw, dlam_g, dlam_x;
+    step(dp, dbx, dw, dlam_g, dlam_x);
+    return dw;
+}
+
+} // polympc namespace
+
+#endif // NLP_SENSITIVITY_HPP
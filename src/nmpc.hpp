@@ -1,8 +1,20 @@
 #ifndef NMPC_HPP
 #define NMPC_HPP
 
+#include <iomanip>
 #include <memory>
+#include <typeinfo>
 #include "chebyshev.hpp"
+#include "nlp_cache.hpp"
+#include "solver_workspace.hpp"
+#include "solver_deadline.hpp"
+#include "solver_registry.hpp"
+#include "interior_point.hpp"
+#include "segment_condensation.hpp"
+#include "nlp_sensitivity.hpp"
+#include "node_hessian.hpp"
+#include "controller_export.hpp"
+#include "solution_database.hpp"
 
 #define POLYMPC_USE_CONSTRAINTS
 
@@ -27,10 +39,28 @@ ParamType get_param(const std::string &key, const casadi::Dict dict, const Param
 
 */
 
+template<typename Controller> class BatchController;
+
 template <typename System, int NX, int NU, int NumSegments = 2, int PolyOrder = 5>
 class nmpc
 {
+    /** shares the compiled solver and reads the problem data */
+    template<typename Controller> friend class BatchController;
+
 public:
+    enum
+    {
+        NumNodes         = NumSegments * PolyOrder + 1,
+        PolynomialOrder  = PolyOrder,
+        NumberOfSegments = NumSegments
+    };
+
+    /** fixed-size numeric types for the Eigen interface */
+    typedef Eigen::Matrix<double, NX, 1>        state_t;
+    typedef Eigen::Matrix<double, NU, 1>        control_t;
+    typedef Eigen::Matrix<double, NX, NumNodes> trajectory_t;
+    typedef Eigen::Matrix<double, NU, NumNodes> control_trajectory_t;
+
     nmpc(const casadi::DM &_reference, const double &tf = 1.0, const casadi::DMDict &mpc_options = casadi::DMDict(), const casadi::Dict &solver_options = casadi::Dict());
     ~nmpc(){}
 
@@ -39,12 +69,14 @@ public:
     {
         ARG["lbx"](casadi::Slice(0, NX * (PolyOrder * NumSegments + 1 ))) =
                    casadi::SX::repmat(casadi::SX::mtimes(Scale_X, _lbx), PolyOrder * NumSegments + 1, 1);
+        args_dirty = true;
     }
 
     void setUBX(const casadi::DM &_ubx)
     {
         ARG["ubx"](casadi::Slice(0, NX * (PolyOrder * NumSegments + 1 ))) =
                    casadi::SX::repmat(casadi::SX::mtimes(Scale_X, _ubx), PolyOrder * NumSegments + 1, 1);
+        args_dirty = true;
     }
 
     void setLBU(const casadi::DM &_lbu)
@@ -52,37 +84,87 @@ public:
         int start = NX * (PolyOrder * NumSegments + 1 );
         int finish = start + NU * (PolyOrder * NumSegments + 1 );
         ARG["lbx"](casadi::Slice(start, finish)) = casadi::SX::repmat(casadi::SX::mtimes(Scale_U, _lbu), PolyOrder * NumSegments + 1, 1);
+        args_dirty = true;
     }
     void setUBU(const casadi::DM &_ubu)
     {
         int start = NX * (PolyOrder * NumSegments + 1 );
         int finish = start + NU * (PolyOrder * NumSegments + 1 );
         ARG["ubx"](casadi::Slice(start, finish)) = casadi::SX::repmat(casadi::SX::mtimes(Scale_U, _ubu), PolyOrder * NumSegments + 1, 1);
+        args_dirty = true;
     }
 
-    void setStateScaling(const casadi::DM &Scaling){Scale_X = Scaling;
+    void setStateScaling(const casadi::DM &Scaling){Scale_X = Scaling; args_dirty = true;
                                                       invSX = casadi::DM::solve(Scale_X, casadi::DM::eye(Scale_X.size1()));}
-    void setControlScaling(const casadi::DM &Scaling){Scale_U = Scaling;
+    void setControlScaling(const casadi::DM &Scaling){Scale_U = Scaling; args_dirty = true;
                                                       invSU = casadi::DM::solve(Scale_U, casadi::DM::eye(Scale_U.size1()));}
 
+    /** reference (constant or sampled at the collocation nodes forward in time) and cost weights,
+     *  both are NLP parameters and can be changed without rebuilding the solver */
+    void setReference(const casadi::DM &reference);
+    void setWeights(const casadi::DM &_Q, const casadi::DM &_R, const casadi::DM &_P);
+
+    /** nonlinear path constraint lbh <= h(x, u) <= ubh collocated at every node, by default h(x, u) <= 0;
+     *  constraints accumulate, each call rebuilds the NLP (bounds set so far are kept);
+     *  inequalities (lbh < ubh) are not supported by the "interior_point" backend, IPOPT is used instead */
+    void addPathConstraint(const casadi::Function &h, const casadi::DM &lbh = casadi::DM(), const casadi::DM &ubh = casadi::DM());
+
     void createNLP(const casadi::Dict &solver_options);
     void updateParams(const casadi::Dict &params);
 
     void enableWarmStart(){WARM_START = true;}
     void disableWarmStart(){WARM_START = false;}
     void computeControl(const casadi::DM &_X0);
+    void computeControl(const Eigen::Ref<const Eigen::VectorXd> &_X0);
+
+    /** tangential predictor ("mpc.sensitivity"): first-order update of the last NLP solution for a new state and the
+     *  current parameters, refreshes the optimal control and trajectory; false if no solution is factorized */
+    bool predictControl(const casadi::DM &_X0);
+    bool predictControl(const Eigen::Ref<const Eigen::VectorXd> &_X0);
+    /** derivative of the (scaled) decision variables w.r.t. [X0; p] at the last NLP solution */
+    casadi::DM getSensitivity();
+
+    /** standalone C library of the controller with its current bounds, parameters and initial guess in 'dir',
+     *  see export_controller() */
+    bool exportController(const std::string &dir, const std::string &name);
+
+    /** solution database ("mpc.solution_database"): converged solutions between runs, a file of a problem with
+     *  other sizes is rejected */
+    bool saveSolutionDatabase(const std::string &fname) const {return SolutionDB.save(fname);}
+    bool loadSolutionDatabase(const std::string &fname) {return SolutionDB.load(fname);}
+    int getSolutionDatabaseSize() const {return SolutionDB.size();}
+
+    /** real-time iteration: linearize around the current guess before the new state arrives */
+    void prepareControl();
+    bool isRTI(){return RTI;}
+
+    casadi::DM getOptimalControl(){sync_solution(); return OptimalControl;}
+    casadi::DM getOptimalTrajetory(){sync_solution(); return OptimalTrajectory;}
+
+    /** views into the solution buffers (columns in node order), valid until the next computeControl() */
+    Eigen::Map<const control_trajectory_t> getOptimalControlMap() const
+    {
+        return Eigen::Map<const control_trajectory_t>(OptimalControlData.data());
+    }
+    Eigen::Map<const trajectory_t> getOptimalTrajectoryMap() const
+    {
+        return Eigen::Map<const trajectory_t>(OptimalTrajectoryData.data());
+    }
 
-    casadi::DM getOptimalControl(){return OptimalControl;}
-    casadi::DM getOptimalTrajetory(){return OptimalTrajectory;}
+    /** return flag of the last low-level solver call (hot path) */
+    int getSolveFlag(){return solve_flag;}
+    /** outcome of the last solve, see SolveStatus */
+    SolveStatus getSolveStatus(){return solve_status;}
 
     casadi::Dict getStats(){return stats;}
     bool initialized(){return _initialized;}
+    double getHorizon() const {return Tf;}
 
     double getPathError();
 
 private:
     System system;
-    casadi::SX Reference;
+    casadi::DM Reference;
     uint   nx, nu, ny, np;
     double Tf;
 
@@ -103,15 +185,80 @@ private:
     casadi::DM Scale_U, invSU;
 
     /** cost function weight matrices */
-    casadi::SX Q, R, P;
+    casadi::DM Q, R, P;
+    void update_parameters();
 
     casadi::DM NLP_X, NLP_LAM_G, NLP_LAM_X;
     casadi::Function NLP_Solver;
+    std::shared_ptr<InteriorPointSolver> IPSolver;
     casadi::SXDict NLP;
+    /** MX formulation with mapped collocation, NLP is then expanded only on demand */
+    casadi::MXDict MappedNLP;
     casadi::Dict OPTS;
     casadi::DMDict ARG;
     casadi::Dict stats;
 
+    /** real-time iteration scheme: one Gauss-Newton SQP step per sample */
+    bool RTI;
+    bool rti_prepared;
+    casadi::Function QP_Solver;
+    casadi::Dict QP_OPTS;
+    casadi::DMDict QP_ARG;
+    void rti_feedback(const casadi::DM &X0);
+    void store_solution();
+    void store_solution(const casadi::DM &w);
+
+    /** parametric sensitivity of the solution: KKT factorization at the last solve, dw/dX0 precomputed */
+    bool SENSITIVITY;
+    casadi::Function KKTSensitivity;
+    NLPSensitivity Sensitivity;
+    Eigen::MatrixXd m_sens_x0;
+    void prepare_sensitivity();
+
+    /** Gauss-Newton Hessian of the least-squares cost instead of the exact Hessian of the Lagrangian */
+    bool GAUSS_NEWTON;
+    /** exact Hessian of the Lagrangian assembled from per-node blocks */
+    bool NODE_HESSIAN;
+
+    /** static condensation: the NLP solver sees only segment boundary states and controls */
+    bool CONDENSE;
+    casadi::Function ReducedSolver;
+    casadi::Dict solver_stats();
+
+    CollocationMap collocation_map;
+
+    /** time-shifted warm start */
+    double sampling_time;
+    casadi::DM ShiftOpT;
+    void shift_solution();
+
+    /** converged solutions keyed by the scaled initial state: initial guess on a cold start and after a failed solve */
+    SolutionDatabase SolutionDB;
+    int solution_db_capacity, solution_db_neighbours;
+    double solution_db_spacing;
+    bool load_database_guess(const casadi::DM &X0);
+
+    /** wall-clock budget per solve [s] and the anytime fallback */
+    double deadline;
+    std::shared_ptr<DeadlineCallback> Deadline;
+    DeadlineCallback::Session DeadlineState;
+    SolveStatus solve_status;
+    void apply_fallback(const casadi::DM &X0);
+
+    /** allocation-free hot path: preallocated buffers and low-level solver calls */
+    bool HOT_PATH;
+    bool args_dirty;
+    bool solution_outdated;
+    int  solve_flag;
+    FunctionWorkspace SolverWS;
+    int ws_x0, ws_lbx, ws_ubx, ws_lam_x0, ws_lam_g0, ws_x, ws_lam_x, ws_lam_g;
+    std::vector<double> m_scale_x, m_inv_sx, m_inv_su, m_shift, m_x0;
+    std::vector<double> OptimalTrajectoryData, OptimalControlData;
+    void hot_path_solve(const double *x_meas);
+    void sync_arguments();
+    void sync_solution();
+    void shift_nodes(const double *in, double *out, const int &dim, const int &num_cols);
+
     casadi::DM OptimalControl;
     casadi::DM OptimalTrajectory;
 
@@ -129,6 +276,25 @@ private:
 
     casadi::Function m_Jacobian;
     casadi::Function m_Dynamics;
+    casadi::Function m_GaussNewton;
+
+    /** immutable problem data: identical controllers in one process share it through SolverRegistry */
+    struct SolverCore
+    {
+        casadi::SXDict   NLP;
+        casadi::MXDict   MappedNLP;
+        casadi::Function NLP_Solver, QP_Solver;
+        std::shared_ptr<InteriorPointSolver> IPSolver;
+        casadi::Function ReducedSolver, KKTSensitivity;
+        casadi::Function DynamicsFunc, DynamicConstraints, PerformanceIndex, PathError, m_Jacobian, m_GaussNewton;
+        casadi::DM       ShiftOpT;
+        casadi::DM       lbx, ubx, lbg, ubg;
+        std::shared_ptr<DeadlineCallback> Deadline;
+    };
+    std::shared_ptr<const SolverCore> Core;
+    std::string core_key();
+    std::shared_ptr<SolverCore> build_core();
+    void load_core(const SolverCore &core);
 };
 
 template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
@@ -145,13 +311,12 @@ nmpc<System, NX, NU, NumSegments, PolyOrder>::nmpc(const casadi::DM &_reference,
 
     casadi::Function output   = system.getOutputMapping();
     ny = output.nnz_out();
-    Reference = _reference;
 
-    assert(ny == Reference.size1());
+    assert(ny == _reference.size1());
 
-    Q = casadi::SX::eye(ny);
-    P = casadi::SX::eye(ny);
-    R = casadi::SX::eye(NU);
+    Q = casadi::DM::eye(ny);
+    P = casadi::DM::eye(ny);
+    R = casadi::DM::eye(NU);
 
     Scale_X = casadi::DM::eye(ny);
     invSX = Scale_X;
@@ -202,19 +367,160 @@ nmpc<System, NX, NU, NumSegments, PolyOrder>::nmpc(const casadi::DM &_reference,
         invSU = casadi::DM::solve(Scale_U, casadi::DM::eye(Scale_U.size1()));
     }
 
+    setReference(_reference);
+
+    /** real-time iteration mode */
+    RTI = false;
+    if(mpc_options.find("mpc.rti") != mpc_options.end())
+        RTI = static_cast<bool>(mpc_options.find("mpc.rti")->second.nonzeros()[0]);
+
+    /** eliminate the collocation nodes segment by segment by local Newton solves */
+    CONDENSE = false;
+    if(mpc_options.find("mpc.condense") != mpc_options.end())
+        CONDENSE = static_cast<bool>(mpc_options.find("mpc.condense")->second.nonzeros()[0]);
+
+    /** Gauss-Newton Hessian approximation for the NLP solver */
+    GAUSS_NEWTON = false;
+    if(mpc_options.find("mpc.gauss_newton") != mpc_options.end())
+        GAUSS_NEWTON = static_cast<bool>(mpc_options.find("mpc.gauss_newton")->second.nonzeros()[0]);
+
+    /** exact Hessian from one mapped per-node kernel instead of the derivatives of the whole NLP graph */
+    NODE_HESSIAN = false;
+    if(mpc_options.find("mpc.node_hessian") != mpc_options.end())
+        NODE_HESSIAN = static_cast<bool>(mpc_options.find("mpc.node_hessian")->second.nonzeros()[0]);
+
+    /** factorize the KKT system after each solve for the tangential predictor */
+    SENSITIVITY = false;
+    if(mpc_options.find("mpc.sensitivity") != mpc_options.end())
+        SENSITIVITY = static_cast<bool>(mpc_options.find("mpc.sensitivity")->second.nonzeros()[0]);
+
+    /** vectorized evaluation of the model at the collocation nodes */
+    collocation_map = NO_MAP;
+    if(mpc_options.find("mpc.collocation_map") != mpc_options.end())
+        collocation_map = static_cast<CollocationMap>(static_cast<int>(mpc_options.find("mpc.collocation_map")->second.nonzeros()[0]));
+
+    /** shift the warm start by the sampling time */
+    sampling_time = 0;
+    if(mpc_options.find("mpc.sampling_time") != mpc_options.end())
+        sampling_time = mpc_options.find("mpc.sampling_time")->second.nonzeros()[0];
+
+    /** solution database: capacity (0: off), number of blended neighbours and the minimal distance of the records */
+    solution_db_capacity = 0;
+    if(mpc_options.find("mpc.solution_database") != mpc_options.end())
+        solution_db_capacity = static_cast<int>(mpc_options.find("mpc.solution_database")->second.nonzeros()[0]);
+
+    solution_db_neighbours = 1;
+    if(mpc_options.find("mpc.solution_database_k") != mpc_options.end())
+        solution_db_neighbours = static_cast<int>(mpc_options.find("mpc.solution_database_k")->second.nonzeros()[0]);
+
+    solution_db_spacing = 0;
+    if(mpc_options.find("mpc.solution_database_spacing") != mpc_options.end())
+        solution_db_spacing = mpc_options.find("mpc.solution_database_spacing")->second.nonzeros()[0];
+
+    /** stop the solver after 'mpc.deadline' seconds and fall back to the best feasible iterate */
+    deadline = 0;
+    if(mpc_options.find("mpc.deadline") != mpc_options.end())
+        deadline = mpc_options.find("mpc.deadline")->second.nonzeros()[0];
+    solve_status = SOLVE_SUCCESS;
+
+    /** allocation-free low-level solver calls */
+    HOT_PATH = false;
+    if(mpc_options.find("mpc.hot_path") != mpc_options.end())
+        HOT_PATH = static_cast<bool>(mpc_options.find("mpc.hot_path")->second.nonzeros()[0]);
+    args_dirty = true;
+    solution_outdated = false;
+    solve_flag = 0;
+
     /** assume unconstrained problem */
     LBX = -casadi::DM::inf(nx);
     UBX = casadi::DM::inf(nx);
     LBU = -casadi::DM::inf(nu);
     UBU = casadi::DM::inf(nu);
 
+    /** no path constraints */
+    LBG = casadi::DM::zeros(0);
+    UBG = casadi::DM::zeros(0);
+
     WARM_START  = false;
     _initialized = false;
+    rti_prepared = false;
 
     /** create NLP */
     createNLP(solver_options);
 }
 
+/** set reference: a single output vector or a trajectory sampled at the collocation nodes forward in time */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::setReference(const casadi::DM &reference)
+{
+    const int num_nodes = NumSegments * PolyOrder + 1;
+    assert(ny == reference.size1());
+
+    if(reference.size2() == num_nodes)
+    {
+        /** collocation nodes are ordered backwards in time */
+        casadi::DMVector columns;
+        for(int k = num_nodes - 1; k >= 0; --k)
+            columns.push_back(reference(casadi::Slice(), k));
+        Reference = casadi::DM::horzcat(columns);
+    }
+    else
+    {
+        Reference = casadi::DM::repmat(reference(casadi::Slice(), 0), 1, num_nodes);
+    }
+    update_parameters();
+}
+
+/** set cost function weights: diagonal vectors or weight matrices */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::setWeights(const casadi::DM &_Q, const casadi::DM &_R, const casadi::DM &_P)
+{
+    assert(ny == _Q.size1());
+    assert(NU == _R.size1());
+    assert(ny == _P.size1());
+
+    Q = _Q;
+    R = _R;
+    P = _P;
+    update_parameters();
+}
+
+/** register a path constraint and rebuild the solver */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::addPathConstraint(const casadi::Function &h, const casadi::DM &lbh, const casadi::DM &ubh)
+{
+    casadi::SX x = casadi::SX::sym("x", NX);
+    casadi::SX u = casadi::SX::sym("u", NU);
+    casadi::SX h_xu = h(casadi::SXVector{x, u})[0];
+    const int nh = h_xu.size1();
+
+    casadi::SX previous = ContraintsFunc.is_null() ? casadi::SX::zeros(0) : ContraintsFunc(casadi::SXVector{x, u})[0];
+    Contraints     = casadi::SX::vertcat({previous, h_xu});
+    ContraintsFunc = casadi::Function("path_constraints", {x, u}, {Contraints});
+    LBG = casadi::DM::vertcat({LBG, lbh.is_empty() ? -casadi::DM::inf(nh) : lbh});
+    UBG = casadi::DM::vertcat({UBG, ubh.is_empty() ? casadi::DM::zeros(nh) : ubh});
+
+    casadi::DM lbx = ARG["lbx"];
+    casadi::DM ubx = ARG["ubx"];
+    casadi::Dict options = OPTS;
+    createNLP(options);
+    ARG["lbx"] = lbx;
+    ARG["ubx"] = ubx;
+}
+
+/** NLP parameters: reference at the nodes followed by the weights of the residuals, controls and terminal residual */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::update_parameters()
+{
+    /** sum1(W * r^2) == dot(sum1(W)', r^2) */
+    casadi::DM w_q = (Q.size2() == 1) ? Q : casadi::DM::sum1(Q).T();
+    casadi::DM w_r = (R.size2() == 1) ? R : casadi::DM::sum1(R).T();
+    casadi::DM w_p = (P.size2() == 1) ? P : casadi::DM::sum1(P).T();
+
+    ARG["p"] = casadi::DM::vertcat({casadi::DM::vec(Reference), w_q, w_r, w_p});
+    args_dirty = true;
+}
+
 /** update solver paramters */
 template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
 void nmpc<System, NX, NU, NumSegments, PolyOrder>::updateParams(const casadi::Dict &params)
@@ -225,8 +531,9 @@ void nmpc<System, NX, NU, NumSegments, PolyOrder>::updateParams(const casadi::Di
     }
 }
 
+/** build the symbolic problem and the solver */
 template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
-void nmpc<System, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi::Dict &solver_options)
+std::shared_ptr<typename nmpc<System, NX, NU, NumSegments, PolyOrder>::SolverCore> nmpc<System, NX, NU, NumSegments, PolyOrder>::build_core()
 {
     /** get dynamics function and state Jacobian */
     casadi::Function dynamics = system.getDynamics();
@@ -253,60 +560,185 @@ void nmpc<System, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi::Dict
     NUM_COLLOCATION_POINTS = num_segments * poly_order;
     /** Order of polynomial interpolation */
 
+    /** NLP backend: IPOPT (default) or the structure-exploiting interior point solver */
+    std::string backend = "ipopt";
+    casadi::Dict solver_opts = OPTS;
+    if(solver_opts.find("polympc.solver") != solver_opts.end())
+    {
+        backend = solver_opts["polympc.solver"].to_string();
+        solver_opts.erase("polympc.solver");
+    }
+
+    /** the IPOPT defaults do not apply to other nlpsol plugins */
+    if((backend != "ipopt") && (backend != "interior_point"))
+    {
+        for(casadi::Dict::iterator it = solver_opts.begin(); it != solver_opts.end();)
+            it = (it->first.compare(0, 6, "ipopt.") == 0) ? solver_opts.erase(it) : std::next(it);
+    }
+
+    /** the interior point backend handles equality constraints only: inequality path constraints go to IPOPT */
+    if((backend == "interior_point") && !ContraintsFunc.is_null() && (static_cast<double>(casadi::DM::norm_inf(UBG - LBG)) > 0))
+    {
+        std::cout << "nmpc: the interior point backend supports equality path constraints only (lbg == ubg), "
+                  << "the problem with inequality path constraints is solved with ipopt \n";
+        backend = "ipopt";
+    }
+
+    /** mapped collocation is formulated in MX: each node function enters the NLP as one map node that nlpsol
+     *  evaluates serially or in threads (SX would inline every node again); the SX form is expanded only for the
+     *  schemes that work on the expression graph */
+    const bool mapped    = (collocation_map != NO_MAP);
+    const bool expand_sx = !mapped || RTI || CONDENSE || SENSITIVITY || (backend == "interior_point");
+    const std::string parallelization = (collocation_map == MAP_THREAD) ? "thread" : "serial";
+    NLP.clear();
+    MappedNLP.clear();
+    Deadline.reset();
+
     Chebyshev<casadi::SX, poly_order, num_segments, dimx, dimu, dimp> spectral;
-    casadi::SX diff_constr;
+    casadi::Function NodeODE = DynamicsFunc;
 
     if(scale)
     {
         casadi::SX SODE = dynamics(casadi::SXVector{casadi::SX::mtimes(invSX, x), casadi::SX::mtimes(invSU, u)})[0];
         SODE = casadi::SX::mtimes(Scale_X, SODE);
-        casadi::Function FunSODE = casadi::Function("scaled_ode", {x, u}, {SODE});
-
-        diff_constr = spectral.CollocateDynamics(FunSODE, 0, tf);
-    }
-    else
-    {
-        diff_constr = spectral.CollocateDynamics(DynamicsFunc, 0, tf);
+        NodeODE = casadi::Function("scaled_ode", {x, u}, {SODE});
     }
 
-    diff_constr = diff_constr(casadi::Slice(0, diff_constr.size1() - dimx));
+    /** warm start shift operator */
+    if(sampling_time > 0)
+        ShiftOpT = spectral.ShiftOperator(0, tf, sampling_time).T();
+
+    /** reference and weights are parameters: [ref; w_q; w_r; w_p] at each node */
+    const int num_nodes = poly_order * num_segments + 1;
+    casadi::SX ref        = casadi::SX::sym("ref", ny);
+    casadi::SX weights    = casadi::SX::sym("weights", 2 * ny + nu);
+    casadi::SX w_q        = weights(casadi::Slice(0, ny));
+    casadi::SX w_r        = weights(casadi::Slice(ny, ny + nu));
+    casadi::SX w_p        = weights(casadi::Slice(ny + nu, 2 * ny + nu));
+    casadi::SX node_param = casadi::SX::vertcat({ref, weights});
+
+    casadi::SX ref_nodes   = casadi::SX::sym("ref_nodes", ny, num_nodes);
+    casadi::SX nlp_params  = casadi::SX::vertcat({casadi::SX::vec(ref_nodes), weights});
+    casadi::SX node_params = casadi::SX::vertcat({ref_nodes, casadi::SX::repmat(weights, 1, num_nodes)});
 
     /** define an integral cost */
     casadi::SX lagrange, residual;
     if(scale)
     {
         casadi::SX _invSX = invSX(casadi::Slice(0, NX), casadi::Slice(0, NX));
-        residual  = Reference - output({casadi::SX::mtimes(_invSX, x)})[0];
-        lagrange  = casadi::SX::sum1( casadi::SX::mtimes(Q, pow(residual, 2)) );
-        lagrange = lagrange + casadi::SX::sum1( casadi::SX::mtimes(R, pow(u, 2)) );
+        residual  = ref - output({casadi::SX::mtimes(_invSX, x)})[0];
+        lagrange  = casadi::SX::dot(w_q, pow(residual, 2));
+        lagrange = lagrange + casadi::SX::dot(w_r, pow(u, 2));
     }
     else
     {
-        residual  = Reference - output({x})[0];
-        lagrange  = casadi::SX::sum1( casadi::SX::mtimes(Q, pow(residual, 2)) );
-        lagrange = lagrange + casadi::SX::sum1( casadi::SX::mtimes(R, pow(u, 2)) );
+        residual  = ref - output({x})[0];
+        lagrange  = casadi::SX::dot(w_q, pow(residual, 2));
+        lagrange = lagrange + casadi::SX::dot(w_r, pow(u, 2));
     }
 
-    casadi::Function LagrangeTerm = casadi::Function("Lagrange", {x, u}, {lagrange});
+    casadi::Function LagrangeTerm = casadi::Function("Lagrange", {x, u, node_param}, {lagrange});
 
     /** trace functions */
-    PathError = casadi::Function("PathError", {x}, {residual});
+    PathError = casadi::Function("PathError", {x, ref}, {residual});
 
-    casadi::SX mayer           =  casadi::SX::sum1( casadi::SX::mtimes(P, pow(residual, 2)) );
-    casadi::Function MayerTerm = casadi::Function("Mayer",{x}, {mayer});
-    casadi::SX performance_idx = spectral.CollocateCost(MayerTerm, LagrangeTerm, 0.0, tf);
+    casadi::SX mayer           =  casadi::SX::dot(w_p, pow(residual, 2));
+    casadi::Function MayerTerm = casadi::Function("Mayer",{x, node_param}, {mayer});
 
     casadi::SX varx = spectral.VarX();
     casadi::SX varu = spectral.VarU();
 
     casadi::SX opt_var = casadi::SX::vertcat(casadi::SXVector{varx, varu});
 
-    /** debugging output */
-    DynamicConstraints = casadi::Function("constraint_func", {opt_var}, {diff_constr});
-    PerformanceIndex   = casadi::Function("performance_idx", {opt_var}, {performance_idx});
+    /** path constraints: one mapped evaluation over the nodes, the Jacobian stays block-diagonal */
+    casadi::SX h_xu = casadi::SX::zeros(0);
+    casadi::Function PathConstraints;
+    if(!ContraintsFunc.is_null())
+    {
+        if(scale)
+        {
+            casadi::SX _invSX = invSX(casadi::Slice(0, NX), casadi::Slice(0, NX));
+            h_xu = ContraintsFunc(casadi::SXVector{casadi::SX::mtimes(_invSX, x), casadi::SX::mtimes(invSU, u)})[0];
+        }
+        else
+        {
+            h_xu = ContraintsFunc(casadi::SXVector{x, u})[0];
+        }
+        PathConstraints = casadi::Function("path_constraints", {x, u}, {h_xu});
+    }
 
-    casadi::SX lbg = casadi::SX::zeros(diff_constr.size());
-    casadi::SX ubg = casadi::SX::zeros(diff_constr.size());
+    /** the initial state slot (last node) has no collocation rows */
+    const int num_dyn = NUM_COLLOCATION_POINTS * dimx;
+    casadi::SX lbg = casadi::SX::zeros(num_dyn);
+    casadi::SX ubg = casadi::SX::zeros(num_dyn);
+    if(!PathConstraints.is_null())
+    {
+        lbg = casadi::SX::vertcat({lbg, casadi::SX::repmat(casadi::SX(LBG), num_nodes, 1)});
+        ubg = casadi::SX::vertcat({ubg, casadi::SX::repmat(casadi::SX(UBG), num_nodes, 1)});
+    }
+
+    /** formulate NLP */
+    if(mapped)
+    {
+        Chebyshev<casadi::MX, poly_order, num_segments, dimx, dimu, dimp> spectral_mx;
+        spectral_mx.SetCollocationMap(collocation_map);
+
+        casadi::MX varx_mx = spectral_mx.VarX();
+        casadi::MX varu_mx = spectral_mx.VarU();
+        casadi::MX ref_nodes_mx   = casadi::MX::sym("ref_nodes", ny, num_nodes);
+        casadi::MX weights_mx     = casadi::MX::sym("weights", 2 * ny + nu);
+        casadi::MX node_params_mx = casadi::MX::vertcat({ref_nodes_mx, casadi::MX::repmat(weights_mx, 1, num_nodes)});
+
+        casadi::MX constraints_mx = spectral_mx.CollocateDynamics(NodeODE, 0, tf);
+        constraints_mx = constraints_mx(casadi::Slice(0, num_dyn));
+        if(!PathConstraints.is_null())
+        {
+            casadi::MX path_constr = PathConstraints.map(num_nodes, parallelization)(casadi::MXVector{casadi::MX::reshape(varx_mx, NX, num_nodes),
+                                                                                                     casadi::MX::reshape(varu_mx, NU, num_nodes)})[0];
+            constraints_mx = casadi::MX::vertcat({constraints_mx, casadi::MX::vec(path_constr)});
+        }
+
+        MappedNLP["x"] = casadi::MX::vertcat({varx_mx, varu_mx});
+        MappedNLP["f"] = spectral_mx.CollocateCost(MayerTerm, LagrangeTerm, node_params_mx, 0.0, tf);
+        MappedNLP["g"] = constraints_mx;
+        MappedNLP["p"] = casadi::MX::vertcat({casadi::MX::vec(ref_nodes_mx), weights_mx});
+
+        if(expand_sx)
+            NLP = expand_nlp(MappedNLP, opt_var, nlp_params);
+    }
+    else
+    {
+        casadi::SX constraints = spectral.CollocateDynamics(NodeODE, 0, tf);
+        constraints = constraints(casadi::Slice(0, num_dyn));
+        if(!PathConstraints.is_null())
+        {
+            casadi::SX path_constr = PathConstraints.map(num_nodes, "serial")(casadi::SXVector{casadi::SX::reshape(varx, NX, num_nodes),
+                                                                                               casadi::SX::reshape(varu, NU, num_nodes)})[0];
+            constraints = casadi::SX::vertcat({constraints, casadi::SX::vec(path_constr)});
+        }
+
+        NLP["x"] = opt_var;
+        NLP["f"] = spectral.CollocateCost(MayerTerm, LagrangeTerm, node_params, 0.0, tf);
+        NLP["g"] = constraints;
+        NLP["p"] = nlp_params;
+    }
+
+    /** debugging output and the collocation functions of the RTI scheme */
+    casadi::SX performance_idx, constraints;
+    if(expand_sx)
+    {
+        performance_idx = NLP["f"];
+        constraints     = NLP["g"];
+        DynamicConstraints = casadi::Function("constraint_func", {opt_var}, {constraints});
+        PerformanceIndex   = casadi::Function("performance_idx", {opt_var, nlp_params}, {performance_idx});
+        m_Jacobian = casadi::Function("aug_jacobian",{opt_var}, {casadi::SX::jacobian(constraints, opt_var)});
+    }
+    else
+    {
+        DynamicConstraints = casadi::Function("constraint_func", {MappedNLP["x"]}, {MappedNLP["g"]});
+        PerformanceIndex   = casadi::Function("performance_idx", {MappedNLP["x"], MappedNLP["p"]}, {MappedNLP["f"]});
+        m_Jacobian = casadi::Function("aug_jacobian",{MappedNLP["x"]}, {casadi::MX::jacobian(MappedNLP["g"], MappedNLP["x"])});
+    }
 
     /** set inequality (box) constraints */
     /** state */
@@ -317,14 +749,205 @@ void nmpc<System, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi::Dict
     lbx = casadi::SX::vertcat( {lbx, casadi::SX::repmat(casadi::SX::mtimes(Scale_U, LBU), poly_order * num_segments + 1, 1)} );
     ubx = casadi::SX::vertcat( {ubx, casadi::SX::repmat(casadi::SX::mtimes(Scale_U, UBU), poly_order * num_segments + 1, 1)} );
 
-    casadi::SX diff_constr_jacobian = casadi::SX::jacobian(diff_constr, opt_var);
-    /** Augmented Jacobian */
-    m_Jacobian = casadi::Function("aug_jacobian",{opt_var}, {diff_constr_jacobian});
+    /** Gauss-Newton Hessian approximation of the cost for the RTI scheme and "mpc.gauss_newton" */
+    casadi::SX gn_hessian;
+    if(RTI || GAUSS_NEWTON)
+    {
+        /** the cost is a weighted sum of squared residuals: stack them node by node */
+        casadi::Function LsqResidual = casadi::Function("lsq_residual", {x, u, ref}, {casadi::SX::vertcat({residual, u})});
+        casadi::SX lsq_weight = casadi::SX::vertcat({w_q, w_r});
+        casadi::SX qweights   = spectral.QWeights();
+        double t_scale = tf / (2 * num_segments);
+
+        casadi::SXVector lsq_res, lsq_w;
+        for(int k = 0; k < num_segments; ++k)
+        {
+            for(int m = 0; m <= poly_order; ++m)
+            {
+                int node = k * poly_order + m;
+                casadi::SX x_node = varx(casadi::Slice(node * NX, (node + 1) * NX));
+                casadi::SX u_node = varu(casadi::Slice(node * NU, (node + 1) * NU));
+                lsq_res.push_back(LsqResidual(casadi::SXVector{x_node, u_node, ref_nodes(casadi::Slice(), node)})[0]);
+                lsq_w.push_back(t_scale * qweights(m) * lsq_weight);
+            }
+        }
+        /** Mayer term */
+        lsq_res.push_back(PathError(casadi::SXVector{varx(casadi::Slice(0, NX)), ref_nodes(casadi::Slice(), 0)})[0]);
+        lsq_w.push_back(w_p);
+
+        /** residuals depend on one node each: J_r' W J_r keeps the node block sparsity */
+        casadi::SX lsq_jacobian = casadi::SX::jacobian(casadi::SX::vertcat(lsq_res), opt_var);
+        gn_hessian = 2 * casadi::SX::mtimes(lsq_jacobian.T(),
+                                            casadi::SX::mtimes(casadi::SX::diag(casadi::SX::vertcat(lsq_w)), lsq_jacobian));
+    }
 
-    /** formulate NLP */
-    NLP["x"] = opt_var;
-    NLP["f"] = performance_idx; //  1e-3 * casadi::SX::dot(diff_constr, diff_constr);
-    NLP["g"] = diff_constr;
+    /** cost gradient and QP for the RTI scheme */
+    if(RTI)
+    {
+        casadi::SX cost_gradient = casadi::SX::gradient(performance_idx, opt_var);
+        m_GaussNewton = casadi::Function("gauss_newton", {opt_var, nlp_params}, {gn_hessian, cost_gradient});
+
+        /** QP solved in the feedback phase */
+        QP_OPTS["printLevel"] = "none";
+        QP_Solver = casadi::conic("rti_qp", "qpoases", casadi::SpDict{{"h", gn_hessian.sparsity()},
+                                                                       {"a", m_Jacobian.sparsity_out(0)}}, QP_OPTS);
+    }
+
+    if(backend == "interior_point")
+    {
+        if(deadline > 0)
+            std::cout << "nmpc: the deadline is not supported by the interior point backend and is ignored \n";
+
+        if(CONDENSE)
+            std::cout << "nmpc: the interior point backend solves the full problem, condensation is ignored \n";
+
+        IPSolver = std::make_shared<InteriorPointSolver>("solver", NLP, NX, NU, NumSegments, PolyOrder, solver_opts);
+        NLP_Solver = *IPSolver;
+    }
+    else if(CONDENSE)
+    {
+        if(deadline > 0)
+            std::cout << "nmpc: the deadline is not supported with condensed segments and is ignored \n";
+
+        /** segments are eliminated in one mapped call: threads with MAP_THREAD */
+        CondensedNLP condensed = condensed_nlpsol("solver", backend, NLP, NX, NU, NumSegments, PolyOrder,
+                                                  casadi::DM(lbx), casadi::DM(ubx), parallelization, solver_opts);
+        NLP_Solver    = condensed.solver;
+        ReducedSolver = condensed.reduced;
+    }
+    else
+    {
+        /** Gauss-Newton: the Hessian of the Lagrangian is replaced by the cost approximation, the solver evaluates
+         *  no second derivatives of the dynamics */
+        if(GAUSS_NEWTON)
+        {
+            casadi::SX lam_f = casadi::SX::sym("lam_f");
+            casadi::SX lam_g = casadi::SX::sym("lam_g", lbg.size1());
+            solver_opts["hess_lag"] = casadi::Function("nlp_hess_l", {opt_var, nlp_params, lam_f, lam_g},
+                                                       {casadi::SX::triu(lam_f * gn_hessian)});
+        }
+        else if(NODE_HESSIAN)
+        {
+            /** node Lagrangian: weighted cost terms, collocation rows (g = D X - t_scale * f) and path constraints */
+            double t_scale = tf / (2 * num_segments);
+            casadi::SX c_lagrange = casadi::SX::sym("c_lagrange");
+            casadi::SX c_mayer    = casadi::SX::sym("c_mayer");
+            casadi::SX lam_dyn    = casadi::SX::sym("lam_dyn", NX);
+            casadi::SX lam_path   = casadi::SX::sym("lam_path", h_xu.size1());
+            casadi::SX node_lagrangian = c_lagrange * lagrange + c_mayer * mayer
+                                       - t_scale * casadi::SX::dot(lam_dyn, NodeODE(casadi::SXVector{x, u})[0])
+                                       + casadi::SX::dot(lam_path, h_xu);
+            casadi::Function NodeKernel = casadi::Function("node_hess_l", {x, u, node_param, c_lagrange, c_mayer, lam_dyn, lam_path},
+                                                           {casadi::SX::triu(casadi::SX::hessian(node_lagrangian,
+                                                                                                 casadi::SX::vertcat({x, u})))});
+
+            casadi::DM lagrange_weights = t_scale * polymath::eigen2casadi<casadi::DM>(polymath::ChebyshevTables<PolyOrder, NumSegments>::NodeWeights());
+
+            /** the initial state slot (last node) has no collocation rows */
+            solver_opts["hess_lag"] = node_hessian_lagrangian("nlp_hess_l", NodeKernel,
+                                                              casadi::Function("node_params", {nlp_params}, {node_params}),
+                                                              NX, NU, num_nodes, num_nodes - 1, h_xu.size1(),
+                                                              lagrange_weights, parallelization, OPTS);
+        }
+
+        /** the deadline is checked at every iteration, feasible iterates are recorded on the way */
+        if(deadline > 0)
+        {
+            /** an iterate is feasible to the tolerance the solver itself accepts */
+            double feasibility_tol = 1e-6;
+            if(solver_opts.find("ipopt.constr_viol_tol") != solver_opts.end())
+                feasibility_tol = solver_opts.at("ipopt.constr_viol_tol").to_double();
+            else if(solver_opts.find("ipopt.tol") != solver_opts.end())
+                feasibility_tol = solver_opts.at("ipopt.tol").to_double();
+
+            Deadline = std::make_shared<DeadlineCallback>("deadline", opt_var.size1(), lbg.size1(), nlp_params.size1(),
+                                                          casadi::DM(lbg), casadi::DM(ubg), feasibility_tol);
+            solver_opts["iteration_callback"] = *Deadline;
+        }
+
+        /** the hot path has no stats: a failed solve has to show in the return flag */
+        if(HOT_PATH)
+            solver_opts["error_on_fail"] = true;
+
+        NLP_Solver = mapped ? cached_nlpsol("solver", backend, MappedNLP, core_key(), solver_opts)
+                            : cached_nlpsol("solver", backend, NLP, core_key(), solver_opts);
+    }
+
+    if(SENSITIVITY)
+        KKTSensitivity = NLPSensitivity::kkt_function(NLP);
+
+    /** RTI evaluates the collocation functions directly */
+    if(RTI)
+    {
+        DynamicConstraints = cached_function(DynamicConstraints, OPTS, core_key());
+        m_Jacobian         = cached_function(m_Jacobian, OPTS, core_key());
+        m_GaussNewton      = cached_function(m_GaussNewton, OPTS, core_key());
+    }
+
+    std::shared_ptr<SolverCore> core = std::make_shared<SolverCore>();
+    core->NLP                = NLP;
+    core->MappedNLP          = MappedNLP;
+    core->NLP_Solver         = NLP_Solver;
+    core->IPSolver           = IPSolver;
+    core->ReducedSolver      = ReducedSolver;
+    core->KKTSensitivity     = KKTSensitivity;
+    core->QP_Solver          = QP_Solver;
+    core->DynamicsFunc       = DynamicsFunc;
+    core->DynamicConstraints = DynamicConstraints;
+    core->PerformanceIndex   = PerformanceIndex;
+    core->PathError          = PathError;
+    core->m_Jacobian         = m_Jacobian;
+    core->m_GaussNewton      = m_GaussNewton;
+    core->ShiftOpT           = ShiftOpT;
+    core->lbx = lbx;
+    core->ubx = ubx;
+    core->lbg = lbg;
+    core->ubg = ubg;
+    core->Deadline = Deadline;
+    return core;
+}
+
+/** per-instance handles to the shared functions */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::load_core(const SolverCore &core)
+{
+    NLP                = core.NLP;
+    MappedNLP          = core.MappedNLP;
+    NLP_Solver         = core.NLP_Solver;
+    IPSolver           = core.IPSolver;
+    ReducedSolver      = core.ReducedSolver;
+    KKTSensitivity     = core.KKTSensitivity;
+    Sensitivity.init(KKTSensitivity);
+    QP_Solver          = core.QP_Solver;
+    DynamicsFunc       = core.DynamicsFunc;
+    DynamicConstraints = core.DynamicConstraints;
+    PerformanceIndex   = core.PerformanceIndex;
+    PathError          = core.PathError;
+    m_Jacobian         = core.m_Jacobian;
+    m_GaussNewton      = core.m_GaussNewton;
+    ShiftOpT           = core.ShiftOpT;
+    Deadline           = core.Deadline;
+}
+
+/** everything the formulation depends on: model, discretization, scaling, bounds and solver options */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+std::string nmpc<System, NX, NU, NumSegments, PolyOrder>::core_key()
+{
+    std::ostringstream key;
+    key << std::setprecision(17) << typeid(*this).name() << " " << function_fingerprint(system.getDynamics()) << " "
+        << function_fingerprint(system.getOutputMapping()) << " " << Tf << " " << scale << " "
+        << Scale_X << Scale_U << LBX << UBX << LBU << UBU << LBG << UBG << " "
+        << (ContraintsFunc.is_null() ? std::string() : function_fingerprint(ContraintsFunc)) << " "
+        << collocation_map << " " << sampling_time << " " << RTI << " " << CONDENSE << " " << SENSITIVITY << " " << GAUSS_NEWTON << " " << NODE_HESSIAN << " "
+        << (deadline > 0) << " " << HOT_PATH << " " << OPTS;
+    return key.str();
+}
+
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi::Dict &solver_options)
+{
+    const int num_nodes = NumSegments * PolyOrder + 1;
+    NUM_COLLOCATION_POINTS = NumSegments * PolyOrder;
 
     /** default solver options */
     OPTS["ipopt.linear_solver"]         = "ma97";
@@ -339,19 +962,48 @@ void nmpc<System, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi::Dict
     if(!solver_options.empty())
         updateParams(solver_options);
 
-    NLP_Solver = casadi::nlpsol("solver", "ipopt", NLP, OPTS);
+    /** identical problems share one core, the deadline callback keeps the iterates in the caller's session */
+    Core = SolverRegistry<SolverCore>::get(core_key(), [this]{return build_core();});
+    load_core(*Core);
 
     /** set default args */
-    ARG["lbx"] = lbx;
-    ARG["ubx"] = ubx;
-    ARG["lbg"] = lbg;
-    ARG["ubg"] = ubg;
+    ARG["lbx"] = Core->lbx;
+    ARG["ubx"] = Core->ubx;
+    ARG["lbg"] = Core->lbg;
+    ARG["ubg"] = Core->ubg;
+    update_parameters();
 
     casadi::DM feasible_state = casadi::DM::zeros(UBX.size());
     casadi::DM feasible_control = casadi::DM::zeros(UBU.size());
 
-    ARG["x0"] = casadi::DM::vertcat(casadi::DMVector{casadi::DM::repmat(feasible_state, poly_order * num_segments + 1, 1),
-                                     casadi::DM::repmat(feasible_control, poly_order * num_segments + 1, 1)});
+    ARG["x0"] = casadi::DM::vertcat(casadi::DMVector{casadi::DM::repmat(feasible_state, num_nodes, 1),
+                                     casadi::DM::repmat(feasible_control, num_nodes, 1)});
+
+    /** numeric solution buffers */
+    OptimalTrajectoryData.assign(NX * num_nodes, 0);
+    OptimalControlData.assign(NU * num_nodes, 0);
+
+    /** a rebuild keeps the (saved or loaded) records while the problem sizes are unchanged */
+    SolutionDB.init(solution_db_capacity, NX, ARG["lbx"].size1(), ARG["lbg"].size1(), solution_db_spacing);
+
+    /** preallocate everything the hot path touches */
+    if(HOT_PATH)
+    {
+        SolverWS.init(NLP_Solver);
+        ws_x0     = SolverWS.index_in("x0");
+        ws_lbx    = SolverWS.index_in("lbx");
+        ws_ubx    = SolverWS.index_in("ubx");
+        ws_lam_x0 = SolverWS.index_in("lam_x0");
+        ws_lam_g0 = SolverWS.index_in("lam_g0");
+        ws_x      = SolverWS.index_out("x");
+        ws_lam_x  = SolverWS.index_out("lam_x");
+        ws_lam_g  = SolverWS.index_out("lam_g");
+
+        m_x0.assign(NX, 0);
+        if(!ShiftOpT.is_empty())
+            m_shift = casadi::DM::densify(ShiftOpT).nonzeros();
+        args_dirty = true;
+    }
 }
 
 template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
@@ -359,9 +1011,27 @@ void nmpc<System, NX, NU, NumSegments, PolyOrder>::computeControl(const casadi::
 {
     int N = NUM_COLLOCATION_POINTS;
 
+    if(HOT_PATH && !RTI)
+    {
+        /** the nonzeros of a sparse state are not the state vector */
+        assert(_X0.numel() == NX);
+        if(_X0.is_dense())
+            hot_path_solve(_X0.ptr());
+        else
+            hot_path_solve(casadi::DM::densify(_X0).ptr());
+        return;
+    }
+
     /** rectify virtual state */
     casadi::DM X0 = casadi::DM::mtimes(Scale_X, _X0);
 
+    /** RTI feedback phase: the full solve is only used to initialize the scheme */
+    if(RTI && WARM_START)
+    {
+        rti_feedback(X0);
+        return;
+    }
+
     /** scale input */
     int idx_theta;
     std::cout << "Compute control at: " << X0 << "\n";
@@ -373,51 +1043,529 @@ void nmpc<System, NX, NU, NumSegments, PolyOrder>::computeControl(const casadi::
         ARG["lbx"](casadi::Slice(idx_in, idx_out), 0) = X0;
         ARG["ubx"](casadi::Slice(idx_in, idx_out), 0) = X0;
 
+        shift_solution();
         ARG["x0"]     = NLP_X;
         ARG["lam_g0"] = NLP_LAM_G;
         ARG["lam_x0"] = NLP_LAM_X;
+
+        /** recovery: the last solve failed, the stored solution of the nearest state replaces the shifted one */
+        if(solve_status != SOLVE_SUCCESS)
+            load_database_guess(X0);
     }
     else
     {
-        ARG["x0"](casadi::Slice(0, (N + 1) * NX), 0) = casadi::DM::repmat(X0, (N + 1), 1);
+        /** cold start: the stored solution of the nearest state or the constant state */
+        if(!load_database_guess(X0))
+            ARG["x0"](casadi::Slice(0, (N + 1) * NX), 0) = casadi::DM::repmat(X0, (N + 1), 1);
         int idx_in = N * NX;
         int idx_out = idx_in + NX;
         ARG["lbx"](casadi::Slice(idx_in, idx_out), 0) = X0;
         ARG["ubx"](casadi::Slice(idx_in, idx_out), 0) = X0;
     }
 
+    if(Deadline)
+        DeadlineCallback::start(DeadlineState, deadline);
+
     /** store optimal solution */
     casadi::DMDict res = NLP_Solver(ARG);
+    DeadlineCallback::stop();
     NLP_X     = res.at("x");
     NLP_LAM_X = res.at("lam_x");
     NLP_LAM_G = res.at("lam_g");
 
-    casadi::DM opt_x = NLP_X(casadi::Slice(0, (N + 1) * NX));
-    //DM invSX = DM::solve(Scale_X, DM::eye(15));
-    OptimalTrajectory = casadi::DM::mtimes(invSX, casadi::DM::reshape(opt_x, NX, N + 1));
-    //casadi::DM opt_u = NLP_X( casadi::Slice((N + 1) * NX, NLP_X.size1()) );
-    casadi::DM opt_u = NLP_X( casadi::Slice((N + 1) * NX, (N + 1) * NX + (N + 1) * NU ) );
-    //DM invSU = DM::solve(Scale_U, DM::eye(4));
-    OptimalControl = casadi::DM::mtimes(invSU, casadi::DM::reshape(opt_u, NU, N + 1));
-
-    stats = NLP_Solver.stats();
+    stats = solver_stats();
     std::cout << stats << "\n";
 
-    std::string solve_status = static_cast<std::string>(stats["return_status"]);
-    if(solve_status.compare("Invalid_Number_Detected") == 0)
+    std::string return_status = static_cast<std::string>(stats["return_status"]);
+    if(return_status.compare("Invalid_Number_Detected") == 0)
     {
         std::cout << "X0 : " << ARG["x0"] << "\n";
         //assert(false);
     }
-    if(solve_status.compare("Infeasible_Problem_Detected") == 0)
+    if(return_status.compare("Infeasible_Problem_Detected") == 0)
     {
         std::cout << "X0 : " << ARG["x0"] << "\n";
         //assert(false);
     }
 
+    solve_status = SOLVE_SUCCESS;
+    if(!static_cast<bool>(stats["success"]))
+        apply_fallback(X0);
+    store_solution();
+
+    if(SENSITIVITY && (solve_status == SOLVE_SUCCESS))
+        prepare_sensitivity();
+
+    if(SolutionDB.enabled() && (solve_status == SOLVE_SUCCESS))
+    {
+        std::vector<double> x0 = casadi::DM::densify(X0).nonzeros();
+        std::vector<double> w = casadi::DM::densify(NLP_X).nonzeros();
+        std::vector<double> lam_g = casadi::DM::densify(NLP_LAM_G).nonzeros();
+        std::vector<double> lam_x = casadi::DM::densify(NLP_LAM_X).nonzeros();
+        SolutionDB.insert(Eigen::Map<Eigen::VectorXd>(x0.data(), x0.size()),
+                          Eigen::Map<Eigen::VectorXd>(w.data(), w.size()),
+                          Eigen::Map<Eigen::VectorXd>(lam_g.data(), lam_g.size()),
+                          Eigen::Map<Eigen::VectorXd>(lam_x.data(), lam_x.size()));
+    }
+
+    enableWarmStart();
+    rti_prepared = false;
+}
+
+/** initial guess blended from the database, the initial state slot is set to the (scaled) state X0 */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+bool nmpc<System, NX, NU, NumSegments, PolyOrder>::load_database_guess(const casadi::DM &X0)
+{
+    std::vector<double> x0 = casadi::DM::densify(X0).nonzeros();
+    Eigen::VectorXd w, lam_g, lam_x;
+    if(!SolutionDB.lookup(Eigen::Map<Eigen::VectorXd>(x0.data(), x0.size()), solution_db_neighbours, w, lam_g, lam_x))
+        return false;
+
+    const int idx_in = NUM_COLLOCATION_POINTS * NX;
+    ARG["x0"]     = casadi::DM(std::vector<double>(w.data(), w.data() + w.size()));
+    ARG["lam_g0"] = casadi::DM(std::vector<double>(lam_g.data(), lam_g.data() + lam_g.size()));
+    ARG["lam_x0"] = casadi::DM(std::vector<double>(lam_x.data(), lam_x.data() + lam_x.size()));
+    ARG["x0"](casadi::Slice(idx_in, idx_in + NX), 0) = X0;
+    return true;
+}
+
+/** Eigen overload: the hot path reads the state in place, otherwise it is converted once */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::computeControl(const Eigen::Ref<const Eigen::VectorXd> &_X0)
+{
+    assert(_X0.size() == NX);
+    if(HOT_PATH && !RTI)
+    {
+        hot_path_solve(_X0.data());
+        return;
+    }
+
+    computeControl(casadi::DM(std::vector<double>(_X0.data(), _X0.data() + NX)));
+}
+
+/** factorize the KKT system at the last solution, the initial state enters through the fixed bounds */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::prepare_sensitivity()
+{
+    if(!Sensitivity.factorize(ARG, NLP_X, NLP_LAM_X, NLP_LAM_G))
+    {
+        std::cout << "nmpc: KKT matrix at the solution is singular, no tangential predictor \n";
+        return;
+    }
+
+    const int n_w = NLP_X.size1();
+    const int idx_x0 = NUM_COLLOCATION_POINTS * NX;
+    m_sens_x0.resize(n_w, NX);
+    for(int i = 0; i < NX; ++i)
+    {
+        Eigen::VectorXd dbx = Eigen::VectorXd::Zero(n_w);
+        dbx[idx_x0 + i] = 1.0;
+        m_sens_x0.col(i) = Sensitivity.primal_step(Eigen::VectorXd(), dbx);
+    }
+}
+
+/** tangential predictor: w = w* + dw/dX0 * dX0 + dw/dp * dp */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+bool nmpc<System, NX, NU, NumSegments, PolyOrder>::predictControl(const casadi::DM &_X0)
+{
+    if(!Sensitivity.factorized())
+        return false;
+
+    const int idx_x0 = NUM_COLLOCATION_POINTS * NX;
+    std::vector<double> x0 = casadi::DM::densify(casadi::DM::mtimes(Scale_X, _X0)).nonzeros();
+    const Eigen::VectorXd &w = Sensitivity.solution();
+    Eigen::VectorXd dw = m_sens_x0 * (Eigen::Map<Eigen::VectorXd>(x0.data(), NX) - w.segment(idx_x0, NX));
+
+    /** parameters changed since the solve: one more back substitution */
+    std::vector<double> p = casadi::DM::densify(ARG["p"]).nonzeros();
+    Eigen::VectorXd dp = Eigen::Map<Eigen::VectorXd>(p.data(), p.size()) - Sensitivity.parameters();
+    if(dp.lpNorm<Eigen::Infinity>() > 0)
+        dw += Sensitivity.primal_step(dp, Eigen::VectorXd::Zero(w.size()));
+
+    Eigen::VectorXd w_pred = w + dw;
+    store_solution(casadi::DM(std::vector<double>(w_pred.data(), w_pred.data() + w_pred.size())));
+    return true;
+}
+
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+bool nmpc<System, NX, NU, NumSegments, PolyOrder>::predictControl(const Eigen::Ref<const Eigen::VectorXd> &_X0)
+{
+    assert(_X0.size() == NX);
+    return predictControl(casadi::DM(std::vector<double>(_X0.data(), _X0.data() + NX)));
+}
+
+/** columns: measured state (unscaled) and NLP parameters */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+casadi::DM nmpc<System, NX, NU, NumSegments, PolyOrder>::getSensitivity()
+{
+    if(!Sensitivity.factorized())
+        return casadi::DM();
+
+    const int n_w = Sensitivity.solution().size();
+    const int n_p = Sensitivity.parameters().size();
+    std::vector<double> scale_x = casadi::DM::densify(Scale_X(casadi::Slice(0, NX), casadi::Slice(0, NX))).nonzeros();
+
+    Eigen::MatrixXd sens(n_w, NX + n_p);
+    sens.leftCols(NX) = m_sens_x0 * Eigen::Map<Eigen::MatrixXd>(scale_x.data(), NX, NX);
+    for(int j = 0; j < n_p; ++j)
+        sens.col(NX + j) = Sensitivity.primal_step(Eigen::VectorXd::Unit(n_p, j), Eigen::VectorXd::Zero(n_w));
+
+    return polymath::eigen2casadi<casadi::DM>(sens);
+}
+
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+bool nmpc<System, NX, NU, NumSegments, PolyOrder>::exportController(const std::string &dir, const std::string &name)
+{
+    const int N = NUM_COLLOCATION_POINTS;
+
+    ControllerExport problem;
+    problem.nlp   = !NLP.empty() ? NLP : expand_nlp(MappedNLP, casadi::SX::sym("w", ARG["lbx"].size1()),
+                                                    casadi::SX::sym("p", ARG["p"].size1()));
+    problem.lbx   = ARG["lbx"];
+    problem.ubx   = ARG["ubx"];
+    problem.lbg   = ARG["lbg"];
+    problem.ubg   = ARG["ubg"];
+    problem.w0    = ARG["x0"];
+    problem.p0    = ARG["p"];
+    problem.state_scaling   = Scale_X(casadi::Slice(0, NX), casadi::Slice(0, NX));
+    problem.control_scaling = invSU;
+    problem.state_index     = N * NX;
+    problem.control_index   = (N + 1) * NX + N * NU;
+    problem.nx = NX;
+    problem.nu = NU;
+    problem.node_times = Chebyshev<casadi::SX, PolyOrder, NumSegments, NX, NU, 0>::NodeTimes(0, Tf);
+    problem.opts = OPTS;
+    return export_controller(dir, name, problem);
+}
+
+/** anytime fallback after a failed or interrupted solve */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::apply_fallback(const casadi::DM &X0)
+{
+    int N = NUM_COLLOCATION_POINTS;
+
+    if(Deadline && DeadlineState.has_iterate())
+    {
+        NLP_X     = DeadlineState.x;
+        NLP_LAM_X = DeadlineState.lam_x;
+        NLP_LAM_G = DeadlineState.lam_g;
+        solve_status = SOLVE_ITERATE;
+    }
+    else if(WARM_START)
+    {
+        /** the initial guess holds the time-shifted previous solution, pinned to the measured state */
+        NLP_X     = ARG["x0"];
+        NLP_LAM_X = ARG["lam_x0"];
+        NLP_LAM_G = ARG["lam_g0"];
+        NLP_X(casadi::Slice(N * NX, (N + 1) * NX), 0) = X0;
+        solve_status = SOLVE_SHIFTED;
+    }
+    else
+    {
+        solve_status = SOLVE_FAILED;
+    }
+
+    std::cout << "nmpc: solver returned " << stats["return_status"] << ", fallback status: " << solve_status << "\n";
+}
+
+/** RTI preparation phase: build the QP around the current guess, independent of the new state */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::prepareControl()
+{
+    if(!RTI || rti_prepared || NLP_X.is_empty())
+        return;
+
+    /** linearize around the shifted previous solution */
+    shift_solution();
+
+    casadi::DMVector gauss_newton = m_GaussNewton(casadi::DMVector{NLP_X, ARG["p"]});
+    casadi::DM constr = DynamicConstraints(casadi::DMVector{NLP_X})[0];
+
+    QP_ARG["h"]   = gauss_newton[0];
+    QP_ARG["g"]   = gauss_newton[1];
+    QP_ARG["a"]   = m_Jacobian(casadi::DMVector{NLP_X})[0];
+    QP_ARG["lba"] = ARG["lbg"] - constr;
+    QP_ARG["uba"] = ARG["ubg"] - constr;
+    QP_ARG["lbx"] = ARG["lbx"] - NLP_X;
+    QP_ARG["ubx"] = ARG["ubx"] - NLP_X;
+    QP_ARG["lam_x0"] = NLP_LAM_X;
+    QP_ARG["lam_a0"] = NLP_LAM_G;
+
+    rti_prepared = true;
+}
+
+/** RTI feedback phase: embed the measured state and solve a single QP */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::rti_feedback(const casadi::DM &X0)
+{
+    if(!rti_prepared)
+        prepareControl();
+
+    int idx_in  = NUM_COLLOCATION_POINTS * NX;
+    int idx_out = idx_in + NX;
+    ARG["lbx"](casadi::Slice(idx_in, idx_out), 0) = X0;
+    ARG["ubx"](casadi::Slice(idx_in, idx_out), 0) = X0;
+
+    /** initial state constraint on the step */
+    casadi::DM dx0 = X0 - NLP_X(casadi::Slice(idx_in, idx_out));
+    QP_ARG["lbx"](casadi::Slice(idx_in, idx_out), 0) = dx0;
+    QP_ARG["ubx"](casadi::Slice(idx_in, idx_out), 0) = dx0;
+
+    casadi::DMDict res = QP_Solver(QP_ARG);
+    NLP_X     = NLP_X + res.at("x");
+    NLP_LAM_X = res.at("lam_x");
+    NLP_LAM_G = res.at("lam_a");
+    store_solution();
+
+    stats = QP_Solver.stats();
+    rti_prepared = false;
+}
+
+/** shift the primal-dual solution forward by one sampling interval */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::shift_solution()
+{
+    if(ShiftOpT.is_empty() || NLP_X.is_empty())
+        return;
+
+    int N = NUM_COLLOCATION_POINTS;
+    casadi::Slice x_var(0, (N + 1) * NX);
+    casadi::Slice u_var((N + 1) * NX, (N + 1) * (NX + NU));
+
+    /** states and controls */
+    NLP_X(x_var, 0) = casadi::DM::vec(casadi::DM::mtimes(casadi::DM::reshape(NLP_X(x_var), NX, N + 1), ShiftOpT));
+    NLP_X(u_var, 0) = casadi::DM::vec(casadi::DM::mtimes(casadi::DM::reshape(NLP_X(u_var), NU, N + 1), ShiftOpT));
+
+    /** bound multipliers */
+    NLP_LAM_X(x_var, 0) = casadi::DM::vec(casadi::DM::mtimes(casadi::DM::reshape(NLP_LAM_X(x_var), NX, N + 1), ShiftOpT));
+    NLP_LAM_X(u_var, 0) = casadi::DM::vec(casadi::DM::mtimes(casadi::DM::reshape(NLP_LAM_X(u_var), NU, N + 1), ShiftOpT));
+
+    /** dynamics multipliers: the initial node has no collocation equation, extend with the last one */
+    const int nh = LBG.size1();
+    casadi::DM lam_g = casadi::DM::reshape(NLP_LAM_G(casadi::Slice(0, N * NX)), NX, N);
+    lam_g = casadi::DM::horzcat({lam_g, lam_g(casadi::Slice(), N - 1)});
+    lam_g = casadi::DM::mtimes(lam_g, ShiftOpT);
+
+    /** path constraint multipliers: one column per node */
+    casadi::DM lam_h = casadi::DM::reshape(NLP_LAM_G(casadi::Slice(N * NX, N * NX + nh * (N + 1))), nh, N + 1);
+    lam_h = casadi::DM::mtimes(lam_h, ShiftOpT);
+    NLP_LAM_G = casadi::DM::vertcat({casadi::DM::vec(lam_g(casadi::Slice(), casadi::Slice(0, N))), casadi::DM::vec(lam_h)});
+}
+
+/** low-level solve: no heap allocations on the polympc side after the first call */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::hot_path_solve(const double *x_meas)
+{
+    const int N         = NUM_COLLOCATION_POINTS;
+    const int num_nodes = N + 1;
+    const int dim_x     = num_nodes * NX;
+    const int dim_w     = num_nodes * (NX + NU);
+
+    if(args_dirty)
+        sync_arguments();
+
+    /** scale the measured state */
+    for(int i = 0; i < NX; ++i)
+    {
+        double value = 0;
+        for(int j = 0; j < NX; ++j)
+            value += m_scale_x[j * NX + i] * x_meas[j];
+        m_x0[i] = value;
+    }
+
+    /** initial state constraint */
+    double *lbx = SolverWS.input(ws_lbx);
+    double *ubx = SolverWS.input(ws_ubx);
+    std::copy(m_x0.begin(), m_x0.end(), lbx + N * NX);
+    std::copy(m_x0.begin(), m_x0.end(), ubx + N * NX);
+
+    double *x0     = SolverWS.input(ws_x0);
+    double *lam_x0 = SolverWS.input(ws_lam_x0);
+    double *lam_g0 = SolverWS.input(ws_lam_g0);
+    const double *x     = SolverWS.output(ws_x);
+    const double *lam_x = SolverWS.output(ws_lam_x);
+    const double *lam_g = SolverWS.output(ws_lam_g);
+
+    if(WARM_START && !m_shift.empty())
+    {
+        shift_nodes(x, x0, NX, num_nodes);
+        shift_nodes(x + dim_x, x0 + dim_x, NU, num_nodes);
+        shift_nodes(lam_x, lam_x0, NX, num_nodes);
+        shift_nodes(lam_x + dim_x, lam_x0 + dim_x, NU, num_nodes);
+        shift_nodes(lam_g, lam_g0, NX, N);
+        shift_nodes(lam_g + N * NX, lam_g0 + N * NX, static_cast<int>(LBG.size1()), num_nodes);
+    }
+    else if(WARM_START)
+    {
+        std::copy(x, x + dim_w, x0);
+        std::copy(lam_x, lam_x + dim_w, lam_x0);
+        std::copy(lam_g, lam_g + SolverWS.nnz_out(ws_lam_g), lam_g0);
+    }
+    else
+    {
+        for(int k = 0; k < num_nodes; ++k)
+            std::copy(m_x0.begin(), m_x0.end(), x0 + k * NX);
+        std::fill(lam_x0, lam_x0 + dim_w, 0.0);
+        std::fill(lam_g0, lam_g0 + SolverWS.nnz_in(ws_lam_g0), 0.0);
+    }
+
+    if(Deadline)
+        DeadlineCallback::start(DeadlineState, deadline);
+
+    /** the solver runs with "error_on_fail": a solve that did not converge returns a nonzero flag or throws */
+    try
+    {
+        solve_flag = SolverWS.eval();
+    }
+    catch(std::exception&)
+    {
+        solve_flag = 1;
+    }
+    DeadlineCallback::stop();
+
+    solve_status = SOLVE_SUCCESS;
+    if((solve_flag != 0) || (Deadline && DeadlineState.expired))
+    {
+        /** fallback in the output buffers, they are the next warm start as well */
+        double *x_out     = SolverWS.output(ws_x);
+        double *lam_x_out = SolverWS.output(ws_lam_x);
+        double *lam_g_out = SolverWS.output(ws_lam_g);
+        if(Deadline && DeadlineState.has_iterate())
+        {
+            std::copy(DeadlineState.x.ptr(), DeadlineState.x.ptr() + dim_w, x_out);
+            std::copy(DeadlineState.lam_x.ptr(), DeadlineState.lam_x.ptr() + dim_w, lam_x_out);
+            std::copy(DeadlineState.lam_g.ptr(), DeadlineState.lam_g.ptr() + SolverWS.nnz_out(ws_lam_g), lam_g_out);
+            solve_status = SOLVE_ITERATE;
+        }
+        else if(WARM_START)
+        {
+            /** the initial guess holds the (time-shifted) previous solution, pinned to the measured state */
+            std::copy(x0, x0 + dim_w, x_out);
+            std::copy(lam_x0, lam_x0 + dim_w, lam_x_out);
+            std::copy(lam_g0, lam_g0 + SolverWS.nnz_out(ws_lam_g), lam_g_out);
+            std::copy(m_x0.begin(), m_x0.end(), x_out + N * NX);
+            solve_status = SOLVE_SHIFTED;
+        }
+        else
+        {
+            solve_status = SOLVE_FAILED;
+        }
+    }
+
+    /** unscale the solution */
+    for(int k = 0; k < num_nodes; ++k)
+    {
+        for(int i = 0; i < NX; ++i)
+        {
+            double value = 0;
+            for(int j = 0; j < NX; ++j)
+                value += m_inv_sx[j * NX + i] * x[k * NX + j];
+            OptimalTrajectoryData[k * NX + i] = value;
+        }
+        for(int i = 0; i < NU; ++i)
+        {
+            double value = 0;
+            for(int j = 0; j < NU; ++j)
+                value += m_inv_su[j * NU + i] * x[dim_x + k * NU + j];
+            OptimalControlData[k * NU + i] = value;
+        }
+    }
+
+    solution_outdated = true;
     enableWarmStart();
 }
 
+/** out(:, j) = sum_i S(j, i) * in(:, i), columns beyond 'num_cols' repeat the last one */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::shift_nodes(const double *in, double *out, const int &dim, const int &num_cols)
+{
+    const int num_nodes = NUM_COLLOCATION_POINTS + 1;
+    for(int j = 0; j < num_cols; ++j)
+    {
+        double *out_col = out + j * dim;
+        std::fill(out_col, out_col + dim, 0.0);
+        for(int i = 0; i < num_nodes; ++i)
+        {
+            double s_ji = m_shift[j * num_nodes + i];
+            if(s_ji == 0)
+                continue;
+            const double *in_col = in + std::min(i, num_cols - 1) * dim;
+            for(int n = 0; n < dim; ++n)
+                out_col[n] += s_ji * in_col[n];
+        }
+    }
+}
+
+/** copy bounds, parameters and scaling into the preallocated buffers */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::sync_arguments()
+{
+    if(!SolverWS.initialized())
+        return;
+
+    SolverWS.set_input(ws_lbx, casadi::DM::densify(ARG["lbx"]));
+    SolverWS.set_input(ws_ubx, casadi::DM::densify(ARG["ubx"]));
+    SolverWS.set_input(SolverWS.index_in("lbg"), casadi::DM::densify(ARG["lbg"]));
+    SolverWS.set_input(SolverWS.index_in("ubg"), casadi::DM::densify(ARG["ubg"]));
+    SolverWS.set_input(SolverWS.index_in("p"), casadi::DM::densify(ARG["p"]));
+    if(!WARM_START)
+        SolverWS.set_input(ws_x0, casadi::DM::densify(ARG["x0"]));
+
+    m_scale_x = casadi::DM::densify(Scale_X).nonzeros();
+    m_inv_sx  = casadi::DM::densify(invSX).nonzeros();
+    m_inv_su  = casadi::DM::densify(invSU).nonzeros();
+    args_dirty = false;
+}
+
+/** convert the hot path solution buffers on demand */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::sync_solution()
+{
+    if(!solution_outdated)
+        return;
+
+    const int num_nodes = NUM_COLLOCATION_POINTS + 1;
+    OptimalTrajectory = casadi::DM::reshape(casadi::DM(OptimalTrajectoryData), NX, num_nodes);
+    OptimalControl    = casadi::DM::reshape(casadi::DM(OptimalControlData), NU, num_nodes);
+    solution_outdated = false;
+}
+
+/** statistics of the last NLP solve: the wrapped solvers report their own */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+casadi::Dict nmpc<System, NX, NU, NumSegments, PolyOrder>::solver_stats()
+{
+    if(IPSolver)
+        return IPSolver->get_stats();
+    if(!ReducedSolver.is_null())
+        return ReducedSolver.stats();
+    return NLP_Solver.stats();
+}
+
+/** unscale and reshape the primal solution */
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::store_solution()
+{
+    store_solution(NLP_X);
+}
+
+template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpc<System, NX, NU, NumSegments, PolyOrder>::store_solution(const casadi::DM &w)
+{
+    int N = NUM_COLLOCATION_POINTS;
+
+    casadi::DM opt_x = w(casadi::Slice(0, (N + 1) * NX));
+    //DM invSX = DM::solve(Scale_X, DM::eye(15));
+    OptimalTrajectory = casadi::DM::mtimes(invSX, casadi::DM::reshape(opt_x, NX, N + 1));
+    //casadi::DM opt_u = NLP_X( casadi::Slice((N + 1) * NX, NLP_X.size1()) );
+    casadi::DM opt_u = w( casadi::Slice((N + 1) * NX, (N + 1) * NX + (N + 1) * NU ) );
+    //DM invSU = DM::solve(Scale_U, DM::eye(4));
+    OptimalControl = casadi::DM::mtimes(invSU, casadi::DM::reshape(opt_u, NU, N + 1));
+
+    /** keep the numeric buffers behind the Eigen views in sync */
+    OptimalTrajectoryData = casadi::DM::densify(OptimalTrajectory).nonzeros();
+    OptimalControlData    = casadi::DM::densify(OptimalControl).nonzeros();
+}
+
 /** get path error */
 template<typename System, int NX, int NU, int NumSegments, int PolyOrder>
 double nmpc<System, NX, NU, NumSegments, PolyOrder>::getPathError()
@@ -427,7 +1575,7 @@ double nmpc<System, NX, NU, NumSegments, PolyOrder>::getPathError()
     {
         casadi::DM state = OptimalTrajectory(casadi::Slice(0, OptimalTrajectory.size1()), OptimalTrajectory.size2() - 1);
         state = casadi::DM::mtimes(Scale_X, state);
-        casadi::DMVector tmp = PathError(casadi::DMVector{state});
+        casadi::DMVector tmp = PathError(casadi::DMVector{state, Reference(casadi::Slice(), Reference.size2() - 1)});
         error = casadi::DM::norm_2( tmp[0] ).nonzeros()[0];
     }
     return error;
@@ -0,0 +1,210 @@
+#ifndef NMPC_BATCH_HPP
+#define NMPC_BATCH_HPP
+
+#include <cassert>
+#include <memory>
+#include "nmpc.hpp"
+#include "thread_pool.hpp"
+
+namespace polympc {
+
+/** Solves many instances of the same nmpc problem concurrently. All instances share the prototype's compiled
+ *  solver; every pool thread owns a checked-out solver memory and preallocated buffers. Each instance keeps its
+ *  own primal-dual warm start. The linear solver must be thread-safe (e.g. the HSL solvers, not MUMPS) */
+template<typename Controller>
+class BatchController
+{
+public:
+    typedef typename Controller::control_trajectory_t control_trajectory_t;
+    typedef typename Controller::trajectory_t         trajectory_t;
+
+    BatchController(Controller &prototype, const int &num_threads = 0);
+    ~BatchController(){}
+
+    /** solve one problem per initial state. 'params' holds one NLP parameter vector per instance in the
+     *  prototype's layout [vec(reference at the nodes); w_q; w_r; w_p], empty: the prototype's parameters */
+    void solve(const std::vector<Eigen::VectorXd> &X0, const std::vector<casadi::DM> &params = std::vector<casadi::DM>());
+
+    int size() const {return static_cast<int>(m_instances.size());}
+    const control_trajectory_t& getOptimalControl(const int &i) const {return m_instances[i].controls;}
+    const trajectory_t& getOptimalTrajectory(const int &i) const {return m_instances[i].trajectory;}
+    int getSolveFlag(const int &i) const {return m_instances[i].flag;}
+
+    void resetWarmStart();
+
+private:
+    Controller &m_prototype;
+    ThreadPool  m_pool;
+    std::vector<std::unique_ptr<FunctionWorkspace>> m_workspaces;
+    /** per-worker deadline state, the prototype's deadline callback is shared */
+    std::vector<DeadlineCallback::Session> m_sessions;
+
+    /** per-instance data */
+    struct Instance
+    {
+        std::vector<double>  p, x, lam_x, lam_g;
+        bool                 warm;
+        int                  flag;
+        control_trajectory_t controls;
+        trajectory_t         trajectory;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+    std::vector<Instance, Eigen::aligned_allocator<Instance>> m_instances;
+
+    /** shared, read-only during a batch */
+    std::vector<double> m_lbx, m_ubx, m_lbg, m_ubg, m_p, m_guess;
+    std::vector<double> m_scale_x, m_inv_sx, m_inv_su;
+    int ws_x0, ws_p, ws_lbx, ws_ubx, ws_lbg, ws_ubg, ws_lam_x0, ws_lam_g0, ws_x, ws_lam_x, ws_lam_g;
+
+    void solve_instance(const int &i, const double *x0, FunctionWorkspace &ws, DeadlineCallback::Session &session);
+};
+
+template<typename Controller>
+BatchController<Controller>::BatchController(Controller &prototype, const int &num_threads) :
+    m_prototype(prototype), m_pool(num_threads)
+{
+    for(int i = 0; i < m_pool.size(); ++i)
+        m_workspaces.push_back(std::unique_ptr<FunctionWorkspace>(new FunctionWorkspace(prototype.NLP_Solver)));
+    m_sessions.resize(m_pool.size());
+
+    const FunctionWorkspace &ws = *m_workspaces.front();
+    ws_x0     = ws.index_in("x0");
+    ws_p      = ws.index_in("p");
+    ws_lbx    = ws.index_in("lbx");
+    ws_ubx    = ws.index_in("ubx");
+    ws_lbg    = ws.index_in("lbg");
+    ws_ubg    = ws.index_in("ubg");
+    ws_lam_x0 = ws.index_in("lam_x0");
+    ws_lam_g0 = ws.index_in("lam_g0");
+    ws_x      = ws.index_out("x");
+    ws_lam_x  = ws.index_out("lam_x");
+    ws_lam_g  = ws.index_out("lam_g");
+}
+
+template<typename Controller>
+void BatchController<Controller>::resetWarmStart()
+{
+    for(Instance &instance : m_instances)
+        instance.warm = false;
+}
+
+template<typename Controller>
+void BatchController<Controller>::solve(const std::vector<Eigen::VectorXd> &X0, const std::vector<casadi::DM> &params)
+{
+    /** snapshot the prototype's arguments, the workers only read plain buffers */
+    m_lbx     = casadi::DM::densify(m_prototype.ARG["lbx"]).nonzeros();
+    m_ubx     = casadi::DM::densify(m_prototype.ARG["ubx"]).nonzeros();
+    m_lbg     = casadi::DM::densify(m_prototype.ARG["lbg"]).nonzeros();
+    m_ubg     = casadi::DM::densify(m_prototype.ARG["ubg"]).nonzeros();
+    m_p       = casadi::DM::densify(m_prototype.ARG["p"]).nonzeros();
+    m_guess   = casadi::DM::densify(m_prototype.ARG["x0"]).nonzeros();
+    m_scale_x = casadi::DM::densify(m_prototype.Scale_X).nonzeros();
+    m_inv_sx  = casadi::DM::densify(m_prototype.invSX).nonzeros();
+    m_inv_su  = casadi::DM::densify(m_prototype.invSU).nonzeros();
+
+    /** the workers copy the parameters unchecked */
+    if(!params.empty() && (params.size() != X0.size()))
+    {
+        std::cout << "BatchController: " << params.size() << " parameter vectors for " << X0.size()
+                  << " instances, the batch is not solved \n";
+        return;
+    }
+    const int num_params = m_workspaces.front()->nnz_in(ws_p);
+    for(std::size_t i = 0; i < params.size(); ++i)
+    {
+        if(params[i].numel() != num_params)
+        {
+            std::cout << "BatchController: instance " << i << " has " << params[i].numel() << " parameters, the problem "
+                      << "expects " << num_params << ", the batch is not solved \n";
+            return;
+        }
+    }
+
+    if(m_instances.size() != X0.size())
+    {
+        m_instances.resize(X0.size());
+        resetWarmStart();
+    }
+    for(std::size_t i = 0; i < X0.size(); ++i)
+        m_instances[i].p = params.empty() ? m_p : casadi::DM::densify(params[i]).nonzeros();
+
+    m_pool.run(static_cast<int>(X0.size()), [&](int i, int worker)
+    {
+        solve_instance(i, X0[i].data(), *m_workspaces[worker], m_sessions[worker]);
+    });
+}
+
+template<typename Controller>
+void BatchController<Controller>::solve_instance(const int &i, const double *x_meas, FunctionWorkspace &ws,
+                                                 DeadlineCallback::Session &session)
+{
+    const int NX = Controller::state_t::RowsAtCompileTime;
+    const int NU = Controller::control_t::RowsAtCompileTime;
+    const int N  = Controller::NumNodes - 1;
+    const int dim_x = (N + 1) * NX;
+    Instance &instance = m_instances[i];
+
+    std::copy(m_lbx.begin(), m_lbx.end(), ws.input(ws_lbx));
+    std::copy(m_ubx.begin(), m_ubx.end(), ws.input(ws_ubx));
+    std::copy(m_lbg.begin(), m_lbg.end(), ws.input(ws_lbg));
+    std::copy(m_ubg.begin(), m_ubg.end(), ws.input(ws_ubg));
+    assert(static_cast<int>(instance.p.size()) == ws.nnz_in(ws_p));
+    std::copy(instance.p.begin(), instance.p.end(), ws.input(ws_p));
+
+    /** scaled initial state constraint */
+    double *lbx = ws.input(ws_lbx);
+    double *ubx = ws.input(ws_ubx);
+    for(int r = 0; r < NX; ++r)
+    {
+        double value = 0;
+        for(int c = 0; c < NX; ++c)
+            value += m_scale_x[c * NX + r] * x_meas[c];
+        lbx[N * NX + r] = value;
+        ubx[N * NX + r] = value;
+    }
+
+    double *x0 = ws.input(ws_x0);
+    if(instance.warm)
+    {
+        std::copy(instance.x.begin(), instance.x.end(), x0);
+        std::copy(instance.lam_x.begin(), instance.lam_x.end(), ws.input(ws_lam_x0));
+        std::copy(instance.lam_g.begin(), instance.lam_g.end(), ws.input(ws_lam_g0));
+    }
+    else
+    {
+        std::copy(m_guess.begin(), m_guess.end(), x0);
+        for(int k = 0; k <= N; ++k)
+            std::copy(lbx + N * NX, lbx + (N + 1) * NX, x0 + k * NX);
+        std::fill(ws.input(ws_lam_x0), ws.input(ws_lam_x0) + ws.nnz_in(ws_lam_x0), 0.0);
+        std::fill(ws.input(ws_lam_g0), ws.input(ws_lam_g0) + ws.nnz_in(ws_lam_g0), 0.0);
+    }
+
+    if(m_prototype.Deadline)
+        DeadlineCallback::start(session, m_prototype.deadline);
+    try
+    {
+        instance.flag = ws.eval();
+    }
+    catch(std::exception&)
+    {
+        instance.flag = 1;
+    }
+    DeadlineCallback::stop();
+
+    const double *x = ws.output(ws_x);
+    instance.x.assign(x, x + ws.nnz_out(ws_x));
+    instance.lam_x.assign(ws.output(ws_lam_x), ws.output(ws_lam_x) + ws.nnz_out(ws_lam_x));
+    instance.lam_g.assign(ws.output(ws_lam_g), ws.output(ws_lam_g) + ws.nnz_out(ws_lam_g));
+    instance.warm = true;
+
+    /** unscale */
+    Eigen::Map<const Eigen::MatrixXd> inv_sx(m_inv_sx.data(), NX, NX);
+    Eigen::Map<const Eigen::MatrixXd> inv_su(m_inv_su.data(), NU, NU);
+    instance.trajectory = inv_sx * Eigen::Map<const trajectory_t>(x);
+    instance.controls   = inv_su * Eigen::Map<const control_trajectory_t>(x + dim_x);
+}
+
+} // polympc namespace
+
+#endif // NMPC_BATCH_HPP
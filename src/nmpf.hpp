@@ -1,9 +1,20 @@
 #ifndef NMPF_HPP
 #define NMPF_HPP
 
+#include <iomanip>
 #include <memory>
+#include <typeinfo>
 #include "polymath.h"
 #include "chebyshev.hpp"
+#include "nlp_cache.hpp"
+#include "solver_registry.hpp"
+#include "interior_point.hpp"
+#include "nlp_sensitivity.hpp"
+#include "node_hessian.hpp"
+#include "controller_export.hpp"
+#include "path_geometry.hpp"
+#include "path_series.hpp"
+#include "phase_cache.hpp"
 
 namespace polympc {
 
@@ -29,6 +40,19 @@ template <typename System, typename Path, int NX, int NU, int NumSegments = 2, i
 class nmpf
 {
 public:
+    enum
+    {
+        NumNodes         = NumSegments * PolyOrder + 1,
+        PolynomialOrder  = PolyOrder,
+        NumberOfSegments = NumSegments
+    };
+
+    /** fixed-size numeric types for the Eigen interface (augmented with the virtual state and control) */
+    typedef Eigen::Matrix<double, NX + 2, 1>        state_t;
+    typedef Eigen::Matrix<double, NU + 1, 1>        control_t;
+    typedef Eigen::Matrix<double, NX + 2, NumNodes> trajectory_t;
+    typedef Eigen::Matrix<double, NU + 1, NumNodes> control_trajectory_t;
+
     nmpf(const double &tf = 1.0, const casadi::DMDict &mpc_options = casadi::DMDict(), const casadi::Dict &solver_options = casadi::Dict());
     ~nmpf(){}
 
@@ -64,24 +88,59 @@ public:
     void setControlScaling(const casadi::DM &Scaling){Scale_U = Scaling;
                                                       invSU = casadi::DM::solve(Scale_U, casadi::DM::eye(Scale_U.size1()));}
 
-    void setReferenceVelocity(const casadi::DM &vel_ref){ARG["p"] = Scale_X(nx + 1,nx + 1) * vel_ref;
+    void setReferenceVelocity(const casadi::DM &vel_ref){ARG["p"] = casadi::DM::vertcat({Scale_X(nx + 1,nx + 1) * vel_ref,
+                                                                              casadi::DM::vec(PathCoefficients)});
                                                          /**reference_velocity = Scale_X(nx + 1,nx + 1) * vel_ref;*/ }
 
+    /** path series ("mpc.path_series"): the coefficients (ny x number of basis functions) are NLP parameters, a new
+     *  or morphed path is a parameter update, the path geometry is refitted */
+    void setPathCoefficients(const casadi::DM &coefficients);
+    casadi::DM getPathCoefficients(){return PathCoefficients;}
+    const PathSeries& getPathSeries() const {return Series;}
+
     void setPath(const casadi::SX &_path);
+
+    /** nonlinear path constraint lbh <= h(x, u) <= ubh on the system state and control, collocated at every node,
+     *  by default h(x, u) <= 0; constraints accumulate, each call rebuilds the NLP (bounds set so far are kept);
+     *  inequalities (lbh < ubh) are not supported by the "interior_point" backend, IPOPT is used instead */
+    void addPathConstraint(const casadi::Function &h, const casadi::DM &lbh = casadi::DM(), const casadi::DM &ubh = casadi::DM());
     void createNLP(const casadi::Dict &solver_options);
     void updateParams(const casadi::Dict &params);
 
     void enableWarmStart(){WARM_START = true;}
     void disableWarmStart(){WARM_START = false;}
     void computeControl(const casadi::DM &_X0);
+    void computeControl(const Eigen::Ref<const Eigen::VectorXd> &_X0);
+    /** tangential predictor ("mpc.sensitivity"): first-order update of the last NLP solution for a new augmented state
+     *  and reference velocity, refreshes the optimal control and trajectory; false if no solution is factorized */
+    bool predictControl(const casadi::DM &_X0);
+    bool predictControl(const Eigen::Ref<const Eigen::VectorXd> &_X0);
+    /** derivative of the (scaled) decision variables w.r.t. [X0; NLP parameters] at the last NLP solution */
+    casadi::DM getSensitivity();
+    /** standalone C library of the controller with its current bounds, reference velocity and initial guess in 'dir',
+     *  the augmented state is fixed exactly (no path parameter flexibility), see export_controller() */
+    bool exportController(const std::string &dir, const std::string &name);
     casadi::DM findClosestPointOnPath(const casadi::DM &position, const casadi::DM &init_guess = casadi::DM(0));
 
     casadi::DM getOptimalControl(){return OptimalControl;}
     casadi::DM getOptimalTrajetory(){return OptimalTrajectory;}
+
+    /** views into the solution buffers (columns in node order), valid until the next computeControl() */
+    Eigen::Map<const control_trajectory_t> getOptimalControlMap() const
+    {
+        return Eigen::Map<const control_trajectory_t>(OptimalControlData.data());
+    }
+    Eigen::Map<const trajectory_t> getOptimalTrajectoryMap() const
+    {
+        return Eigen::Map<const trajectory_t>(OptimalTrajectoryData.data());
+    }
     casadi::Function getPathFunction(){return PathFunc;}
+    /** numeric path: position, tangent, curvature and arc length without symbolic evaluation */
+    const PathGeometry<>& getPathGeometry() const {return Geometry;}
     casadi::Function getAugDynamics(){return AugDynamics;}
     casadi::Dict getStats(){return stats;}
     bool initialized(){return _initialized;}
+    double getHorizon() const {return Tf;}
 
     double getPathError();
     double getVirtState();
@@ -118,19 +177,58 @@ private:
 
     casadi::DM NLP_X, NLP_LAM_G, NLP_LAM_X;
     casadi::Function NLP_Solver;
+    std::shared_ptr<InteriorPointSolver> IPSolver;
     casadi::SXDict NLP;
+    /** MX formulation with mapped collocation, NLP is then expanded only on demand */
+    casadi::MXDict MappedNLP;
     casadi::Dict OPTS;
     casadi::DMDict ARG;
     casadi::Dict stats;
 
     casadi::DM OptimalControl;
     casadi::DM OptimalTrajectory;
+    std::vector<double> OptimalTrajectoryData, OptimalControlData;
+    void store_solution(const casadi::DM &w);
+
+    /** parametric sensitivity of the solution: KKT factorization at the last solve, dw/dX0 precomputed */
+    bool SENSITIVITY;
+    casadi::Function KKTSensitivity;
+    NLPSensitivity Sensitivity;
+    Eigen::MatrixXd m_sens_x0;
+    void prepare_sensitivity();
+
+    /** Gauss-Newton Hessian of the least-squares cost instead of the exact Hessian of the Lagrangian */
+    bool GAUSS_NEWTON;
+    /** exact Hessian of the Lagrangian assembled from per-node blocks */
+    bool NODE_HESSIAN;
+
+    CollocationMap collocation_map;
+
+    /** time-shifted warm start */
+    double sampling_time;
+    casadi::DM ShiftOpT;
+    void shift_solution();
+
+    /** converged solutions indexed by the path phase: initial guess on a cold start, after a failed solve or when the
+     *  shifted guess misses the measured state by more than phase_cache_tol (scaled, infinity norm) */
+    PhaseCache WarmStartCache;
+    int phase_cache_bins;
+    double phase_cache_tol;
+    bool LAST_SOLVE_OK;
+    bool load_cached_solution(const casadi::DM &X0);
 
     unsigned NUM_COLLOCATION_POINTS;
     bool WARM_START;
     bool _initialized;
     bool scale;
     double reset_path_after;
+    PathGeometry<> Geometry;
+
+    /** parametric path: series basis and the current coefficients (empty for the symbolic path) */
+    PathSeries Series;
+    casadi::DM PathCoefficients;
+    casadi::SX path_expression(const casadi::SX &theta, const casadi::SX &coefficients);
+    void fit_geometry();
 
     /** TRACE FUNCTIONS */
     casadi::Function DynamicsFunc;
@@ -142,6 +240,24 @@ private:
 
     casadi::Function AugJacobian;
     casadi::Function AugDynamics;
+
+    /** immutable problem data: identical controllers in one process share it through SolverRegistry */
+    struct SolverCore
+    {
+        casadi::SXDict   NLP;
+        casadi::MXDict   MappedNLP;
+        casadi::SX       reference_velocity;
+        casadi::Function NLP_Solver;
+        std::shared_ptr<InteriorPointSolver> IPSolver;
+        casadi::Function KKTSensitivity;
+        casadi::Function DynamicsFunc, DynamicConstraints, PerformanceIndex, PathError, VelError, AugJacobian;
+        casadi::DM       ShiftOpT;
+        casadi::DM       lbx, ubx, lbg, ubg;
+    };
+    std::shared_ptr<const SolverCore> Core;
+    std::string core_key();
+    std::shared_ptr<SolverCore> build_core();
+    void load_core(const SolverCore &core);
 };
 
 template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
@@ -217,14 +333,91 @@ nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::nmpf(const double &tf, const
         reset_path_after  = tmp.nonzeros()[0];
     }
 
+    /** path as a Chebyshev (1) or Fourier (2) series of degree "mpc.path_degree" over [0, reset_path_after] with the
+     *  coefficients in the NLP parameters, the symbolic path (0) is compiled into the cost */
+    int path_series = NO_SERIES;
+    if(mpc_options.find("mpc.path_series") != mpc_options.end())
+        path_series = static_cast<int>(mpc_options.find("mpc.path_series")->second.nonzeros()[0]);
+
+    int path_degree = 8;
+    if(mpc_options.find("mpc.path_degree") != mpc_options.end())
+        path_degree = static_cast<int>(mpc_options.find("mpc.path_degree")->second.nonzeros()[0]);
+
+    if(path_series != NO_SERIES && path_series != CHEBYSHEV_SERIES && path_series != FOURIER_SERIES)
+    {
+        std::cout << "nmpf: unknown path series " << path_series << ", the symbolic path is used \n";
+        path_series = NO_SERIES;
+    }
+    Series = PathSeries(static_cast<PathSeriesType>(path_series), path_degree, reset_path_after);
+
+    /** the path is sampled once, it is periodic in the path parameter with the period reset_path_after */
+    casadi::SX theta = casadi::SX::sym("theta");
+    casadi::Function path_fun = casadi::Function("path", {theta}, PathFunc(casadi::SXVector{theta}));
+    std::function<Eigen::VectorXd(const double&)> sample_path = [&path_fun](const double &s)
+    {
+        std::vector<double> point = casadi::DM::densify(path_fun(casadi::DMVector{casadi::DM(s)})[0]).nonzeros();
+        return Eigen::VectorXd(Eigen::Map<Eigen::VectorXd>(point.data(), point.size()));
+    };
+
+    /** initial coefficients: least-squares projection of the symbolic path on the basis */
+    PathCoefficients = casadi::DM::zeros(ny, 0);
+    if(Series.type() != NO_SERIES)
+    {
+        PathCoefficients = polymath::eigen2casadi<casadi::DM>(Series.fit(sample_path));
+        fit_geometry();
+    }
+    else
+    {
+        Geometry.fit(sample_path, 0.0, reset_path_after, true);
+    }
+
+    /** factorize the KKT system after each solve for the tangential predictor */
+    SENSITIVITY = false;
+    if(mpc_options.find("mpc.sensitivity") != mpc_options.end())
+        SENSITIVITY = static_cast<bool>(mpc_options.find("mpc.sensitivity")->second.nonzeros()[0]);
+
+    /** Gauss-Newton Hessian approximation for the NLP solver */
+    GAUSS_NEWTON = false;
+    if(mpc_options.find("mpc.gauss_newton") != mpc_options.end())
+        GAUSS_NEWTON = static_cast<bool>(mpc_options.find("mpc.gauss_newton")->second.nonzeros()[0]);
+
+    /** exact Hessian from one mapped per-node kernel instead of the derivatives of the whole NLP graph */
+    NODE_HESSIAN = false;
+    if(mpc_options.find("mpc.node_hessian") != mpc_options.end())
+        NODE_HESSIAN = static_cast<bool>(mpc_options.find("mpc.node_hessian")->second.nonzeros()[0]);
+
+    /** vectorized evaluation of the model at the collocation nodes */
+    collocation_map = NO_MAP;
+    if(mpc_options.find("mpc.collocation_map") != mpc_options.end())
+        collocation_map = static_cast<CollocationMap>(static_cast<int>(mpc_options.find("mpc.collocation_map")->second.nonzeros()[0]));
+
+    /** shift the warm start by the sampling time */
+    sampling_time = 0;
+    if(mpc_options.find("mpc.sampling_time") != mpc_options.end())
+        sampling_time = mpc_options.find("mpc.sampling_time")->second.nonzeros()[0];
+
+    /** phase-indexed warm start cache: number of bins per period (0: off) and the disturbance threshold */
+    phase_cache_bins = 0;
+    if(mpc_options.find("mpc.phase_cache") != mpc_options.end())
+        phase_cache_bins = static_cast<int>(mpc_options.find("mpc.phase_cache")->second.nonzeros()[0]);
+
+    phase_cache_tol = std::numeric_limits<double>::infinity();
+    if(mpc_options.find("mpc.phase_cache_tol") != mpc_options.end())
+        phase_cache_tol = mpc_options.find("mpc.phase_cache_tol")->second.nonzeros()[0];
+
     /** assume unconstrained problem */
     LBX = -casadi::DM::inf(nx + 2);
     UBX = casadi::DM::inf(nx + 2);
     LBU = -casadi::DM::inf(nu + 1);
     UBU = casadi::DM::inf(nu + 1);
 
+    /** no path constraints */
+    LBG = casadi::DM::zeros(0);
+    UBG = casadi::DM::zeros(0);
+
     WARM_START  = false;
     _initialized = false;
+    LAST_SOLVE_OK = true;
 
     /** create NLP */
     createNLP(solver_options);
@@ -240,8 +433,34 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::updateParams(const casa
     }
 }
 
+/** register a path constraint and rebuild the solver */
 template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
-void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi::Dict &solver_options)
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::addPathConstraint(const casadi::Function &h, const casadi::DM &lbh, const casadi::DM &ubh)
+{
+    casadi::SX x = casadi::SX::sym("x", NX);
+    casadi::SX u = casadi::SX::sym("u", NU);
+    casadi::SX h_xu = h(casadi::SXVector{x, u})[0];
+    const int nh = h_xu.size1();
+
+    casadi::SX previous = ContraintsFunc.is_null() ? casadi::SX::zeros(0) : ContraintsFunc(casadi::SXVector{x, u})[0];
+    Contraints     = casadi::SX::vertcat({previous, h_xu});
+    ContraintsFunc = casadi::Function("path_constraints", {x, u}, {Contraints});
+    LBG = casadi::DM::vertcat({LBG, lbh.is_empty() ? -casadi::DM::inf(nh) : lbh});
+    UBG = casadi::DM::vertcat({UBG, ubh.is_empty() ? casadi::DM::zeros(nh) : ubh});
+
+    casadi::DM lbx = ARG["lbx"];
+    casadi::DM ubx = ARG["ubx"];
+    casadi::DM vel = ARG["p"];
+    casadi::Dict options = OPTS;
+    createNLP(options);
+    ARG["lbx"] = lbx;
+    ARG["ubx"] = ubx;
+    ARG["p"]   = vel;
+}
+
+/** build the symbolic problem and the solver */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+std::shared_ptr<typename nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::SolverCore> nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::build_core()
 {
     /** get dynamics function and state Jacobian */
     casadi::Function dynamics = system.getDynamics();
@@ -272,6 +491,10 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi:
 
     reference_velocity = casadi::SX::sym("reference_velocity");
 
+    /** NLP parameters: reference velocity and the path coefficients (if any) */
+    casadi::SX path_coefficients = casadi::SX::sym("path_coefficients", ny * Series.size());
+    casadi::SX params = casadi::SX::vertcat({reference_velocity, path_coefficients});
+
     /** set default properties of approximation */
     const int num_segments = NumSegments;
     const int poly_order   = PolyOrder;
@@ -283,32 +506,53 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi:
     NUM_COLLOCATION_POINTS = num_segments * poly_order;
     /** Order of polynomial interpolation */
 
+    /** NLP backend: IPOPT (default) or the structure-exploiting interior point solver */
+    std::string backend = "ipopt";
+    casadi::Dict solver_opts = OPTS;
+    if(solver_opts.find("polympc.solver") != solver_opts.end())
+    {
+        backend = solver_opts["polympc.solver"].to_string();
+        solver_opts.erase("polympc.solver");
+    }
+
+    /** the interior point backend handles equality constraints only: inequality path constraints go to IPOPT */
+    if((backend == "interior_point") && !ContraintsFunc.is_null() && (static_cast<double>(casadi::DM::norm_inf(UBG - LBG)) > 0))
+    {
+        std::cout << "nmpf: the interior point backend supports equality path constraints only (lbg == ubg), "
+                  << "the problem with inequality path constraints is solved with ipopt \n";
+        backend = "ipopt";
+    }
+
+    /** mapped collocation is formulated in MX and stays one map node per function through nlpsol, the SX form
+     *  is expanded only for the sensitivity and the interior point backend */
+    const bool mapped    = (collocation_map != NO_MAP);
+    const bool expand_sx = !mapped || SENSITIVITY || (backend == "interior_point");
+    const std::string parallelization = (collocation_map == MAP_THREAD) ? "thread" : "serial";
+    NLP.clear();
+    MappedNLP.clear();
+
     Chebyshev<casadi::SX, poly_order, num_segments, dimx, dimu, dimp> spectral;
-    casadi::SX diff_constr;
+    casadi::Function NodeODE = DynamicsFunc;
 
     if(scale)
     {
         casadi::SX SODE = aug_dynamo(casadi::SXVector{casadi::SX::mtimes(invSX, aug_state), casadi::SX::mtimes(invSU, aug_control)})[0];
         SODE = casadi::SX::mtimes(Scale_X, SODE);
-        casadi::Function FunSODE = casadi::Function("scaled_ode", {aug_state, aug_control}, {SODE});
-
-        diff_constr = spectral.CollocateDynamics(FunSODE, 0, tf);
+        NodeODE = casadi::Function("scaled_ode", {aug_state, aug_control}, {SODE});
 
         std::cout << "USE SCALING : \n " << Scale_X << "\n";
     }
-    else
-    {
-        diff_constr = spectral.CollocateDynamics(DynamicsFunc, 0, tf);
-    }
 
-    //diff_constr = diff_constr(casadi::Slice(0, diff_constr.size1() - dimx));
+    /** warm start shift operator */
+    if(sampling_time > 0)
+        ShiftOpT = spectral.ShiftOperator(0, tf, sampling_time).T();
 
     /** define an integral cost */
     casadi::SX lagrange, residual;
     if(scale)
     {
         /** @bug dimensions bug here */
-        casadi::SX sym_path = PathFunc(casadi::SXVector{casadi::SX::mtimes(invSX(nx, nx), v(0))})[0];
+        casadi::SX sym_path = path_expression(casadi::SX::mtimes(invSX(nx, nx), v(0)), path_coefficients);
         casadi::SX _invSX = invSX(casadi::Slice(0, NX), casadi::Slice(0, NX));
         residual  = sym_path - output({casadi::SX::mtimes(_invSX, x)})[0];
         lagrange  = casadi::SX::sum1( casadi::SX::mtimes(Q, pow(residual, 2)) ) +
@@ -317,7 +561,7 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi:
     }
     else
     {
-        casadi::SX sym_path = PathFunc(casadi::SXVector{v(0)})[0];
+        casadi::SX sym_path = path_expression(v(0), path_coefficients);
         residual  = sym_path - output({x})[0];
         lagrange  = casadi::SX::sum1( casadi::SX::mtimes(Q, pow(residual, 2)) ) +
                     casadi::SX::sum1( casadi::SX::mtimes(W, pow(reference_velocity - v(1), 2)) );
@@ -325,27 +569,106 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi:
         lagrange = lagrange + casadi::SX::sum1( casadi::SX::mtimes(R, pow(aug_control, 2)) );
     }
 
-    casadi::Function LagrangeTerm = casadi::Function("Lagrange", {aug_state, aug_control}, {lagrange});
+    casadi::Function LagrangeTerm = casadi::Function("Lagrange", {aug_state, aug_control, params}, {lagrange});
 
     /** trace functions */
-    PathError = casadi::Function("PathError", {aug_state}, {residual});
-    VelError  = casadi::Function("VelError", {aug_state, reference_velocity}, {reference_velocity - v(1)});
+    PathError = casadi::Function("PathError", {aug_state, params}, {residual});
+    VelError  = casadi::Function("VelError", {aug_state, params}, {reference_velocity - v(1)});
 
     casadi::SX mayer           =  casadi::SX::sum1( casadi::SX::mtimes(Q, pow(residual, 2)) );
-    casadi::Function MayerTerm = casadi::Function("Mayer",{aug_state}, {mayer});
-    casadi::SX performance_idx = spectral.CollocateCost(MayerTerm, LagrangeTerm, 0.0, tf);
+    casadi::Function MayerTerm = casadi::Function("Mayer",{aug_state, params}, {mayer});
 
     casadi::SX varx = spectral.VarX();
     casadi::SX varu = spectral.VarU();
 
     casadi::SX opt_var = casadi::SX::vertcat(casadi::SXVector{varx, varu});
 
-    /** debugging output */
-    DynamicConstraints = casadi::Function("constraint_func", {opt_var}, {diff_constr});
-    PerformanceIndex   = casadi::Function("performance_idx", {opt_var}, {performance_idx});
+    /** path constraints on the system part of the augmented variables: one mapped evaluation over the nodes,
+     *  the Jacobian stays block-diagonal */
+    const int num_nodes = poly_order * num_segments + 1;
+    casadi::SX h_xu = casadi::SX::zeros(0);
+    casadi::Function PathConstraints;
+    if(!ContraintsFunc.is_null())
+    {
+        if(scale)
+        {
+            casadi::SX state   = casadi::SX::mtimes(invSX, aug_state);
+            casadi::SX control = casadi::SX::mtimes(invSU, aug_control);
+            h_xu = ContraintsFunc(casadi::SXVector{state(casadi::Slice(0, NX)), control(casadi::Slice(0, NU))})[0];
+        }
+        else
+        {
+            h_xu = ContraintsFunc(casadi::SXVector{x, u})[0];
+        }
+        PathConstraints = casadi::Function("path_constraints", {aug_state, aug_control}, {h_xu});
+    }
+
+    /** every node has collocation rows */
+    const int num_dyn = num_nodes * dimx;
+    casadi::SX lbg = casadi::SX::zeros(num_dyn);
+    casadi::SX ubg = casadi::SX::zeros(num_dyn);
+    if(!PathConstraints.is_null())
+    {
+        lbg = casadi::SX::vertcat({lbg, casadi::SX::repmat(casadi::SX(LBG), num_nodes, 1)});
+        ubg = casadi::SX::vertcat({ubg, casadi::SX::repmat(casadi::SX(UBG), num_nodes, 1)});
+    }
+
+    /** formulate NLP */
+    if(mapped)
+    {
+        Chebyshev<casadi::MX, poly_order, num_segments, dimx, dimu, dimp> spectral_mx;
+        spectral_mx.SetCollocationMap(collocation_map);
+
+        casadi::MX varx_mx   = spectral_mx.VarX();
+        casadi::MX varu_mx   = spectral_mx.VarU();
+        casadi::MX params_mx = casadi::MX::sym("params", params.size1());
+
+        casadi::MX constraints_mx = spectral_mx.CollocateDynamics(NodeODE, 0, tf);
+        if(!PathConstraints.is_null())
+        {
+            casadi::MX path_constr = PathConstraints.map(num_nodes, parallelization)(casadi::MXVector{casadi::MX::reshape(varx_mx, dimx, num_nodes),
+                                                                                                     casadi::MX::reshape(varu_mx, dimu, num_nodes)})[0];
+            constraints_mx = casadi::MX::vertcat({constraints_mx, casadi::MX::vec(path_constr)});
+        }
+
+        MappedNLP["x"] = casadi::MX::vertcat({varx_mx, varu_mx});
+        MappedNLP["f"] = spectral_mx.CollocateCost(MayerTerm, LagrangeTerm, casadi::MX::repmat(params_mx, 1, num_nodes), 0.0, tf);
+        MappedNLP["g"] = constraints_mx;
+        MappedNLP["p"] = params_mx;
+
+        if(expand_sx)
+            NLP = expand_nlp(MappedNLP, opt_var, params);
+    }
+    else
+    {
+        casadi::SX constraints = spectral.CollocateDynamics(NodeODE, 0, tf);
+        if(!PathConstraints.is_null())
+        {
+            casadi::SX path_constr = PathConstraints.map(num_nodes, "serial")(casadi::SXVector{casadi::SX::reshape(varx, dimx, num_nodes),
+                                                                                               casadi::SX::reshape(varu, dimu, num_nodes)})[0];
+            constraints = casadi::SX::vertcat({constraints, casadi::SX::vec(path_constr)});
+        }
 
-    casadi::SX lbg = casadi::SX::zeros(diff_constr.size());
-    casadi::SX ubg = casadi::SX::zeros(diff_constr.size());
+        NLP["x"] = opt_var;
+        NLP["f"] = spectral.CollocateCost(MayerTerm, LagrangeTerm, casadi::SX::repmat(params, 1, num_nodes), 0.0, tf);
+        NLP["g"] = constraints;
+        NLP["p"] = params;
+    }
+
+    /** debugging output */
+    if(expand_sx)
+    {
+        DynamicConstraints = casadi::Function("constraint_func", {opt_var}, {NLP["g"]});
+        PerformanceIndex   = casadi::Function("performance_idx", {opt_var}, {NLP["f"]});
+        /** Augmented Jacobian */
+        AugJacobian = casadi::Function("aug_jacobian",{opt_var}, {casadi::SX::jacobian(NLP["g"], opt_var)});
+    }
+    else
+    {
+        DynamicConstraints = casadi::Function("constraint_func", {MappedNLP["x"]}, {MappedNLP["g"]});
+        PerformanceIndex   = casadi::Function("performance_idx", {MappedNLP["x"]}, {MappedNLP["f"]});
+        AugJacobian = casadi::Function("aug_jacobian",{MappedNLP["x"]}, {casadi::MX::jacobian(MappedNLP["g"], MappedNLP["x"])});
+    }
 
     /** set inequality (box) constraints */
     /** state */
@@ -356,15 +679,144 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi:
     lbx = casadi::SX::vertcat( {lbx, casadi::SX::repmat(casadi::SX::mtimes(Scale_U, LBU), poly_order * num_segments + 1, 1)} );
     ubx = casadi::SX::vertcat( {ubx, casadi::SX::repmat(casadi::SX::mtimes(Scale_U, UBU), poly_order * num_segments + 1, 1)} );
 
-    casadi::SX diff_constr_jacobian = casadi::SX::jacobian(diff_constr, opt_var);
-    /** Augmented Jacobian */
-    AugJacobian = casadi::Function("aug_jacobian",{opt_var}, {diff_constr_jacobian});
+    if(backend == "interior_point")
+    {
+        IPSolver = std::make_shared<InteriorPointSolver>("solver", NLP, NX + 2, NU + 1, NumSegments, PolyOrder, solver_opts);
+        NLP_Solver = *IPSolver;
+    }
+    else
+    {
+        /** Gauss-Newton: the cost is a weighted sum of squares of the path error, velocity error and augmented
+         *  control, the Hessian of the Lagrangian is replaced by 2 * J_r' W J_r (node block sparsity, no second
+         *  derivatives of the dynamics) */
+        if(GAUSS_NEWTON)
+        {
+            casadi::Function LsqResidual = casadi::Function("lsq_residual", {aug_state, aug_control, params},
+                                                            {casadi::SX::vertcat({residual, reference_velocity - v(1), aug_control})});
+            casadi::SX lsq_weight = casadi::SX::vertcat({casadi::SX::sum1(Q).T(), casadi::SX::sum1(W).T(), casadi::SX::sum1(R).T()});
+            casadi::SX qweights   = spectral.QWeights();
+            double t_scale = tf / (2 * num_segments);
+
+            casadi::SXVector lsq_res, lsq_w;
+            for(int k = 0; k < num_segments; ++k)
+            {
+                for(int m = 0; m <= poly_order; ++m)
+                {
+                    int node = k * poly_order + m;
+                    casadi::SX x_node = varx(casadi::Slice(node * dimx, (node + 1) * dimx));
+                    casadi::SX u_node = varu(casadi::Slice(node * dimu, (node + 1) * dimu));
+                    lsq_res.push_back(LsqResidual(casadi::SXVector{x_node, u_node, params})[0]);
+                    lsq_w.push_back(t_scale * qweights(m) * lsq_weight);
+                }
+            }
+            /** Mayer term */
+            lsq_res.push_back(PathError(casadi::SXVector{varx(casadi::Slice(0, dimx)), params})[0]);
+            lsq_w.push_back(casadi::SX::sum1(Q).T());
+
+            casadi::SX lsq_jacobian = casadi::SX::jacobian(casadi::SX::vertcat(lsq_res), opt_var);
+            casadi::SX gn_hessian   = 2 * casadi::SX::mtimes(lsq_jacobian.T(),
+                                                             casadi::SX::mtimes(casadi::SX::diag(casadi::SX::vertcat(lsq_w)), lsq_jacobian));
+
+            casadi::SX lam_f = casadi::SX::sym("lam_f");
+            casadi::SX lam_g = casadi::SX::sym("lam_g", lbg.size1());
+            solver_opts["hess_lag"] = casadi::Function("nlp_hess_l", {opt_var, params, lam_f, lam_g},
+                                                       {casadi::SX::triu(lam_f * gn_hessian)});
+        }
+        else if(NODE_HESSIAN)
+        {
+            /** node Lagrangian: weighted cost terms, collocation rows (g = D X - t_scale * f) and path constraints */
+            double t_scale = tf / (2 * num_segments);
+            casadi::SX c_lagrange = casadi::SX::sym("c_lagrange");
+            casadi::SX c_mayer    = casadi::SX::sym("c_mayer");
+            casadi::SX lam_dyn    = casadi::SX::sym("lam_dyn", dimx);
+            casadi::SX lam_path   = casadi::SX::sym("lam_path", h_xu.size1());
+            casadi::SX node_lagrangian = c_lagrange * lagrange + c_mayer * mayer
+                                       - t_scale * casadi::SX::dot(lam_dyn, NodeODE(casadi::SXVector{aug_state, aug_control})[0])
+                                       + casadi::SX::dot(lam_path, h_xu);
+            casadi::Function NodeKernel = casadi::Function("node_hess_l", {aug_state, aug_control, params, c_lagrange,
+                                                                           c_mayer, lam_dyn, lam_path},
+                                                           {casadi::SX::triu(casadi::SX::hessian(node_lagrangian,
+                                                                                                 casadi::SX::vertcat({aug_state, aug_control})))});
+
+            casadi::DM lagrange_weights = t_scale * polymath::eigen2casadi<casadi::DM>(polymath::ChebyshevTables<PolyOrder, NumSegments>::NodeWeights());
+
+            /** the parameters are shared by all nodes, every node has collocation rows */
+            solver_opts["hess_lag"] = node_hessian_lagrangian("nlp_hess_l", NodeKernel,
+                                                              casadi::Function("node_params", {params},
+                                                                               {casadi::SX::repmat(params, 1, num_nodes)}),
+                                                              dimx, dimu, num_nodes, num_nodes, h_xu.size1(),
+                                                              lagrange_weights, parallelization, OPTS);
+        }
 
-    /** formulate NLP */
-    NLP["x"] = opt_var;
-    NLP["f"] = performance_idx;
-    NLP["g"] = diff_constr;
-    NLP["p"] = reference_velocity;
+        NLP_Solver = mapped ? cached_nlpsol("solver", backend, MappedNLP, core_key(), solver_opts)
+                            : cached_nlpsol("solver", backend, NLP, core_key(), solver_opts);
+    }
+
+    if(SENSITIVITY)
+        KKTSensitivity = NLPSensitivity::kkt_function(NLP);
+
+    std::shared_ptr<SolverCore> core = std::make_shared<SolverCore>();
+    core->NLP                = NLP;
+    core->MappedNLP          = MappedNLP;
+    core->reference_velocity = reference_velocity;
+    core->NLP_Solver         = NLP_Solver;
+    core->IPSolver           = IPSolver;
+    core->KKTSensitivity     = KKTSensitivity;
+    core->DynamicsFunc       = DynamicsFunc;
+    core->DynamicConstraints = DynamicConstraints;
+    core->PerformanceIndex   = PerformanceIndex;
+    core->PathError          = PathError;
+    core->VelError           = VelError;
+    core->AugJacobian        = AugJacobian;
+    core->ShiftOpT           = ShiftOpT;
+    core->lbx = lbx;
+    core->ubx = ubx;
+    core->lbg = lbg;
+    core->ubg = ubg;
+    return core;
+}
+
+/** per-instance handles to the shared functions */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::load_core(const SolverCore &core)
+{
+    NLP                = core.NLP;
+    MappedNLP          = core.MappedNLP;
+    reference_velocity = core.reference_velocity;
+    NLP_Solver         = core.NLP_Solver;
+    IPSolver           = core.IPSolver;
+    KKTSensitivity     = core.KKTSensitivity;
+    Sensitivity.init(KKTSensitivity);
+    DynamicsFunc       = core.DynamicsFunc;
+    DynamicConstraints = core.DynamicConstraints;
+    PerformanceIndex   = core.PerformanceIndex;
+    PathError          = core.PathError;
+    VelError           = core.VelError;
+    AugJacobian        = core.AugJacobian;
+    ShiftOpT           = core.ShiftOpT;
+}
+
+/** everything the formulation depends on: model and path, discretization, scaling, weights, bounds and solver options */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+std::string nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::core_key()
+{
+    casadi::SX theta = casadi::SX::sym("theta");
+    std::ostringstream key;
+    key << std::setprecision(17) << typeid(*this).name() << " " << function_fingerprint(system.getDynamics()) << " "
+        << function_fingerprint(system.getOutputMapping()) << " " << PathFunc(casadi::SXVector{theta})[0] << " "
+        << Tf << " " << scale << " "
+        << Scale_X << Scale_U << Q << R << W << LBX << UBX << LBU << UBU << LBG << UBG << " "
+        << (ContraintsFunc.is_null() ? std::string() : function_fingerprint(ContraintsFunc)) << " "
+        << collocation_map << " " << sampling_time << " " << SENSITIVITY << " " << GAUSS_NEWTON << " " << NODE_HESSIAN << " "
+        << Series.type() << " " << Series.degree() << " " << Series.period() << " " << OPTS;
+    return key.str();
+}
+
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi::Dict &solver_options)
+{
+    const int num_nodes = NumSegments * PolyOrder + 1;
+    NUM_COLLOCATION_POINTS = NumSegments * PolyOrder;
 
     /** default solver options */
     OPTS["ipopt.linear_solver"]         = "ma97";
@@ -378,20 +830,40 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::createNLP(const casadi:
     if(!solver_options.empty())
         updateParams(solver_options);
 
-    NLP_Solver = casadi::nlpsol("solver", "ipopt", NLP, OPTS);
+    /** identical problems share one core */
+    Core = SolverRegistry<SolverCore>::get(core_key(), [this]{return build_core();});
+    load_core(*Core);
 
     /** set default args */
-    ARG["lbx"] = lbx;
-    ARG["ubx"] = ubx;
-    ARG["lbg"] = lbg;
-    ARG["ubg"] = ubg;
+    ARG["lbx"] = Core->lbx;
+    ARG["ubx"] = Core->ubx;
+    ARG["lbg"] = Core->lbg;
+    ARG["ubg"] = Core->ubg;
     setReferenceVelocity(1.0); // ARG["p"] = 1.0
 
     casadi::DM feasible_state = casadi::DM::zeros(UBX.size());
     casadi::DM feasible_control = casadi::DM::zeros(UBU.size());
 
-    ARG["x0"] = casadi::DM::vertcat(casadi::DMVector{casadi::DM::repmat(feasible_state, poly_order * num_segments + 1, 1),
-                                     casadi::DM::repmat(feasible_control, poly_order * num_segments + 1, 1)});
+    ARG["x0"] = casadi::DM::vertcat(casadi::DMVector{casadi::DM::repmat(feasible_state, num_nodes, 1),
+                                     casadi::DM::repmat(feasible_control, num_nodes, 1)});
+
+    /** numeric solution buffers */
+    OptimalTrajectoryData.assign((NX + 2) * NumNodes, 0);
+    OptimalControlData.assign((NU + 1) * NumNodes, 0);
+
+    /** solutions of a previous problem do not fit, the virtual state of every node is shifted with the phase */
+    std::vector<int> phase_indices(num_nodes);
+    for(int k = 0; k < num_nodes; ++k)
+        phase_indices[k] = k * (NX + 2) + nx;
+    WarmStartCache.init(phase_cache_bins, reset_path_after, phase_indices, Scale_X(nx, nx).nonzeros()[0]);
+}
+
+/** Eigen overload: the state is converted once at the boundary */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::computeControl(const Eigen::Ref<const Eigen::VectorXd> &_X0)
+{
+    assert(_X0.size() == NX + 2);
+    computeControl(casadi::DM(std::vector<double>(_X0.data(), _X0.data() + _X0.size())));
 }
 
 template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
@@ -435,6 +907,8 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::computeControl(const ca
         ARG["lbx"](idx_theta + 1) = X0(nx + 1) - flexibility;
         ARG["ubx"](idx_theta + 1) = X0(nx + 1) + flexibility;
 
+        shift_solution();
+
         /** rectify initial guess */
         if(rectify)
         {
@@ -447,13 +921,29 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::computeControl(const ca
                     NLP_X(idx) += critical_val;
             }
         }
+
+        /** restart from the phase cache after a failed solve or a disturbance */
+        if(WarmStartCache.enabled() &&
+           (!LAST_SOLVE_OK || casadi::DM::norm_inf(NLP_X(casadi::Slice(idx_in, idx_out)) - X0).nonzeros()[0] > phase_cache_tol))
+            load_cached_solution(X0);
+
         ARG["x0"]     = NLP_X;
         ARG["lam_g0"] = NLP_LAM_G;
         ARG["lam_x0"] = NLP_LAM_X;
     }
     else
     {
-        ARG["x0"](casadi::Slice(0, (N + 1) * (NX + 2)), 0) = casadi::DM::repmat(X0, (N + 1), 1);
+        /** cold start: the cached solution of the nearest phase or the constant state */
+        if(load_cached_solution(X0))
+        {
+            ARG["x0"]     = NLP_X;
+            ARG["lam_g0"] = NLP_LAM_G;
+            ARG["lam_x0"] = NLP_LAM_X;
+        }
+        else
+        {
+            ARG["x0"](casadi::Slice(0, (N + 1) * (NX + 2)), 0) = casadi::DM::repmat(X0, (N + 1), 1);
+        }
         int idx_in = N * (NX + 2);
         int idx_out = idx_in + (NX + 2);
         ARG["lbx"](casadi::Slice(idx_in, idx_out), 0) = X0;
@@ -481,12 +971,9 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::computeControl(const ca
     NLP_LAM_X = res.at("lam_x");
     NLP_LAM_G = res.at("lam_g");
 
-    casadi::DM opt_x = NLP_X(casadi::Slice(0, (N + 1) * (NX + 2) ));
-    OptimalTrajectory = casadi::DM::mtimes(invSX, casadi::DM::reshape(opt_x, (NX + 2), N + 1));
-    casadi::DM opt_u = NLP_X( casadi::Slice((N + 1) * (NX + 2), NLP_X.size1()) );
-    OptimalControl = casadi::DM::mtimes(invSU, casadi::DM::reshape(opt_u, (NU + 1), N + 1));
+    store_solution(NLP_X);
 
-    stats = NLP_Solver.stats();
+    stats = IPSolver ? IPSolver->get_stats() : NLP_Solver.stats();
     //std::cout << stats << "\n";
 
     std::string solve_status = static_cast<std::string>(stats["return_status"]);
@@ -499,9 +986,178 @@ void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::computeControl(const ca
         std::cout << "X0 : " << ARG["x0"] << "\n";
     }
 
+    if(SENSITIVITY && static_cast<bool>(stats["success"]))
+        prepare_sensitivity();
+
+    /** the phase of the solution is the (unscaled) virtual state at the initial node */
+    LAST_SOLVE_OK = static_cast<bool>(stats["success"]);
+    if(LAST_SOLVE_OK && WarmStartCache.enabled())
+    {
+        std::vector<double> w = casadi::DM::densify(NLP_X).nonzeros();
+        std::vector<double> lam_g = casadi::DM::densify(NLP_LAM_G).nonzeros();
+        std::vector<double> lam_x = casadi::DM::densify(NLP_LAM_X).nonzeros();
+        WarmStartCache.store(X0(nx).nonzeros()[0] / Scale_X(nx, nx).nonzeros()[0],
+                             Eigen::Map<Eigen::VectorXd>(w.data(), w.size()),
+                             Eigen::Map<Eigen::VectorXd>(lam_g.data(), lam_g.size()),
+                             Eigen::Map<Eigen::VectorXd>(lam_x.data(), lam_x.size()));
+    }
+
     enableWarmStart();
 }
 
+/** primal-dual guess from the phase cache, the initial state slot is set to the (scaled) state X0 */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+bool nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::load_cached_solution(const casadi::DM &X0)
+{
+    Eigen::VectorXd w, lam_g, lam_x;
+    if(!WarmStartCache.lookup(X0(nx).nonzeros()[0] / Scale_X(nx, nx).nonzeros()[0], w, lam_g, lam_x))
+        return false;
+
+    const int idx_in = NUM_COLLOCATION_POINTS * (NX + 2);
+    NLP_X     = casadi::DM(std::vector<double>(w.data(), w.data() + w.size()));
+    NLP_LAM_G = casadi::DM(std::vector<double>(lam_g.data(), lam_g.data() + lam_g.size()));
+    NLP_LAM_X = casadi::DM(std::vector<double>(lam_x.data(), lam_x.data() + lam_x.size()));
+    NLP_X(casadi::Slice(idx_in, idx_in + NX + 2), 0) = X0;
+    return true;
+}
+
+/** unscale and reshape the primal solution */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::store_solution(const casadi::DM &w)
+{
+    int N = NUM_COLLOCATION_POINTS;
+
+    casadi::DM opt_x = w(casadi::Slice(0, (N + 1) * (NX + 2) ));
+    OptimalTrajectory = casadi::DM::mtimes(invSX, casadi::DM::reshape(opt_x, (NX + 2), N + 1));
+    casadi::DM opt_u = w( casadi::Slice((N + 1) * (NX + 2), w.size1()) );
+    OptimalControl = casadi::DM::mtimes(invSU, casadi::DM::reshape(opt_u, (NU + 1), N + 1));
+    OptimalTrajectoryData = casadi::DM::densify(OptimalTrajectory).nonzeros();
+    OptimalControlData    = casadi::DM::densify(OptimalControl).nonzeros();
+}
+
+/** factorize the KKT system at the last solution, the augmented state enters through the bounds of its slot
+ *  (fixed, or relaxed around the measured virtual state: both shift with X0) */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::prepare_sensitivity()
+{
+    if(!Sensitivity.factorize(ARG, NLP_X, NLP_LAM_X, NLP_LAM_G))
+    {
+        std::cout << "nmpf: KKT matrix at the solution is singular, no tangential predictor \n";
+        return;
+    }
+
+    const int n_w = NLP_X.size1();
+    const int idx_x0 = NUM_COLLOCATION_POINTS * (NX + 2);
+    m_sens_x0.resize(n_w, NX + 2);
+    for(int i = 0; i < NX + 2; ++i)
+    {
+        Eigen::VectorXd dbx = Eigen::VectorXd::Zero(n_w);
+        dbx[idx_x0 + i] = 1.0;
+        m_sens_x0.col(i) = Sensitivity.primal_step(Eigen::VectorXd(), dbx);
+    }
+}
+
+/** tangential predictor: w = w* + dw/dX0 * dX0 + dw/dp * dp, the virtual state is not rectified */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+bool nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::predictControl(const casadi::DM &_X0)
+{
+    if(!Sensitivity.factorized())
+        return false;
+
+    const int idx_x0 = NUM_COLLOCATION_POINTS * (NX + 2);
+    std::vector<double> x0 = casadi::DM::densify(casadi::DM::mtimes(Scale_X, _X0)).nonzeros();
+    const Eigen::VectorXd &w = Sensitivity.solution();
+    Eigen::VectorXd dw = m_sens_x0 * (Eigen::Map<Eigen::VectorXd>(x0.data(), NX + 2) - w.segment(idx_x0, NX + 2));
+
+    /** parameters (reference velocity, path coefficients) changed since the solve: one more back substitution */
+    std::vector<double> p = casadi::DM::densify(ARG["p"]).nonzeros();
+    Eigen::VectorXd dp = Eigen::Map<Eigen::VectorXd>(p.data(), p.size()) - Sensitivity.parameters();
+    if(dp.lpNorm<Eigen::Infinity>() > 0)
+        dw += Sensitivity.primal_step(dp, Eigen::VectorXd::Zero(w.size()));
+
+    Eigen::VectorXd w_pred = w + dw;
+    store_solution(casadi::DM(std::vector<double>(w_pred.data(), w_pred.data() + w_pred.size())));
+    return true;
+}
+
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+bool nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::predictControl(const Eigen::Ref<const Eigen::VectorXd> &_X0)
+{
+    assert(_X0.size() == NX + 2);
+    return predictControl(casadi::DM(std::vector<double>(_X0.data(), _X0.data() + NX + 2)));
+}
+
+/** columns: augmented state (unscaled), reference velocity and path coefficients */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+casadi::DM nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::getSensitivity()
+{
+    if(!Sensitivity.factorized())
+        return casadi::DM();
+
+    const int n_w = Sensitivity.solution().size();
+    const int n_p = Sensitivity.parameters().size();
+    std::vector<double> scale_x = casadi::DM::densify(Scale_X).nonzeros();
+
+    Eigen::MatrixXd sens(n_w, NX + 2 + n_p);
+    sens.leftCols(NX + 2) = m_sens_x0 * Eigen::Map<Eigen::MatrixXd>(scale_x.data(), NX + 2, NX + 2);
+    for(int j = 0; j < n_p; ++j)
+        sens.col(NX + 2 + j) = Sensitivity.primal_step(Eigen::VectorXd::Unit(n_p, j), Eigen::VectorXd::Zero(n_w));
+
+    return polymath::eigen2casadi<casadi::DM>(sens);
+}
+
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+bool nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::exportController(const std::string &dir, const std::string &name)
+{
+    const int N = NUM_COLLOCATION_POINTS;
+
+    ControllerExport problem;
+    problem.nlp   = !NLP.empty() ? NLP : expand_nlp(MappedNLP, casadi::SX::sym("w", ARG["lbx"].size1()),
+                                                    casadi::SX::sym("p", ARG["p"].size1()));
+    problem.lbx   = ARG["lbx"];
+    problem.ubx   = ARG["ubx"];
+    problem.lbg   = ARG["lbg"];
+    problem.ubg   = ARG["ubg"];
+    problem.w0    = ARG["x0"];
+    problem.p0    = ARG["p"];
+    problem.state_scaling   = Scale_X;
+    problem.control_scaling = invSU;
+    problem.state_index     = N * (NX + 2);
+    problem.control_index   = (N + 1) * (NX + 2) + N * (NU + 1);
+    problem.nx = NX + 2;
+    problem.nu = NU + 1;
+    problem.node_times = Chebyshev<casadi::SX, PolyOrder, NumSegments, NX + 2, NU + 1, 0>::NodeTimes(0, Tf);
+    problem.opts = OPTS;
+    return export_controller(dir, name, problem);
+}
+
+/** shift the primal-dual solution forward by one sampling interval */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::shift_solution()
+{
+    if(ShiftOpT.is_empty() || NLP_X.is_empty())
+        return;
+
+    int N = NUM_COLLOCATION_POINTS;
+    casadi::Slice x_var(0, (N + 1) * (NX + 2));
+    casadi::Slice u_var((N + 1) * (NX + 2), (N + 1) * (NX + NU + 3));
+
+    /** states and controls */
+    NLP_X(x_var, 0) = casadi::DM::vec(casadi::DM::mtimes(casadi::DM::reshape(NLP_X(x_var), NX + 2, N + 1), ShiftOpT));
+    NLP_X(u_var, 0) = casadi::DM::vec(casadi::DM::mtimes(casadi::DM::reshape(NLP_X(u_var), NU + 1, N + 1), ShiftOpT));
+
+    /** bound multipliers */
+    NLP_LAM_X(x_var, 0) = casadi::DM::vec(casadi::DM::mtimes(casadi::DM::reshape(NLP_LAM_X(x_var), NX + 2, N + 1), ShiftOpT));
+    NLP_LAM_X(u_var, 0) = casadi::DM::vec(casadi::DM::mtimes(casadi::DM::reshape(NLP_LAM_X(u_var), NU + 1, N + 1), ShiftOpT));
+    /** dynamics and path constraint multipliers, one column per node each */
+    const int nh = LBG.size1();
+    const int num_dyn = (N + 1) * (NX + 2);
+    casadi::DM lam_g = casadi::DM::reshape(NLP_LAM_G(casadi::Slice(0, num_dyn)), NX + 2, N + 1);
+    casadi::DM lam_h = casadi::DM::reshape(NLP_LAM_G(casadi::Slice(num_dyn, num_dyn + nh * (N + 1))), nh, N + 1);
+    NLP_LAM_G = casadi::DM::vertcat({casadi::DM::vec(casadi::DM::mtimes(lam_g, ShiftOpT)),
+                                     casadi::DM::vec(casadi::DM::mtimes(lam_h, ShiftOpT))});
+}
+
 /** get path error */
 template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
 double nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::getPathError()
@@ -511,7 +1167,7 @@ double nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::getPathError()
     {
         casadi::DM state = OptimalTrajectory(casadi::Slice(0, OptimalTrajectory.size1()), OptimalTrajectory.size2() - 1);
         state = casadi::DM::mtimes(Scale_X, state);
-        casadi::DMVector tmp = PathError(casadi::DMVector{state});
+        casadi::DMVector tmp = PathError(casadi::DMVector{state, ARG["p"]});
         error = casadi::DM::norm_2( tmp[0] ).nonzeros()[0];
     }
     return error;
@@ -544,42 +1200,64 @@ double nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::getVirtState()
     return virt_state;
 }
 
-/** compute intial guess for virtual state */
+/** path in the cost: the symbolic path or the series with parametric coefficients */
 template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
-casadi::DM nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::findClosestPointOnPath(const casadi::DM &position,
-                                                                                          const casadi::DM &init_guess)
+casadi::SX nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::path_expression(const casadi::SX &theta, const casadi::SX &coefficients)
 {
-    casadi::SX theta = casadi::SX::sym("theta");
-    casadi::SX sym_residual = 0.5 * casadi::SX::norm_2(PathFunc(casadi::SXVector{theta})[0] - casadi::SX(position));
-    casadi::SX sym_gradient = casadi::SX::gradient(sym_residual,theta);
-
-    casadi::Function grad = casadi::Function("gradient", {theta}, {sym_gradient});
+    if(Series.type() == NO_SERIES)
+        return PathFunc(casadi::SXVector{theta})[0];
+    return Series.evaluate(coefficients, theta, ny);
+}
 
-    double tol = 1e-2;
-    int counter = 0;
-    casadi::DM theta_i = init_guess;
-    casadi::DMVector result  = grad(casadi::DMVector{theta_i});
-    double step = 0.25;
+/** numeric geometry of the current series */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::fit_geometry()
+{
+    std::vector<double> data = casadi::DM::densify(PathCoefficients).nonzeros();
+    Eigen::MatrixXd C = Eigen::Map<Eigen::MatrixXd>(data.data(), ny, Series.size());
+    const PathSeries &series = Series;
+    Geometry.fit([&series, &C](const double &s){return series.evaluate(C, s);}, 0.0, reset_path_after, true);
+}
 
-    /** check for local minimum */
-    if(fabs(result[0].nonzeros()[0]) < tol)
+/** new path without rebuilding the NLP: the reference velocity is kept */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+void nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::setPathCoefficients(const casadi::DM &coefficients)
+{
+    if(Series.type() == NO_SERIES)
     {
-        theta_i = {M_PI_2 + 0.1};
-        result  = grad(casadi::DMVector{theta_i});
+        std::cout << "nmpf: the path is symbolic, set \"mpc.path_series\" to pass path coefficients \n";
+        return;
     }
-
-    /** @badcode : shitty code */
-    while (fabs(result[0].nonzeros()[0]) >= tol)
+    if(coefficients.numel() != ny * Series.size())
     {
-        counter++;
-        theta_i -= step * grad(theta_i);
-        /** gradient update */
-        result  = grad(casadi::DMVector{theta_i});
-        if(counter > 10)
-            break;
+        std::cout << "nmpf: expected " << ny << " x " << Series.size() << " path coefficients, got "
+                  << coefficients.size1() << " x " << coefficients.size2() << "\n";
+        return;
     }
-    //std::cout << theta_i << "\n";
-    return theta_i;
+
+    /** createNLP() sets the parameters from the stored coefficients, a built problem is updated in place */
+    PathCoefficients = casadi::DM::reshape(casadi::DM::densify(coefficients), ny, Series.size());
+    casadi::DMDict::iterator p = ARG.find("p");
+    if((p != ARG.end()) && (p->second.size1() == 1 + ny * Series.size()))
+        p->second(casadi::Slice(1, 1 + ny * Series.size())) = casadi::DM::vec(PathCoefficients);
+    fit_geometry();
+}
+
+/** compute intial guess for virtual state */
+template<typename System, typename Path, int NX, int NU, int NumSegments, int PolyOrder>
+casadi::DM nmpf<System, Path, NX, NU, NumSegments, PolyOrder>::findClosestPointOnPath(const casadi::DM &position,
+                                                                                          const casadi::DM &init_guess)
+{
+    std::vector<double> point = casadi::DM::densify(position).nonzeros();
+    Eigen::Map<const Eigen::VectorXd> x(point.data(), point.size());
+
+    /** local Newton search from the guess, the global search from the arc-length table guards against local minima */
+    double s_local  = Geometry.closest_point(x, init_guess.is_empty() ? 0.0 : init_guess.nonzeros()[0]);
+    double s_global = Geometry.closest_point(x);
+    double d_local  = (Geometry.position(s_local) - x).squaredNorm();
+    double d_global = (Geometry.position(s_global) - x).squaredNorm();
+
+    return casadi::DM((d_local <= d_global + 1e-12) ? s_local : s_global);
 }
 
 }
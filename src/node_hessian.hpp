@@ -0,0 +1,72 @@
+#ifndef NODE_HESSIAN_HPP
+#define NODE_HESSIAN_HPP
+
+#include "casadi/casadi.hpp"
+#include "nlp_cache.hpp"
+
+namespace polympc {
+
+/** Exact Hessian of the Lagrangian of a collocated NLP assembled from a per-node kernel. In the collocation layout
+ *  w = [X; U] (node-major) every nonlinear term of sigma * f + lam_g' g depends on a single node (x_k, u_k): the
+ *  differentiation matrix enters linearly, the model, the integral cost and the path constraints are node-wise. With
+ *
+ *  kernel: {x, u, node_param, c_lagrange, c_mayer, lam_dyn, lam_path} -> triu(hessian of the node Lagrangian in [x; u])
+ *
+ *  the Hessian is one mapped kernel call scattered into the block pattern, no second derivatives of the full graph are
+ *  taken. The returned function has the "hess_lag" signature {w, p, lam_f, lam_g} -> triu(H). Layout of g: collocation
+ *  rows of the first 'num_dyn_nodes' nodes (nx each), followed by the path constraints (nh per node, all nodes).
+ *  'node_params' maps p to the node parameters (one column per node), 'lagrange_weights' are the quadrature weights of
+ *  the integral cost, the Mayer term is evaluated at node 0. */
+inline casadi::Function node_hessian_lagrangian(const std::string &name, const casadi::Function &kernel,
+                                                const casadi::Function &node_params, const int &nx, const int &nu,
+                                                const int &num_nodes, const int &num_dyn_nodes, const int &nh,
+                                                const casadi::DM &lagrange_weights, const std::string &parallelization,
+                                                const casadi::Dict &opts)
+{
+    const int nz = nx + nu;
+    const casadi_int n_w = num_nodes * nz;
+    const casadi_int n_g = num_dyn_nodes * nx + num_nodes * nh;
+
+    casadi::MX w     = casadi::MX::sym("w", n_w);
+    casadi::MX p     = casadi::MX::sym("p", node_params.nnz_in(0));
+    casadi::MX lam_f = casadi::MX::sym("lam_f");
+    casadi::MX lam_g = casadi::MX::sym("lam_g", n_g);
+
+    casadi::MX X = casadi::MX::reshape(w(casadi::Slice(0, num_nodes * nx)), nx, num_nodes);
+    casadi::MX U = casadi::MX::reshape(w(casadi::Slice(num_nodes * nx, n_w)), nu, num_nodes);
+
+    /** nodes without collocation rows (e.g. the initial state slot) have a zero multiplier */
+    casadi::MX lam_dyn = lam_g(casadi::Slice(0, num_dyn_nodes * nx));
+    if(num_dyn_nodes < num_nodes)
+        lam_dyn = casadi::MX::vertcat({lam_dyn, casadi::MX::zeros((num_nodes - num_dyn_nodes) * nx)});
+    casadi::MX lam_path = lam_g(casadi::Slice(num_dyn_nodes * nx, n_g));
+
+    casadi::DM mayer_weights = casadi::DM::zeros(1, num_nodes);
+    mayer_weights(0) = 1;
+
+    /** one compiled kernel, evaluated once per node */
+    casadi::Function node_kernel = cached_function(kernel, opts).map(num_nodes, parallelization);
+    casadi::MX blocks = node_kernel(casadi::MXVector{X, U, node_params(casadi::MXVector{p})[0],
+                                                     lam_f * casadi::MX(casadi::DM::reshape(lagrange_weights, 1, num_nodes)),
+                                                     lam_f * casadi::MX(mayer_weights),
+                                                     casadi::MX::reshape(lam_dyn, nx, num_nodes),
+                                                     casadi::MX::reshape(lam_path, nh, num_nodes)})[0];
+
+    /** block diagonal in the node ordering [x_0; u_0; x_1; ...], permuted to [X; U]. States precede the controls in
+     *  both orderings, so the permuted upper triangle stays upper triangular */
+    casadi::MX H_nodes = casadi::MX::diagcat(casadi::MX::horzsplit(blocks, nz));
+    std::vector<casadi_int> perm(n_w);
+    for(int k = 0; k < num_nodes; ++k)
+    {
+        for(int i = 0; i < nx; ++i)
+            perm[k * nx + i] = k * nz + i;
+        for(int i = 0; i < nu; ++i)
+            perm[num_nodes * nx + k * nu + i] = k * nz + nx + i;
+    }
+
+    return casadi::Function(name, {w, p, lam_f, lam_g}, {H_nodes(perm, perm)});
+}
+
+} // polympc namespace
+
+#endif // NODE_HESSIAN_HPP
@@ -0,0 +1,252 @@
+#ifndef PATH_GEOMETRY_HPP
+#define PATH_GEOMETRY_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "eigen3/Eigen/Dense"
+#include "chebyshev_tables.hpp"
+#include "kd_tree.hpp"
+
+namespace polympc {
+
+/** Numeric path geometry: the path p(s), s in [s_min, s_max], is sampled once at the nodes of a composite Chebyshev
+ *  grid, derivatives are taken with the differentiation matrix, evaluation is barycentric interpolation of the nodal
+ *  values (position, tangent dp/ds and dp^2/ds^2 per segment). An arc-length table over a uniform grid in s gives the
+ *  reparametrization s <-> arc length, a KD-tree over dense path samples seeds the global closest-point search.
+ *  Evaluation does not allocate for a fixed dimension Dim. */
+template<int Dim = Eigen::Dynamic, int PolyOrder = 7, int NumSegments = 16>
+class PathGeometry
+{
+public:
+    typedef polymath::ChebyshevTables<PolyOrder, NumSegments> tables_t;
+    typedef Eigen::Matrix<double, Dim, 1>               point_t;
+    typedef Eigen::Matrix<double, Dim, Eigen::Dynamic>  nodal_values_t;
+    typedef std::function<point_t(const double&)>       path_t;
+
+    enum
+    {
+        NumNodes = NumSegments * PolyOrder + 1,
+        TableResolution = 8,
+        IndexResolution = 32
+    };
+
+    PathGeometry() : m_s_min(0), m_s_max(1), m_periodic(false), m_fitted(false) {}
+    ~PathGeometry(){}
+
+    /** sample the path and build the tables; a periodic path is evaluated modulo (s_max - s_min) */
+    void fit(const path_t &path, const double &s_min, const double &s_max, const bool &periodic = false);
+    bool fitted() const {return m_fitted;}
+
+    double lower() const {return m_s_min;}
+    double upper() const {return m_s_max;}
+    bool periodic() const {return m_periodic;}
+
+    point_t position(const double &s) const {return interpolate(m_position, s);}
+    /** dp/ds */
+    point_t tangent(const double &s) const {return interpolate(m_tangent, s);}
+    /** d^2p/ds^2 */
+    point_t second_derivative(const double &s) const {return interpolate(m_second, s);}
+    /** |p' x p''| / |p'|^3, written with dot products for any dimension */
+    double curvature(const double &s) const;
+
+    /** arc length from s_min to s (within one period) and its inverse */
+    double arc_length(const double &s) const;
+    double parameter(const double &arc) const;
+    double length() const {return m_arc.empty() ? 0 : m_arc.back();}
+
+    /** closest point: safeguarded Newton iterations on (p(s) - x)' p'(s) = 0 from the guess (a step that increases
+     *  the distance is halved); the global search starts from the nearest of the indexed path samples. On a periodic
+     *  path the result is not wrapped (stays near the guess) */
+    double closest_point(const point_t &x, const double &s_guess, const int &max_iter = 20, const double &tol = 1e-10) const;
+    double closest_point(const point_t &x) const;
+
+private:
+    double m_s_min, m_s_max;
+    bool   m_periodic, m_fitted;
+
+    /** nodal values per segment: columns k * (PolyOrder + 1) ... (k + 1) * (PolyOrder + 1) - 1 */
+    nodal_values_t m_position, m_tangent, m_second;
+
+    /** arc length at s_min + k * ds */
+    std::vector<double> m_arc;
+    double m_ds;
+
+    /** path samples at s_min + k * ds_index for the global search */
+    KDTree<Dim> m_index;
+    double m_ds_index;
+
+    double wrap(const double &s) const;
+    point_t interpolate(const nodal_values_t &values, const double &s) const;
+};
+
+template<int Dim, int PolyOrder, int NumSegments>
+double PathGeometry<Dim, PolyOrder, NumSegments>::wrap(const double &s) const
+{
+    if(!m_periodic)
+        return std::max(m_s_min, std::min(m_s_max, s));
+
+    double period = m_s_max - m_s_min;
+    double s_w = std::fmod(s - m_s_min, period);
+    return m_s_min + ((s_w < 0) ? s_w + period : s_w);
+}
+
+template<int Dim, int PolyOrder, int NumSegments>
+typename PathGeometry<Dim, PolyOrder, NumSegments>::point_t
+PathGeometry<Dim, PolyOrder, NumSegments>::interpolate(const nodal_values_t &values, const double &s) const
+{
+    int offset;
+    typename tables_t::nodes_t weights;
+    tables_t::InterpolationWeights(wrap(s), m_s_min, m_s_max, offset, weights);
+
+    const int segment = offset / PolyOrder;
+    return values.middleCols(segment * (PolyOrder + 1), PolyOrder + 1) * weights;
+}
+
+template<int Dim, int PolyOrder, int NumSegments>
+void PathGeometry<Dim, PolyOrder, NumSegments>::fit(const path_t &path, const double &s_min, const double &s_max,
+                                                   const bool &periodic)
+{
+    m_s_min = s_min;
+    m_s_max = s_max;
+    m_periodic = periodic;
+
+    const typename tables_t::nodes_t &tau = tables_t::Nodes();
+    const typename tables_t::diff_matrix_t &D = tables_t::D();
+    const double h = (s_max - s_min) / NumSegments;
+
+    /** segment k covers [s_max - (k + 1) h, s_max - k h], node 0 at its upper end (composite grid ordering) */
+    const int dim = path(s_min).size();
+    m_position.resize(dim, NumSegments * (PolyOrder + 1));
+    for(int k = 0; k < NumSegments; ++k)
+    {
+        double s_low = s_max - (k + 1) * h;
+        for(int j = 0; j <= PolyOrder; ++j)
+            m_position.col(k * (PolyOrder + 1) + j) = path(s_low + 0.5 * h * (tau[j] + 1));
+    }
+
+    /** ds = h / 2 dtau */
+    m_tangent.resize(dim, m_position.cols());
+    m_second.resize(dim, m_position.cols());
+    for(int k = 0; k < NumSegments; ++k)
+    {
+        m_tangent.middleCols(k * (PolyOrder + 1), PolyOrder + 1) =
+                (2.0 / h) * m_position.middleCols(k * (PolyOrder + 1), PolyOrder + 1) * D.transpose();
+        m_second.middleCols(k * (PolyOrder + 1), PolyOrder + 1) =
+                (2.0 / h) * m_tangent.middleCols(k * (PolyOrder + 1), PolyOrder + 1) * D.transpose();
+    }
+    m_fitted = true;
+
+    /** arc length: Simpson's rule on the speed |p'(s)| over a uniform grid */
+    const int n_table = TableResolution * NumSegments;
+    m_ds = (s_max - s_min) / n_table;
+    m_arc.assign(n_table + 1, 0.0);
+    for(int k = 0; k < n_table; ++k)
+    {
+        double s = s_min + k * m_ds;
+        double speed = tangent(s).norm() + 4 * tangent(s + 0.5 * m_ds).norm() + tangent(std::min(s + m_ds, s_max)).norm();
+        m_arc[k + 1] = m_arc[k] + m_ds * speed / 6.0;
+    }
+
+    /** spatial index: the end point of a periodic path coincides with the start and is left out */
+    const int n_index = IndexResolution * NumSegments + (periodic ? 0 : 1);
+    m_ds_index = (s_max - s_min) / (IndexResolution * NumSegments);
+    nodal_values_t samples(dim, n_index);
+    for(int k = 0; k < n_index; ++k)
+        samples.col(k) = position(s_min + k * m_ds_index);
+    m_index.build(samples);
+}
+
+template<int Dim, int PolyOrder, int NumSegments>
+double PathGeometry<Dim, PolyOrder, NumSegments>::curvature(const double &s) const
+{
+    point_t d1 = tangent(s);
+    point_t d2 = second_derivative(s);
+    double speed2 = d1.squaredNorm();
+    if(speed2 < 1e-24)
+        return 0;
+    double cross2 = std::max(0.0, speed2 * d2.squaredNorm() - std::pow(d1.dot(d2), 2));
+    return std::sqrt(cross2) / std::pow(speed2, 1.5);
+}
+
+template<int Dim, int PolyOrder, int NumSegments>
+double PathGeometry<Dim, PolyOrder, NumSegments>::arc_length(const double &s) const
+{
+    double s_w = wrap(s);
+    int k = std::min(static_cast<int>((s_w - m_s_min) / m_ds), static_cast<int>(m_arc.size()) - 2);
+    double s_k = m_s_min + k * m_ds;
+
+    /** Simpson's rule on the partial interval */
+    double d = s_w - s_k;
+    return m_arc[k] + d * (tangent(s_k).norm() + 4 * tangent(s_k + 0.5 * d).norm() + tangent(s_w).norm()) / 6.0;
+}
+
+template<int Dim, int PolyOrder, int NumSegments>
+double PathGeometry<Dim, PolyOrder, NumSegments>::parameter(const double &arc) const
+{
+    double a = std::max(0.0, std::min(length(), arc));
+    std::vector<double>::const_iterator it = std::upper_bound(m_arc.begin(), m_arc.end(), a);
+    int k = std::max(0, std::min(static_cast<int>(it - m_arc.begin()) - 1, static_cast<int>(m_arc.size()) - 2));
+
+    /** linear guess in the table interval, refined with Newton steps d(arc)/ds = |p'| */
+    double span = m_arc[k + 1] - m_arc[k];
+    double s = m_s_min + m_ds * (k + ((span > 0) ? (a - m_arc[k]) / span : 0.0));
+    for(int i = 0; i < 3; ++i)
+    {
+        double speed = tangent(s).norm();
+        if(speed < 1e-12)
+            break;
+        s = std::max(m_s_min + k * m_ds, std::min(m_s_min + (k + 1) * m_ds, s - (arc_length(s) - a) / speed));
+    }
+    return s;
+}
+
+template<int Dim, int PolyOrder, int NumSegments>
+double PathGeometry<Dim, PolyOrder, NumSegments>::closest_point(const point_t &x, const double &s_guess,
+                                                               const int &max_iter, const double &tol) const
+{
+    double s = m_periodic ? s_guess : wrap(s_guess);
+    point_t e = position(s) - x;
+    for(int i = 0; i < max_iter; ++i)
+    {
+        point_t d1 = tangent(s);
+        double r  = e.dot(d1);
+        double dr = d1.squaredNorm() + e.dot(second_derivative(s));
+
+        /** Newton on the stationarity condition, a gradient step away from maxima */
+        double step = (dr > 1e-12) ? -r / dr : -r / std::max(1e-12, d1.squaredNorm());
+        step = std::max(-0.5 * m_ds * TableResolution, std::min(0.5 * m_ds * TableResolution, step));
+
+        /** backtracking on the distance */
+        double s_new = m_periodic ? s + step : wrap(s + step);
+        point_t e_new = position(s_new) - x;
+        for(int j = 0; j < 8 && e_new.squaredNorm() > e.squaredNorm(); ++j)
+        {
+            step *= 0.5;
+            s_new = m_periodic ? s + step : wrap(s + step);
+            e_new = position(s_new) - x;
+        }
+        if(e_new.squaredNorm() > e.squaredNorm())
+            break;
+
+        s = s_new;
+        e = e_new;
+        if(std::fabs(step) < tol)
+            break;
+    }
+    return s;
+}
+
+template<int Dim, int PolyOrder, int NumSegments>
+double PathGeometry<Dim, PolyOrder, NumSegments>::closest_point(const point_t &x) const
+{
+    double d_best;
+    int k_best = m_index.nearest(x, d_best);
+    return closest_point(x, m_s_min + std::max(0, k_best) * m_ds_index);
+}
+
+} // polympc namespace
+
+#endif // PATH_GEOMETRY_HPP
@@ -0,0 +1,126 @@
+#ifndef PATH_SERIES_HPP
+#define PATH_SERIES_HPP
+
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "casadi/casadi.hpp"
+#include "eigen3/Eigen/Dense"
+
+namespace polympc {
+
+enum PathSeriesType {NO_SERIES, CHEBYSHEV_SERIES, FOURIER_SERIES};
+
+/** Path as a fixed-degree series p(theta) = C * phi(theta) over [0, period]: Chebyshev polynomials T_0 ... T_degree
+ *  of 2 * theta / period - 1, or the periodic Fourier basis [1, cos(w theta), sin(w theta), ..., sin(degree w theta)]
+ *  with w = 2 pi / period. The coefficient matrix C (dim x size()) enters the NLP as a parameter, so a new path is a
+ *  new parameter value and not a new problem. */
+class PathSeries
+{
+public:
+    PathSeries(const PathSeriesType &type = NO_SERIES, const int &degree = 0, const double &period = 2 * M_PI)
+        : m_type(type), m_degree(degree), m_period(period) {}
+    ~PathSeries(){}
+
+    PathSeriesType type() const {return m_type;}
+    int degree() const {return m_degree;}
+    double period() const {return m_period;}
+
+    /** number of basis functions */
+    int size() const
+    {
+        switch(m_type)
+        {
+        case CHEBYSHEV_SERIES: return m_degree + 1;
+        case FOURIER_SERIES:   return 2 * m_degree + 1;
+        default:               return 0;
+        }
+    }
+
+    /** basis functions at theta, for numeric and symbolic scalars */
+    template<typename Scalar>
+    void basis(const Scalar &theta, std::vector<Scalar> &phi) const;
+
+    /** symbolic path, 'coefficients' is vec(C) */
+    casadi::SX evaluate(const casadi::SX &coefficients, const casadi::SX &theta, const int &dim) const
+    {
+        std::vector<casadi::SX> phi;
+        basis(theta, phi);
+        return casadi::SX::mtimes(casadi::SX::reshape(coefficients, dim, size()), casadi::SX::vertcat(phi));
+    }
+
+    Eigen::VectorXd evaluate(const Eigen::Ref<const Eigen::MatrixXd> &C, const double &theta) const
+    {
+        std::vector<double> phi;
+        basis(theta, phi);
+        return C * Eigen::Map<const Eigen::VectorXd>(phi.data(), phi.size());
+    }
+
+    /** least-squares coefficients (dim x size()) of a path sampled over one period */
+    Eigen::MatrixXd fit(const std::function<Eigen::VectorXd(const double&)> &path) const;
+
+private:
+    PathSeriesType m_type;
+    int m_degree;
+    double m_period;
+};
+
+template<typename Scalar>
+void PathSeries::basis(const Scalar &theta, std::vector<Scalar> &phi) const
+{
+    using std::cos;
+    using std::sin;
+
+    phi.resize(size());
+    if(phi.empty())
+        return;
+
+    phi[0] = Scalar(1);
+    if(m_type == CHEBYSHEV_SERIES)
+    {
+        /** three-term recurrence on [-1, 1] */
+        Scalar tau = 2 * theta / m_period - 1;
+        if(m_degree > 0)
+            phi[1] = tau;
+        for(int k = 2; k <= m_degree; ++k)
+            phi[k] = 2 * tau * phi[k - 1] - phi[k - 2];
+    }
+    else
+    {
+        const double w = 2 * M_PI / m_period;
+        for(int k = 1; k <= m_degree; ++k)
+        {
+            phi[2 * k - 1] = cos(k * w * theta);
+            phi[2 * k]     = sin(k * w * theta);
+        }
+    }
+}
+
+inline Eigen::MatrixXd PathSeries::fit(const std::function<Eigen::VectorXd(const double&)> &path) const
+{
+    const int n = size();
+    if(n == 0)
+        return Eigen::MatrixXd();
+
+    /** oversampled Chebyshev-Lobatto points for the polynomial basis, a uniform grid for the periodic one */
+    const int m = 4 * n;
+    Eigen::MatrixXd Phi(m, n), P;
+    std::vector<double> phi;
+    for(int j = 0; j < m; ++j)
+    {
+        double theta = (m_type == CHEBYSHEV_SERIES) ? 0.5 * m_period * (1 - std::cos(j * M_PI / (m - 1)))
+                                                    : j * m_period / m;
+        Eigen::VectorXd point = path(theta);
+        if(j == 0)
+            P.resize(m, point.size());
+        P.row(j) = point.transpose();
+
+        basis(theta, phi);
+        Phi.row(j) = Eigen::Map<const Eigen::RowVectorXd>(phi.data(), n);
+    }
+    return Phi.householderQr().solve(P).transpose();
+}
+
+} // polympc namespace
+
+#endif // PATH_SERIES_HPP
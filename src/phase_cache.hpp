@@ -0,0 +1,145 @@
+#ifndef PHASE_CACHE_HPP
+#define PHASE_CACHE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "eigen3/Eigen/Dense"
+
+namespace polympc {
+
+/** Warm-start cache for periodic problems: converged primal-dual solutions indexed by the phase of a periodic
+ *  coordinate (path parameter modulo the period), one entry per phase bin (the latest solution of the bin). A lookup
+ *  blends the nearest stored phases on both sides of the query linearly, the entries of the periodic coordinate in
+ *  the primal solution ('phase_indices', in units of 'phase_scale' per phase) are shifted to the query phase first. */
+class PhaseCache
+{
+public:
+    PhaseCache() : m_period(2 * M_PI), m_phase_scale(1) {}
+    ~PhaseCache(){}
+
+    void init(const int &num_bins, const double &period, const std::vector<int> &phase_indices, const double &phase_scale);
+    bool enabled() const {return !m_entries.empty();}
+    void clear();
+
+    void store(const double &phase, const Eigen::VectorXd &w, const Eigen::VectorXd &lam_g, const Eigen::VectorXd &lam_x);
+
+    /** false if neither the bin of the phase nor its neighbours hold a solution */
+    bool lookup(const double &phase, Eigen::VectorXd &w, Eigen::VectorXd &lam_g, Eigen::VectorXd &lam_x) const;
+
+private:
+    struct Entry
+    {
+        bool valid;
+        double phase;    /**< the periodic coordinate of the solution, not wrapped */
+        Eigen::VectorXd w, lam_g, lam_x;
+    };
+
+    std::vector<Entry> m_entries;
+    double m_period, m_phase_scale;
+    std::vector<int> m_phase_indices;
+
+    double wrap(const double &phase) const;
+    int bin(const double &phase) const;
+    /** phase - reference in (-period / 2, period / 2] */
+    double difference(const double &phase, const double &reference) const;
+};
+
+inline void PhaseCache::init(const int &num_bins, const double &period, const std::vector<int> &phase_indices,
+                             const double &phase_scale)
+{
+    m_period = period;
+    m_phase_scale = phase_scale;
+    m_phase_indices = phase_indices;
+    m_entries.assign(std::max(0, num_bins), Entry{false, 0, Eigen::VectorXd(), Eigen::VectorXd(), Eigen::VectorXd()});
+}
+
+inline void PhaseCache::clear()
+{
+    for(std::size_t k = 0; k < m_entries.size(); ++k)
+        m_entries[k].valid = false;
+}
+
+inline double PhaseCache::wrap(const double &phase) const
+{
+    double s = std::fmod(phase, m_period);
+    return (s < 0) ? s + m_period : s;
+}
+
+inline int PhaseCache::bin(const double &phase) const
+{
+    const int num_bins = m_entries.size();
+    return std::min(num_bins - 1, static_cast<int>(wrap(phase) / m_period * num_bins));
+}
+
+inline double PhaseCache::difference(const double &phase, const double &reference) const
+{
+    double d = wrap(phase - reference);
+    return (d > 0.5 * m_period) ? d - m_period : d;
+}
+
+inline void PhaseCache::store(const double &phase, const Eigen::VectorXd &w, const Eigen::VectorXd &lam_g,
+                              const Eigen::VectorXd &lam_x)
+{
+    if(!enabled())
+        return;
+
+    Entry &entry = m_entries[bin(phase)];
+    entry.valid = true;
+    entry.phase = phase;
+    entry.w     = w;
+    entry.lam_g = lam_g;
+    entry.lam_x = lam_x;
+}
+
+inline bool PhaseCache::lookup(const double &phase, Eigen::VectorXd &w, Eigen::VectorXd &lam_g, Eigen::VectorXd &lam_x) const
+{
+    if(!enabled())
+        return false;
+
+    /** closest stored phase behind (d <= 0) and ahead of (d > 0) the query in the neighbouring bins */
+    const int num_bins = m_entries.size();
+    const int center = bin(phase);
+    const Entry *behind = nullptr, *ahead = nullptr;
+    double d_behind = 0, d_ahead = 0;
+    for(int k = -1; k <= 1; ++k)
+    {
+        const Entry &entry = m_entries[(center + k + num_bins) % num_bins];
+        if(!entry.valid)
+            continue;
+
+        double d = difference(entry.phase, phase);
+        if(d <= 0 && (!behind || d > d_behind))
+        {
+            behind = &entry;
+            d_behind = d;
+        }
+        else if(d > 0 && (!ahead || d < d_ahead))
+        {
+            ahead = &entry;
+            d_ahead = d;
+        }
+    }
+    if(!behind && !ahead)
+        return false;
+
+    /** linear weights in the phase, a single neighbour is used as is */
+    double weight_ahead = (behind && ahead && behind != ahead) ? -d_behind / (d_ahead - d_behind) : (ahead ? 1.0 : 0.0);
+    const Entry &first  = behind ? *behind : *ahead;
+    const Entry &second = ahead ? *ahead : *behind;
+
+    w     = (1 - weight_ahead) * first.w + weight_ahead * second.w;
+    lam_g = (1 - weight_ahead) * first.lam_g + weight_ahead * second.lam_g;
+    lam_x = (1 - weight_ahead) * first.lam_x + weight_ahead * second.lam_x;
+
+    /** move the periodic coordinate of the blended solution to the query phase */
+    double shift = m_phase_scale * (phase - (1 - weight_ahead) * first.phase - weight_ahead * second.phase);
+    for(std::size_t k = 0; k < m_phase_indices.size(); ++k)
+        w[m_phase_indices[k]] += shift;
+
+    return true;
+}
+
+} // polympc namespace
+
+#endif // PHASE_CACHE_HPP
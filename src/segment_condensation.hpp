@@ -0,0 +1,199 @@
+#ifndef SEGMENT_CONDENSATION_HPP
+#define SEGMENT_CONDENSATION_HPP
+
+#include "casadi/casadi.hpp"
+#include "nlp_cache.hpp"
+
+namespace polympc {
+
+/** condensed solver: 'solver' has the nlpsol signature in the full collocation layout, 'reduced' is the inner nlpsol */
+struct CondensedNLP
+{
+    casadi::Function solver;
+    casadi::Function reduced;
+};
+
+/** sparse selection matrix: row k picks entry idx[k] of a vector of length n */
+inline casadi::DM selection_matrix(const std::vector<casadi_int> &idx, const casadi_int &n)
+{
+    std::vector<casadi_int> rows(idx.size()), cols(idx.begin(), idx.end());
+    for(std::size_t k = 0; k < idx.size(); ++k)
+        rows[k] = k;
+    return casadi::DM::triplet(rows, cols, std::vector<double>(idx.size(), 1.0), idx.size(), n);
+}
+
+/** Static condensation of the collocation nodes: inside segment s the nodes sP..sP+P-1 are the implicit function of
+ *  the segment initial state (node sP+P) and the segment controls defined by the segment's P * NX collocation
+ *  equations. They are computed by local Newton solves (casadi::rootfinder, sensitivities from the implicit function
+ *  theorem), one mapped call over all segments. The outer NLP keeps the segment boundary states and the controls:
+ *
+ *  min f(X(xb, u), u)  s.t.  xb_s - X_s(xb_{s+1}, u_s) = 0,  lbx <= X_interior <= ubx (bounded components only),
+ *                            lbg <= g_extra(X(xb, u), u) <= ubg
+ *
+ *  Expects the nmpc layout: w = [X; U] node-major, NumSegments * PolyOrder * NX collocation rows followed by the
+ *  remaining constraints (g_extra), time-invariant collocation (identical segments). The interior nodes of the initial guess seed the Newton solves. */
+inline CondensedNLP condensed_nlpsol(const std::string &name, const std::string &solver, const casadi::SXDict &nlp,
+                                     const int &nx, const int &nu, const int &num_segments, const int &poly_order,
+                                     const casadi::DM &lbx, const casadi::DM &ubx, const std::string &parallelization,
+                                     const casadi::Dict &opts)
+{
+    const int S = num_segments;
+    const int P = poly_order;
+    const int N = S * P;
+    const int num_nodes = N + 1;
+
+    casadi::SX w = nlp.at("x");
+    casadi::SX p = (nlp.find("p") != nlp.end()) ? nlp.at("p") : casadi::SX::sym("p", 0);
+    casadi::Function f_fun("nlp_f", {w, p}, {nlp.at("f")});
+    casadi::Function g_fun("nlp_g", {w, p}, {nlp.at("g")});
+    const casadi_int n_w = w.size1();
+    const casadi_int n_g = g_fun.nnz_out(0);
+    const casadi_int n_p = p.size1();
+
+    /** the compiled solver cache does not apply to the MX formulation */
+    casadi::Dict solver_opts = opts;
+    cache_directory(solver_opts);
+
+    CondensedNLP result;
+    if((n_w != num_nodes * (nx + nu)) || (n_g < N * nx))
+    {
+        std::cout << "condensed_nlpsol: unexpected problem layout, solving the full problem \n";
+        result.solver = casadi::nlpsol(name, solver, nlp, solver_opts);
+        result.reduced = result.solver;
+        return result;
+    }
+
+    /** residual of segment 0: unknown nodes 0..P-1, parameters [initial node P; controls 0..P; p] */
+    casadi::SX z     = casadi::SX::sym("z", P * nx);
+    casadi::SX x_ini = casadi::SX::sym("x_ini", nx);
+    casadi::SX u_seg = casadi::SX::sym("u_seg", (P + 1) * nu);
+    casadi::SX w_seg = casadi::SX::zeros(n_w);
+    w_seg(casadi::Slice(0, (P + 1) * nx)) = casadi::SX::vertcat({z, x_ini});
+    w_seg(casadi::Slice(num_nodes * nx, num_nodes * nx + (P + 1) * nu)) = u_seg;
+    casadi::SX residual = g_fun(casadi::SXVector{w_seg, p})[0](casadi::Slice(0, P * nx));
+
+    casadi::SX seg_param = casadi::SX::vertcat({x_ini, u_seg, p});
+    casadi::Function segment = casadi::rootfinder(name + "_segment", "newton",
+                                                  casadi::Function(name + "_segment_residual", {z, seg_param}, {residual}));
+    casadi::Function segments = segment.map(S, parallelization);
+
+    /** outer variables: boundary states (node b * P), all controls */
+    casadi::MX xb   = casadi::MX::sym("xb", (S + 1) * nx);
+    casadi::MX u    = casadi::MX::sym("u", num_nodes * nu);
+    casadi::MX p_mx = casadi::MX::sym("p", n_p);
+    casadi::MX z_guess = casadi::MX::sym("z_guess", N * nx);
+
+    casadi::MXVector seg_params;
+    for(int s = 0; s < S; ++s)
+        seg_params.push_back(casadi::MX::vertcat({xb(casadi::Slice((s + 1) * nx, (s + 2) * nx)),
+                                                  u(casadi::Slice(s * P * nu, (s * P + P + 1) * nu)), p_mx}));
+    casadi::MX Z = segments(casadi::MXVector{casadi::MX::reshape(z_guess, P * nx, S), casadi::MX::horzcat(seg_params)})[0];
+
+    /** segment s provides the nodes sP..sP+P-1, the initial state is the last boundary */
+    casadi::MX x_full = casadi::MX::vertcat({casadi::MX::vec(Z), xb(casadi::Slice(S * nx, (S + 1) * nx))});
+    casadi::MX w_full = casadi::MX::vertcat({x_full, u});
+
+    /** bounded components of the eliminated states stay as inequality constraints */
+    std::vector<casadi_int> box_idx, bnd_idx, cont_rows, extra_rows;
+    std::vector<double> lbx_nz = casadi::DM::densify(lbx).nonzeros();
+    std::vector<double> ubx_nz = casadi::DM::densify(ubx).nonzeros();
+    for(int k = 0; k < num_nodes; ++k)
+    {
+        for(int i = 0; i < nx; ++i)
+        {
+            casadi_int idx = k * nx + i;
+            if(k % P == 0)
+                bnd_idx.push_back(idx);
+            else if(std::isfinite(lbx_nz[idx]) || std::isfinite(ubx_nz[idx]))
+                box_idx.push_back(idx);
+        }
+    }
+    for(int s = 0; s < S; ++s)
+        for(int i = 0; i < nx; ++i)
+            cont_rows.push_back(s * P * nx + i);
+    for(casadi_int r = N * nx; r < n_g; ++r)
+        extra_rows.push_back(r);
+
+    std::vector<casadi_int> outer_idx = bnd_idx;
+    for(casadi_int k = num_nodes * nx; k < n_w; ++k)
+        outer_idx.push_back(k);
+
+    casadi::MX S_outer(selection_matrix(outer_idx, n_w));
+    casadi::MX S_box(selection_matrix(box_idx, n_w));
+    casadi::MX S_cont(selection_matrix(cont_rows, n_g));
+    casadi::MX S_extra(selection_matrix(extra_rows, n_g));
+    const casadi_int n_cont  = cont_rows.size();
+    const casadi_int n_extra = extra_rows.size();
+
+    casadi::MX g_cont = xb(casadi::Slice(0, S * nx)) - casadi::MX::vec(Z(casadi::Slice(0, nx), casadi::Slice()));
+    casadi::MX g_box  = casadi::MX::mtimes(S_box, w_full);
+    casadi::MX g_extra = casadi::MX::mtimes(S_extra, g_fun(casadi::MXVector{w_full, p_mx})[0]);
+
+    casadi::MX v     = casadi::MX::vertcat({xb, u});
+    casadi::MX p_red = casadi::MX::vertcat({p_mx, z_guess});
+    casadi::MXDict reduced_nlp = {{"x", v}, {"p", p_red},
+                                  {"f", f_fun(casadi::MXVector{w_full, p_mx})[0]},
+                                  {"g", casadi::MX::vertcat({g_cont, g_extra, g_box})}};
+    result.reduced = casadi::nlpsol(name + "_reduced", solver, reduced_nlp, solver_opts);
+    casadi::Function expand(name + "_expand", {v, p_red}, {w_full});
+
+    /** collocation Jacobian and Lagrangian gradient without the collocation rows, w.r.t. the condensed nodes */
+    casadi::SX g_sx     = g_fun(casadi::SXVector{w, p})[0];
+    casadi::SX w_coll   = w(casadi::Slice(0, N * nx));
+    casadi::SX lam_e    = casadi::SX::sym("lam_extra", n_g - N * nx);
+    casadi::SX lag_rest = nlp.at("f") + casadi::SX::dot(lam_e, g_sx(casadi::Slice(N * nx, n_g)));
+    casadi::Function jac_coll(name + "_jac_coll", {w, p}, {casadi::SX::jacobian(g_sx(casadi::Slice(0, N * nx)), w_coll)});
+    casadi::Function grad_rest(name + "_grad_rest", {w, p, lam_e}, {casadi::SX::gradient(lag_rest, w_coll)});
+
+    /** full-layout wrapper: restrict the arguments, solve, expand the solution and the multipliers */
+    casadi::MXDict in;
+    in["x0"]     = casadi::MX::sym("x0", n_w);
+    in["p"]      = casadi::MX::sym("p", n_p);
+    in["lbx"]    = casadi::MX::sym("lbx", n_w);
+    in["ubx"]    = casadi::MX::sym("ubx", n_w);
+    in["lbg"]    = casadi::MX::sym("lbg", n_g);
+    in["ubg"]    = casadi::MX::sym("ubg", n_g);
+    in["lam_x0"] = casadi::MX::sym("lam_x0", n_w);
+    in["lam_g0"] = casadi::MX::sym("lam_g0", n_g);
+
+    casadi::MX p_arg = casadi::MX::vertcat({in["p"], in["x0"](casadi::Slice(0, N * nx))});
+    casadi::MXDict sol = result.reduced(casadi::MXDict{
+            {"x0",     casadi::MX::mtimes(S_outer, in["x0"])},
+            {"p",      p_arg},
+            {"lbx",    casadi::MX::mtimes(S_outer, in["lbx"])},
+            {"ubx",    casadi::MX::mtimes(S_outer, in["ubx"])},
+            {"lbg",    casadi::MX::vertcat({casadi::MX::mtimes(S_cont, in["lbg"]), casadi::MX::mtimes(S_extra, in["lbg"]),
+                                            casadi::MX::mtimes(S_box, in["lbx"])})},
+            {"ubg",    casadi::MX::vertcat({casadi::MX::mtimes(S_cont, in["ubg"]), casadi::MX::mtimes(S_extra, in["ubg"]),
+                                            casadi::MX::mtimes(S_box, in["ubx"])})},
+            {"lam_x0", casadi::MX::mtimes(S_outer, in["lam_x0"])},
+            {"lam_g0", casadi::MX::vertcat({casadi::MX::mtimes(S_cont, in["lam_g0"]), casadi::MX::mtimes(S_extra, in["lam_g0"]),
+                                            casadi::MX::mtimes(S_box, in["lam_x0"])})}});
+
+    casadi::MX lam_extra = sol["lam_g"](casadi::Slice(n_cont, n_cont + n_extra));
+    casadi::MX lam_box   = sol["lam_g"](casadi::Slice(n_cont + n_extra, sol["lam_g"].size1()));
+
+    casadi::MXDict out;
+    out["x"]     = expand(casadi::MXVector{sol["x"], p_arg})[0];
+    out["f"]     = sol["f"];
+    out["g"]     = g_fun(casadi::MXVector{out["x"], in["p"]})[0];
+    out["lam_x"] = casadi::MX::mtimes(S_outer.T(), sol["lam_x"]) + casadi::MX::mtimes(S_box.T(), lam_box);
+
+    /** multipliers of the collocation rows (eliminated by the condensation): stationarity of the full Lagrangian in
+     *  the condensed nodes 0..N-1, J_c' lam_c = -(grad f + J_extra' lam_extra + lam_x), an adjoint solve with the
+     *  collocation Jacobian (block bidiagonal, its diagonal blocks are the segment rootfinder Jacobians) */
+    casadi::MX lam_coll = casadi::MX::solve(jac_coll(casadi::MXVector{out["x"], in["p"]})[0].T(),
+                                            -(grad_rest(casadi::MXVector{out["x"], in["p"], lam_extra})[0] +
+                                              out["lam_x"](casadi::Slice(0, N * nx))), "qr");
+    out["lam_g"] = casadi::MX::vertcat({lam_coll, lam_extra});
+    out["lam_p"] = sol["lam_p"](casadi::Slice(0, n_p));
+
+    casadi::MXDict io = in;
+    io.insert(out.begin(), out.end());
+    result.solver = casadi::Function(name, io, casadi::nlpsol_in(), casadi::nlpsol_out());
+    return result;
+}
+
+} // polympc namespace
+
+#endif // SEGMENT_CONDENSATION_HPP
@@ -0,0 +1,246 @@
+#ifndef SOLUTION_DATABASE_HPP
+#define SOLUTION_DATABASE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "eigen3/Eigen/Dense"
+#include "kd_tree.hpp"
+
+namespace polympc {
+
+/** Database of converged primal-dual NLP solutions keyed by the (scaled) initial state. Records go into a ring buffer
+ *  of fixed capacity (the oldest record is replaced), a record closer than 'spacing' to a stored key replaces nothing
+ *  and is dropped. Lookups query a KD-tree over the keys, rebuilt lazily after changes (records are frequent, lookups
+ *  happen on cold starts and recoveries), and blend k neighbours with inverse distance weights.
+ *
+ *  Binary file: "PMPCSDB1", int32 key size, primal size, constraint size, int64 number of records, then per record the
+ *  key, w, lam_g and lam_x as doubles in the byte order of the machine. */
+class SolutionDatabase
+{
+public:
+    SolutionDatabase() : m_capacity(0), m_nk(0), m_nw(0), m_ng(0), m_next(0), m_spacing(0), m_dirty(false) {}
+    ~SolutionDatabase(){}
+
+    /** capacity 0 disables the database, records of other sizes are rejected; records of the same sizes are kept
+     *  (the newest ones if they exceed the capacity), e.g. when the problem is rebuilt */
+    void init(const int &capacity, const int &key_size, const int &primal_size, const int &constraint_size,
+              const double &spacing = 0);
+    bool enabled() const {return m_capacity > 0;}
+    int size() const {return static_cast<int>(m_keys.size());}
+    void clear();
+
+    void insert(const Eigen::VectorXd &key, const Eigen::VectorXd &w, const Eigen::VectorXd &lam_g, const Eigen::VectorXd &lam_x);
+
+    /** blend of the k nearest records, false for an empty database */
+    bool lookup(const Eigen::VectorXd &key, const int &k, Eigen::VectorXd &w, Eigen::VectorXd &lam_g, Eigen::VectorXd &lam_x);
+
+    bool save(const std::string &fname) const;
+    /** appends the records of the file (the newest ones if they exceed the capacity), false for a disabled database */
+    bool load(const std::string &fname);
+
+private:
+    int m_capacity, m_nk, m_nw, m_ng;
+    int m_next;
+    double m_spacing;
+
+    std::vector<Eigen::VectorXd> m_keys, m_w, m_lam_g, m_lam_x;
+
+    KDTree<> m_tree;
+    bool m_dirty;
+    std::vector<int> m_neighbours;
+    std::vector<double> m_dist2;
+
+    void rebuild();
+};
+
+inline void SolutionDatabase::init(const int &capacity, const int &key_size, const int &primal_size,
+                                   const int &constraint_size, const double &spacing)
+{
+    /** the stored records, oldest first */
+    std::vector<Eigen::VectorXd> keys, w, lam_g, lam_x;
+    if((key_size == m_nk) && (primal_size == m_nw) && (constraint_size == m_ng))
+    {
+        const int count = size();
+        for(int n = 0; n < count; ++n)
+        {
+            const int j = (count < m_capacity) ? n : (m_next + n) % count;
+            keys.push_back(m_keys[j]);
+            w.push_back(m_w[j]);
+            lam_g.push_back(m_lam_g[j]);
+            lam_x.push_back(m_lam_x[j]);
+        }
+    }
+
+    m_capacity = std::max(0, capacity);
+    m_nk = key_size;
+    m_nw = primal_size;
+    m_ng = constraint_size;
+    m_spacing = spacing;
+    clear();
+
+    for(std::size_t n = 0; n < keys.size(); ++n)
+        insert(keys[n], w[n], lam_g[n], lam_x[n]);
+}
+
+inline void SolutionDatabase::clear()
+{
+    m_keys.clear();
+    m_w.clear();
+    m_lam_g.clear();
+    m_lam_x.clear();
+    m_next = 0;
+    m_dirty = true;
+}
+
+inline void SolutionDatabase::rebuild()
+{
+    Eigen::MatrixXd keys(m_nk, m_keys.size());
+    for(std::size_t j = 0; j < m_keys.size(); ++j)
+        keys.col(j) = m_keys[j];
+    m_tree.build(keys);
+    m_dirty = false;
+}
+
+inline void SolutionDatabase::insert(const Eigen::VectorXd &key, const Eigen::VectorXd &w, const Eigen::VectorXd &lam_g,
+                                     const Eigen::VectorXd &lam_x)
+{
+    if(!enabled() || key.size() != m_nk || w.size() != m_nw || lam_g.size() != m_ng || lam_x.size() != m_nw)
+        return;
+
+    /** a linear scan: the tree may be outdated and inserts must stay cheap */
+    if(m_spacing > 0)
+    {
+        for(std::size_t j = 0; j < m_keys.size(); ++j)
+            if((m_keys[j] - key).squaredNorm() < m_spacing * m_spacing)
+                return;
+    }
+
+    if(size() < m_capacity)
+    {
+        m_keys.push_back(key);
+        m_w.push_back(w);
+        m_lam_g.push_back(lam_g);
+        m_lam_x.push_back(lam_x);
+    }
+    else
+    {
+        m_keys[m_next]  = key;
+        m_w[m_next]     = w;
+        m_lam_g[m_next] = lam_g;
+        m_lam_x[m_next] = lam_x;
+        m_next = (m_next + 1) % m_capacity;
+    }
+    m_dirty = true;
+}
+
+inline bool SolutionDatabase::lookup(const Eigen::VectorXd &key, const int &k, Eigen::VectorXd &w, Eigen::VectorXd &lam_g,
+                                     Eigen::VectorXd &lam_x)
+{
+    if(!enabled() || m_keys.empty() || key.size() != m_nk)
+        return false;
+    if(m_dirty)
+        rebuild();
+
+    int count = m_tree.nearest(key, std::max(1, k), m_neighbours, m_dist2);
+
+    /** inverse distance weights, an exact match is taken as is */
+    w = Eigen::VectorXd::Zero(m_nw);
+    lam_g = Eigen::VectorXd::Zero(m_ng);
+    lam_x = Eigen::VectorXd::Zero(m_nw);
+    double total = 0;
+    for(int j = 0; j < count; ++j)
+    {
+        double weight = (m_dist2[0] < 1e-24) ? ((j == 0) ? 1.0 : 0.0) : 1.0 / std::sqrt(m_dist2[j]);
+        w     += weight * m_w[m_neighbours[j]];
+        lam_g += weight * m_lam_g[m_neighbours[j]];
+        lam_x += weight * m_lam_x[m_neighbours[j]];
+        total += weight;
+    }
+    w /= total;
+    lam_g /= total;
+    lam_x /= total;
+    return true;
+}
+
+inline bool SolutionDatabase::save(const std::string &fname) const
+{
+    std::ofstream file(fname, std::ios::binary);
+    if(!file.is_open())
+    {
+        std::cout << "SolutionDatabase: could not write " << fname << "\n";
+        return false;
+    }
+
+    /** oldest record first, a reload keeps the replacement order */
+    const std::int32_t sizes[3] = {m_nk, m_nw, m_ng};
+    const std::int64_t count = m_keys.size();
+    file.write("PMPCSDB1", 8);
+    file.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for(std::int64_t n = 0; n < count; ++n)
+    {
+        const int j = (static_cast<int>(count) < m_capacity) ? n : (m_next + n) % count;
+        file.write(reinterpret_cast<const char*>(m_keys[j].data()), m_nk * sizeof(double));
+        file.write(reinterpret_cast<const char*>(m_w[j].data()), m_nw * sizeof(double));
+        file.write(reinterpret_cast<const char*>(m_lam_g[j].data()), m_ng * sizeof(double));
+        file.write(reinterpret_cast<const char*>(m_lam_x[j].data()), m_nw * sizeof(double));
+    }
+    return file.good();
+}
+
+inline bool SolutionDatabase::load(const std::string &fname)
+{
+    if(!enabled())
+    {
+        std::cout << "SolutionDatabase: the database is disabled (capacity 0), " << fname << " is not loaded \n";
+        return false;
+    }
+
+    std::ifstream file(fname, std::ios::binary);
+    if(!file.is_open())
+    {
+        std::cout << "SolutionDatabase: could not read " << fname << "\n";
+        return false;
+    }
+
+    char magic[8];
+    std::int32_t sizes[3];
+    std::int64_t count = 0;
+    file.read(magic, 8);
+    file.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if(!file.good() || std::memcmp(magic, "PMPCSDB1", 8) != 0 || count < 0)
+    {
+        std::cout << "SolutionDatabase: " << fname << " is not a solution database \n";
+        return false;
+    }
+    if(sizes[0] != m_nk || sizes[1] != m_nw || sizes[2] != m_ng)
+    {
+        std::cout << "SolutionDatabase: " << fname << " belongs to a problem of another size \n";
+        return false;
+    }
+
+    Eigen::VectorXd key(m_nk), w(m_nw), lam_g(m_ng), lam_x(m_nw);
+    for(std::int64_t n = 0; n < count; ++n)
+    {
+        file.read(reinterpret_cast<char*>(key.data()), m_nk * sizeof(double));
+        file.read(reinterpret_cast<char*>(w.data()), m_nw * sizeof(double));
+        file.read(reinterpret_cast<char*>(lam_g.data()), m_ng * sizeof(double));
+        file.read(reinterpret_cast<char*>(lam_x.data()), m_nw * sizeof(double));
+        if(!file.good())
+        {
+            std::cout << "SolutionDatabase: " << fname << " is truncated \n";
+            return false;
+        }
+        insert(key, w, lam_g, lam_x);
+    }
+    return true;
+}
+
+} // polympc namespace
+
+#endif // SOLUTION_DATABASE_HPP
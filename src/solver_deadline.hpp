@@ -0,0 +1,124 @@
+#ifndef SOLVER_DEADLINE_HPP
+#define SOLVER_DEADLINE_HPP
+
+#include "casadi/casadi.hpp"
+#include <chrono>
+#include <limits>
+
+namespace polympc {
+
+/** outcome of a deadline-bounded solve */
+enum SolveStatus
+{
+    SOLVE_SUCCESS,  /** solver converged */
+    SOLVE_ITERATE,  /** stopped early or failed: best feasible iterate */
+    SOLVE_SHIFTED,  /** no feasible iterate: time-shifted previous solution */
+    SOLVE_FAILED    /** no fallback available: raw solver output */
+};
+
+/** NLP iteration callback enforcing a wall-clock deadline. Interior point iterates satisfy the variable bounds,
+ *  so an iterate is feasible once the constraint residual is below 'tolerance'; the one with the lowest cost is kept.
+ *  The solver (and this callback) may be shared by several controllers and BatchController workers: the state of a
+ *  solve lives in a Session owned by the caller, start() binds it to the calling thread for the next solve. */
+class DeadlineCallback : public casadi::Callback
+{
+public:
+    /** deadline state and best feasible iterate of one solve */
+    struct Session
+    {
+        Session() : budget(0), expired(false), best_f(std::numeric_limits<double>::infinity()) {}
+
+        double budget;
+        std::chrono::steady_clock::time_point start;
+        bool   expired;
+        double best_f;
+        casadi::DM x, lam_x, lam_g;
+
+        bool has_iterate() const {return best_f < std::numeric_limits<double>::infinity();}
+    };
+
+    DeadlineCallback(const std::string &name, const casadi_int &nx, const casadi_int &ng, const casadi_int &np,
+                     const casadi::DM &lbg, const casadi::DM &ubg, const double &tolerance = 1e-6) :
+        m_nx(nx), m_ng(ng), m_np(np), m_lbg(lbg), m_ubg(ubg), m_tolerance(tolerance)
+    {
+        construct(name, casadi::Dict());
+    }
+    ~DeadlineCallback(){}
+
+    /** arm the deadline of the next solve on this thread, 'budget' <= 0 only records feasible iterates */
+    static void start(Session &session, const double &budget)
+    {
+        session.budget  = budget;
+        session.start   = std::chrono::steady_clock::now();
+        session.expired = false;
+        session.best_f  = std::numeric_limits<double>::infinity();
+        active() = &session;
+    }
+
+    /** unbind the session of this thread after the solve */
+    static void stop() {active() = nullptr;}
+
+    casadi_int get_n_in() override {return casadi::nlpsol_n_out();}
+    casadi_int get_n_out() override {return 1;}
+    std::string get_name_in(casadi_int i) override {return casadi::nlpsol_out(i);}
+    std::string get_name_out(casadi_int i) override {return "ret";}
+
+    casadi::Sparsity get_sparsity_in(casadi_int i) override
+    {
+        std::string name = casadi::nlpsol_out(i);
+        if(name == "f")
+            return casadi::Sparsity::scalar();
+        else if(name == "x" || name == "lam_x")
+            return casadi::Sparsity::dense(m_nx);
+        else if(name == "g" || name == "lam_g")
+            return casadi::Sparsity::dense(m_ng);
+        else
+            return casadi::Sparsity::dense(m_np);
+    }
+
+    /** returning a nonzero value requests the solver to stop, without a session the solve is not bounded */
+    std::vector<casadi::DM> eval(const std::vector<casadi::DM> &arg) const override
+    {
+        Session *session = active();
+        if(!session)
+            return {casadi::DM(0)};
+
+        const casadi::DM &g = arg.at(casadi::nlpsol_out("g"));
+        double f = static_cast<double>(arg.at(casadi::nlpsol_out("f")));
+
+        double violation = 0;
+        if(m_ng > 0)
+            violation = static_cast<double>(casadi::DM::mmax(casadi::DM::vertcat({m_lbg - g, g - m_ubg, casadi::DM(0)})));
+
+        if((violation < m_tolerance) && (f < session->best_f))
+        {
+            session->best_f = f;
+            session->x      = arg.at(casadi::nlpsol_out("x"));
+            session->lam_x  = arg.at(casadi::nlpsol_out("lam_x"));
+            session->lam_g  = arg.at(casadi::nlpsol_out("lam_g"));
+        }
+
+        if(session->budget > 0)
+        {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - session->start).count();
+            session->expired = (elapsed > session->budget);
+        }
+        return {casadi::DM(session->expired ? 1 : 0)};
+    }
+
+private:
+    casadi_int m_nx, m_ng, m_np;
+    casadi::DM m_lbg, m_ubg;
+    double     m_tolerance;
+
+    /** session of the solve running on this thread */
+    static Session*& active()
+    {
+        static thread_local Session *session = nullptr;
+        return session;
+    }
+};
+
+} // polympc namespace
+
+#endif // SOLVER_DEADLINE_HPP
@@ -0,0 +1,110 @@
+#ifndef SOLVER_REGISTRY_HPP
+#define SOLVER_REGISTRY_HPP
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace polympc {
+
+/** Process-wide deduplication of immutable solver cores. Instances hold the core through a shared_ptr,
+ *  the registry only keeps weak references: a core is released with the last instance using it. Lookups do not
+ *  wait for builds: a request for a key that is being built waits for that build. The builds themselves are
+ *  serialized by one process-wide mutex, CasADi symbolic construction (and the shared Chebyshev tables) is not
+ *  thread-safe */
+template<typename Core>
+class SolverRegistry
+{
+public:
+    typedef std::function<std::shared_ptr<Core>()> factory_t;
+
+    /** shared core for 'key', built with 'factory' if no live instance holds one; an exception of the factory
+     *  reaches every caller waiting for the key */
+    static std::shared_ptr<const Core> get(const std::string &key, const factory_t &factory)
+    {
+        typedef std::shared_future<std::shared_ptr<const Core>> future_t;
+
+        std::unique_lock<std::mutex> lock(mutex());
+        Entry &entry = registry()[key];
+        std::shared_ptr<const Core> core = entry.core.lock();
+        if(core)
+            return core;
+
+        if(entry.pending.valid())
+        {
+            future_t pending = entry.pending;
+            lock.unlock();
+            return pending.get();
+        }
+
+        /** map entries stay in place, 'entry' is valid after relocking */
+        std::promise<std::shared_ptr<const Core>> promise;
+        entry.pending = promise.get_future().share();
+        lock.unlock();
+
+        try
+        {
+            std::lock_guard<std::mutex> build_lock(build_mutex());
+            core = factory();
+        }
+        catch(...)
+        {
+            lock.lock();
+            entry.pending = future_t();
+            lock.unlock();
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+
+        lock.lock();
+        entry.core = core;
+        entry.pending = future_t();
+        lock.unlock();
+        promise.set_value(core);
+        return core;
+    }
+
+    /** number of live cores */
+    static int size()
+    {
+        std::lock_guard<std::mutex> lock(mutex());
+        int count = 0;
+        for(const auto &entry : registry())
+            count += entry.second.core.expired() ? 0 : 1;
+        return count;
+    }
+
+private:
+    /** a live core or the build in progress */
+    struct Entry
+    {
+        std::weak_ptr<const Core> core;
+        std::shared_future<std::shared_ptr<const Core>> pending;
+    };
+
+    static std::map<std::string, Entry>& registry()
+    {
+        static std::map<std::string, Entry> cores;
+        return cores;
+    }
+
+    static std::mutex& mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::mutex& build_mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+};
+
+} // polympc namespace
+
+#endif // SOLVER_REGISTRY_HPP
@@ -0,0 +1,97 @@
+#ifndef SOLVER_WORKSPACE_HPP
+#define SOLVER_WORKSPACE_HPP
+
+#include "casadi/casadi.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace polympc {
+
+/** Preallocated inputs, outputs and work vectors for the low-level (arg, res, iw, w, mem) evaluation
+ *  of a casadi::Function. After init() evaluations do not allocate on the polympc side. */
+class FunctionWorkspace
+{
+public:
+    FunctionWorkspace() : m_mem(-1) {}
+    explicit FunctionWorkspace(const casadi::Function &func) : m_mem(-1) {init(func);}
+    ~FunctionWorkspace(){release();}
+
+    void init(const casadi::Function &func);
+    void release();
+    bool initialized() const {return m_mem >= 0;}
+
+    /** dense nonzero buffers */
+    double* input(const int &idx){return m_in[idx].data();}
+    double* output(const int &idx){return m_out[idx].data();}
+    const double* output(const int &idx) const {return m_out[idx].data();}
+    int nnz_in(const int &idx) const {return static_cast<int>(m_in[idx].size());}
+    int nnz_out(const int &idx) const {return static_cast<int>(m_out[idx].size());}
+
+    int index_in(const std::string &name) const {return static_cast<int>(m_func.index_in(name));}
+    int index_out(const std::string &name) const {return static_cast<int>(m_func.index_out(name));}
+
+    /** copy a DM into an input buffer (nonzeros of the input sparsity) */
+    void set_input(const int &idx, const casadi::DM &value)
+    {
+        const std::vector<double> &nz = value.nonzeros();
+        std::copy(nz.begin(), nz.begin() + std::min(nz.size(), m_in[idx].size()), m_in[idx].begin());
+    }
+
+    /** evaluate the function, returns the CasADi flag (0 on success) */
+    int eval()
+    {
+        return m_func(m_arg.data(), m_res.data(), m_iw.data(), m_w.data(), m_mem);
+    }
+
+    const casadi::Function& function() const {return m_func;}
+
+private:
+    /** not copyable: owns a checked-out memory object */
+    FunctionWorkspace(const FunctionWorkspace&);
+    FunctionWorkspace& operator=(const FunctionWorkspace&);
+
+    casadi::Function m_func;
+    std::vector<std::vector<double>> m_in, m_out;
+    std::vector<const double*> m_arg;
+    std::vector<double*> m_res;
+    std::vector<casadi_int> m_iw;
+    std::vector<double> m_w;
+    int m_mem;
+};
+
+inline void FunctionWorkspace::init(const casadi::Function &func)
+{
+    release();
+    m_func = func;
+
+    m_in.resize(func.n_in());
+    m_out.resize(func.n_out());
+    m_arg.assign(func.sz_arg(), nullptr);
+    m_res.assign(func.sz_res(), nullptr);
+    m_iw.assign(func.sz_iw(), 0);
+    m_w.assign(func.sz_w(), 0);
+
+    for(int i = 0; i < func.n_in(); ++i)
+    {
+        m_in[i].assign(func.nnz_in(i), 0);
+        m_arg[i] = m_in[i].data();
+    }
+    for(int i = 0; i < func.n_out(); ++i)
+    {
+        m_out[i].assign(func.nnz_out(i), 0);
+        m_res[i] = m_out[i].data();
+    }
+
+    m_mem = static_cast<int>(m_func.checkout());
+}
+
+inline void FunctionWorkspace::release()
+{
+    if(m_mem >= 0)
+        m_func.release(m_mem);
+    m_mem = -1;
+}
+
+} // polympc namespace
+
+#endif // SOLVER_WORKSPACE_HPP
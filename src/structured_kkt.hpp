@@ -0,0 +1,398 @@
+#ifndef STRUCTURED_KKT_HPP
+#define STRUCTURED_KKT_HPP
+
+#include <cmath>
+#include <vector>
+#include "eigen3/Eigen/Dense"
+#include "eigen3/Eigen/Sparse"
+#include "eigen3/Eigen/SparseLU"
+
+namespace polympc {
+
+/** Solves the KKT system of a collocated optimal control problem
+ *
+ *  | H + diag(sigma)   J'          | |dw|   |rw|
+ *  | J                 -delta_c I  | |dl| = |rl|
+ *
+ *  The decision vector is [X; U] with NX states and NU controls per node, the constraints are node-major with NX rows
+ *  per node. Variables of the nodes inside a segment and the constraint rows of a segment are eliminated with dense
+ *  factorizations of the segment blocks; the nodes shared by neighbouring segments form a block-tridiagonal Schur
+ *  complement solved by a forward-backward (Riccati-like) recursion. The cost is linear in the number of segments.
+ *  If the sparsity does not follow this structure a general sparse LU of the full KKT matrix is used instead. */
+class StructuredKKT
+{
+public:
+    typedef Eigen::SparseMatrix<double> sparse_t;
+
+    StructuredKKT() : m_num_var(0), m_num_con(0), m_num_seg(0), m_structured(false) {}
+
+    /** set up the partition and check the sparsity patterns of H and J against it */
+    bool init(const int &nx, const int &nu, const int &num_segments, const int &poly_order,
+              const sparse_t &H_pattern, const sparse_t &J_pattern);
+
+    bool structured() const {return m_structured;}
+
+    /** variables marked in 'fixed' get dw = 0, returns false if the factorization failed */
+    bool solve(const sparse_t &H, const sparse_t &J, const Eigen::VectorXd &sigma, const double &delta_c,
+               const std::vector<char> &fixed, const Eigen::VectorXd &rw, const Eigen::VectorXd &rl,
+               Eigen::VectorXd &dw, Eigen::VectorXd &dl);
+
+private:
+    int  m_num_var, m_num_con, m_num_seg;
+    bool m_structured;
+
+    /** owner of a variable: segment s (< num_seg) or boundary node b (num_seg + b), b between segments b and b + 1 */
+    std::vector<int> m_var_owner, m_var_pos;
+    std::vector<int> m_row_seg, m_row_pos;
+    std::vector<int> m_local_size, m_boundary_size;
+
+    /** segment blocks, couplings to the left / right boundary, boundary blocks and boundary-boundary couplings */
+    std::vector<Eigen::MatrixXd> m_A, m_El, m_Er, m_D, m_F;
+    std::vector<Eigen::VectorXd> m_ry, m_rz;
+
+    bool is_boundary(const int &owner) const {return owner >= m_num_seg;}
+    bool admissible(const int &seg, const int &owner) const;
+    bool admissible_hessian(const int &oi, const int &oj) const;
+
+    bool solve_structured(Eigen::VectorXd &dw, Eigen::VectorXd &dl, const std::vector<char> &fixed);
+    bool solve_general(const sparse_t &H, const sparse_t &J, const Eigen::VectorXd &sigma, const double &delta_c,
+                       const std::vector<char> &fixed, const Eigen::VectorXd &rw, const Eigen::VectorXd &rl,
+                       Eigen::VectorXd &dw, Eigen::VectorXd &dl);
+};
+
+/** row of segment 'seg' may touch its own variables and its two boundary nodes */
+inline bool StructuredKKT::admissible(const int &seg, const int &owner) const
+{
+    if(!is_boundary(owner))
+        return owner == seg;
+    int b = owner - m_num_seg;
+    return (b == seg - 1) || (b == seg);
+}
+
+inline bool StructuredKKT::admissible_hessian(const int &oi, const int &oj) const
+{
+    if(!is_boundary(oi))
+        return admissible(oi, oj);
+    if(!is_boundary(oj))
+        return admissible(oj, oi);
+    return std::abs(oi - oj) <= 1;
+}
+
+inline bool StructuredKKT::init(const int &nx, const int &nu, const int &num_segments, const int &poly_order,
+                                const sparse_t &H_pattern, const sparse_t &J_pattern)
+{
+    const int num_nodes = num_segments * poly_order + 1;
+    m_num_var = J_pattern.cols();
+    m_num_con = J_pattern.rows();
+    m_num_seg = num_segments;
+    m_structured = false;
+
+    if((m_num_var != num_nodes * (nx + nu)) || (m_num_con % nx != 0) || (m_num_con / nx > num_nodes))
+        return false;
+
+    /** node k belongs to segment k / poly_order, nodes shared by two segments become boundary blocks */
+    std::vector<int> node_owner(num_nodes);
+    for(int k = 0; k < num_nodes; ++k)
+    {
+        if((k % poly_order == 0) && (k > 0) && (k < num_nodes - 1))
+            node_owner[k] = num_segments + k / poly_order - 1;
+        else
+            node_owner[k] = std::min(k / poly_order, num_segments - 1);
+    }
+
+    m_local_size.assign(num_segments, 0);
+    m_boundary_size.assign(std::max(num_segments - 1, 0), 0);
+    m_var_owner.resize(m_num_var);
+    m_var_pos.resize(m_num_var);
+
+    /** states first, then controls: positions in the blocks follow the decision vector */
+    for(int i = 0; i < m_num_var; ++i)
+    {
+        int node = (i < num_nodes * nx) ? i / nx : (i - num_nodes * nx) / nu;
+        int owner = node_owner[node];
+        m_var_owner[i] = owner;
+        m_var_pos[i] = is_boundary(owner) ? m_boundary_size[owner - num_segments]++ : m_local_size[owner]++;
+    }
+
+    std::vector<int> local_vars = m_local_size;
+    m_row_seg.resize(m_num_con);
+    m_row_pos.resize(m_num_con);
+    for(int r = 0; r < m_num_con; ++r)
+    {
+        int seg = std::min((r / nx) / poly_order, num_segments - 1);
+        m_row_seg[r] = seg;
+        m_row_pos[r] = m_local_size[seg]++;
+    }
+
+    /** the segment blocks are eliminated first: without regularization they are singular if a segment has more
+     *  constraint rows than own variables (low orders with few controls) */
+    for(int s = 0; s < num_segments; ++s)
+        if(m_local_size[s] - local_vars[s] > local_vars[s])
+            return false;
+
+    /** check the sparsity patterns */
+    for(int j = 0; j < H_pattern.outerSize(); ++j)
+        for(sparse_t::InnerIterator it(H_pattern, j); it; ++it)
+            if(!admissible_hessian(m_var_owner[it.row()], m_var_owner[j]))
+                return false;
+
+    for(int j = 0; j < J_pattern.outerSize(); ++j)
+        for(sparse_t::InnerIterator it(J_pattern, j); it; ++it)
+            if(!admissible(m_row_seg[it.row()], m_var_owner[j]))
+                return false;
+
+    m_A.resize(num_segments);
+    m_El.resize(num_segments);
+    m_Er.resize(num_segments);
+    m_ry.resize(num_segments);
+    for(int s = 0; s < num_segments; ++s)
+    {
+        m_A[s].resize(m_local_size[s], m_local_size[s]);
+        m_El[s].resize(m_local_size[s], (s > 0) ? m_boundary_size[s - 1] : 0);
+        m_Er[s].resize(m_local_size[s], (s < num_segments - 1) ? m_boundary_size[s] : 0);
+        m_ry[s].resize(m_local_size[s]);
+    }
+
+    const int num_bnd = static_cast<int>(m_boundary_size.size());
+    m_D.resize(num_bnd);
+    m_F.resize(num_bnd);
+    m_rz.resize(num_bnd);
+    for(int b = 0; b < num_bnd; ++b)
+    {
+        m_D[b].resize(m_boundary_size[b], m_boundary_size[b]);
+        m_F[b].resize(m_boundary_size[b], (b + 1 < num_bnd) ? m_boundary_size[b + 1] : 0);
+        m_rz[b].resize(m_boundary_size[b]);
+    }
+
+    m_structured = true;
+    return true;
+}
+
+inline bool StructuredKKT::solve(const sparse_t &H, const sparse_t &J, const Eigen::VectorXd &sigma, const double &delta_c,
+                                 const std::vector<char> &fixed, const Eigen::VectorXd &rw, const Eigen::VectorXd &rl,
+                                 Eigen::VectorXd &dw, Eigen::VectorXd &dl)
+{
+    if(!m_structured)
+        return solve_general(H, J, sigma, delta_c, fixed, rw, rl, dw, dl);
+
+    for(int s = 0; s < m_num_seg; ++s)
+    {
+        m_A[s].setZero();
+        m_El[s].setZero();
+        m_Er[s].setZero();
+    }
+    for(int b = 0; b < static_cast<int>(m_D.size()); ++b)
+    {
+        m_D[b].setZero();
+        m_F[b].setZero();
+    }
+
+    /** Hessian: the local rows carry the couplings, boundary rows follow by symmetry */
+    for(int j = 0; j < H.outerSize(); ++j)
+    {
+        if(fixed[j])
+            continue;
+        const int oj = m_var_owner[j];
+        const int pj = m_var_pos[j];
+        for(sparse_t::InnerIterator it(H, j); it; ++it)
+        {
+            const int i = it.row();
+            if(fixed[i])
+                continue;
+            const int oi = m_var_owner[i];
+            const int pi = m_var_pos[i];
+
+            if(!is_boundary(oi))
+            {
+                if(!is_boundary(oj))
+                    m_A[oi](pi, pj) += it.value();
+                else if(oj - m_num_seg == oi - 1)
+                    m_El[oi](pi, pj) += it.value();
+                else
+                    m_Er[oi](pi, pj) += it.value();
+            }
+            else if(is_boundary(oj))
+            {
+                if(oi == oj)
+                    m_D[oi - m_num_seg](pi, pj) += it.value();
+                else if(oj == oi + 1)
+                    m_F[oi - m_num_seg](pi, pj) += it.value();
+            }
+        }
+    }
+
+    /** constraint Jacobian and its transpose */
+    for(int j = 0; j < J.outerSize(); ++j)
+    {
+        if(fixed[j])
+            continue;
+        const int oj = m_var_owner[j];
+        const int pj = m_var_pos[j];
+        for(sparse_t::InnerIterator it(J, j); it; ++it)
+        {
+            const int s  = m_row_seg[it.row()];
+            const int pr = m_row_pos[it.row()];
+            if(!is_boundary(oj))
+            {
+                m_A[s](pr, pj) += it.value();
+                m_A[s](pj, pr) += it.value();
+            }
+            else if(oj - m_num_seg == s - 1)
+                m_El[s](pr, pj) += it.value();
+            else
+                m_Er[s](pr, pj) += it.value();
+        }
+    }
+
+    /** diagonals and right hand side */
+    for(int i = 0; i < m_num_var; ++i)
+    {
+        const int oi = m_var_owner[i];
+        const int pi = m_var_pos[i];
+        const double diag  = fixed[i] ? 1.0 : sigma[i];
+        const double value = fixed[i] ? 0.0 : rw[i];
+        if(is_boundary(oi))
+        {
+            m_D[oi - m_num_seg](pi, pi) += diag;
+            m_rz[oi - m_num_seg][pi] = value;
+        }
+        else
+        {
+            m_A[oi](pi, pi) += diag;
+            m_ry[oi][pi] = value;
+        }
+    }
+    for(int r = 0; r < m_num_con; ++r)
+    {
+        m_A[m_row_seg[r]](m_row_pos[r], m_row_pos[r]) -= delta_c;
+        m_ry[m_row_seg[r]][m_row_pos[r]] = rl[r];
+    }
+
+    if(solve_structured(dw, dl, fixed))
+        return true;
+
+    /** a singular segment block (e.g. a rank-deficient local Jacobian): the general factorization decides */
+    return solve_general(H, J, sigma, delta_c, fixed, rw, rl, dw, dl);
+}
+
+inline bool StructuredKKT::solve_structured(Eigen::VectorXd &dw, Eigen::VectorXd &dl, const std::vector<char> &fixed)
+{
+    const int num_bnd = static_cast<int>(m_D.size());
+
+    /** eliminate the segment blocks */
+    std::vector<Eigen::MatrixXd> Xl(m_num_seg), Xr(m_num_seg);
+    std::vector<Eigen::VectorXd> xr(m_num_seg);
+    for(int s = 0; s < m_num_seg; ++s)
+    {
+        Eigen::PartialPivLU<Eigen::MatrixXd> lu(m_A[s]);
+        if(!(lu.rcond() > 1e-14))
+            return false;
+        xr[s] = lu.solve(m_ry[s]);
+        Xl[s] = lu.solve(m_El[s]);
+        Xr[s] = lu.solve(m_Er[s]);
+    }
+
+    /** block-tridiagonal Schur complement on the boundary nodes: forward recursion */
+    std::vector<Eigen::MatrixXd> U(num_bnd);
+    std::vector<Eigen::VectorXd> rho(num_bnd);
+    std::vector<Eigen::PartialPivLU<Eigen::MatrixXd>> M(num_bnd);
+    for(int b = 0; b < num_bnd; ++b)
+    {
+        Eigen::MatrixXd T = m_D[b] - m_Er[b].transpose() * Xr[b] - m_El[b + 1].transpose() * Xl[b + 1];
+        rho[b] = m_rz[b] - m_Er[b].transpose() * xr[b] - m_El[b + 1].transpose() * xr[b + 1];
+        if(b + 1 < num_bnd)
+            U[b] = m_F[b] - m_El[b + 1].transpose() * Xr[b + 1];
+
+        if(b > 0)
+        {
+            T      -= U[b - 1].transpose() * M[b - 1].solve(U[b - 1]);
+            rho[b] -= U[b - 1].transpose() * M[b - 1].solve(rho[b - 1]);
+        }
+        M[b].compute(T);
+        if(!(M[b].rcond() > 1e-14))
+            return false;
+    }
+
+    /** backward recursion */
+    std::vector<Eigen::VectorXd> z(num_bnd);
+    for(int b = num_bnd - 1; b >= 0; --b)
+    {
+        if(b == num_bnd - 1)
+            z[b] = M[b].solve(rho[b]);
+        else
+            z[b] = M[b].solve(rho[b] - U[b] * z[b + 1]);
+    }
+
+    /** recover the segment unknowns */
+    dw.resize(m_num_var);
+    dl.resize(m_num_con);
+    for(int s = 0; s < m_num_seg; ++s)
+    {
+        if(s > 0)
+            xr[s] -= Xl[s] * z[s - 1];
+        if(s < m_num_seg - 1)
+            xr[s] -= Xr[s] * z[s];
+    }
+    for(int i = 0; i < m_num_var; ++i)
+    {
+        const int oi = m_var_owner[i];
+        dw[i] = fixed[i] ? 0.0 : (is_boundary(oi) ? z[oi - m_num_seg][m_var_pos[i]] : xr[oi][m_var_pos[i]]);
+    }
+    for(int r = 0; r < m_num_con; ++r)
+        dl[r] = xr[m_row_seg[r]][m_row_pos[r]];
+
+    return dw.allFinite() && dl.allFinite();
+}
+
+inline bool StructuredKKT::solve_general(const sparse_t &H, const sparse_t &J, const Eigen::VectorXd &sigma, const double &delta_c,
+                                         const std::vector<char> &fixed, const Eigen::VectorXd &rw, const Eigen::VectorXd &rl,
+                                         Eigen::VectorXd &dw, Eigen::VectorXd &dl)
+{
+    const int n = H.cols();
+    const int m = J.rows();
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(H.nonZeros() + 2 * J.nonZeros() + n + m);
+
+    for(int j = 0; j < H.outerSize(); ++j)
+        for(sparse_t::InnerIterator it(H, j); it; ++it)
+            if(!fixed[it.row()] && !fixed[j])
+                triplets.push_back(Eigen::Triplet<double>(it.row(), j, it.value()));
+
+    for(int j = 0; j < J.outerSize(); ++j)
+    {
+        if(fixed[j])
+            continue;
+        for(sparse_t::InnerIterator it(J, j); it; ++it)
+        {
+            triplets.push_back(Eigen::Triplet<double>(n + it.row(), j, it.value()));
+            triplets.push_back(Eigen::Triplet<double>(j, n + it.row(), it.value()));
+        }
+    }
+
+    Eigen::VectorXd rhs(n + m);
+    for(int i = 0; i < n; ++i)
+    {
+        triplets.push_back(Eigen::Triplet<double>(i, i, fixed[i] ? 1.0 : sigma[i]));
+        rhs[i] = fixed[i] ? 0.0 : rw[i];
+    }
+    for(int r = 0; r < m; ++r)
+        triplets.push_back(Eigen::Triplet<double>(n + r, n + r, -delta_c));
+    rhs.tail(m) = rl;
+
+    sparse_t K(n + m, n + m);
+    K.setFromTriplets(triplets.begin(), triplets.end());
+
+    Eigen::SparseLU<sparse_t> lu;
+    lu.compute(K);
+    if(lu.info() != Eigen::Success)
+        return false;
+
+    Eigen::VectorXd sol = lu.solve(rhs);
+    dw = sol.head(n);
+    dl = sol.tail(m);
+    return dw.allFinite() && dl.allFinite();
+}
+
+} // polympc namespace
+
+#endif // STRUCTURED_KKT_HPP
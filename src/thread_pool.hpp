@@ -0,0 +1,121 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace polympc {
+
+/** Fixed set of worker threads executing indexed batches. Tasks are claimed from a shared atomic counter,
+ *  so a worker that finishes early immediately takes the next pending task */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(const int &num_threads = 0);
+    ~ThreadPool();
+
+    int size() const {return static_cast<int>(m_threads.size());}
+
+    /** run task(i, worker_id) for i in [0, num_tasks), returns when all tasks are done */
+    void run(const int &num_tasks, const std::function<void(int, int)> &task);
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    std::vector<std::thread> m_threads;
+    std::mutex               m_mutex;
+    std::condition_variable  m_start, m_done;
+
+    std::function<void(int, int)> m_task;
+    int                      m_num_tasks;
+    std::atomic<int>         m_next;
+    int                      m_active;
+    unsigned                 m_generation;
+    bool                     m_stop;
+    std::exception_ptr       m_error;
+
+    void worker(const int id);
+};
+
+inline ThreadPool::ThreadPool(const int &num_threads) :
+    m_num_tasks(0), m_next(0), m_active(0), m_generation(0), m_stop(false)
+{
+    int n = (num_threads > 0) ? num_threads : static_cast<int>(std::thread::hardware_concurrency());
+    n = (n > 0) ? n : 1;
+    for(int i = 0; i < n; ++i)
+        m_threads.push_back(std::thread(&ThreadPool::worker, this, i));
+}
+
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for(std::thread &thread : m_threads)
+        thread.join();
+}
+
+inline void ThreadPool::run(const int &num_tasks, const std::function<void(int, int)> &task)
+{
+    if(num_tasks <= 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_task      = task;
+    m_num_tasks = num_tasks;
+    m_next      = 0;
+    m_active    = size();
+    m_error     = std::exception_ptr();
+    ++m_generation;
+    m_start.notify_all();
+
+    m_done.wait(lock, [this]{return m_active == 0;});
+    m_task = std::function<void(int, int)>();
+    if(m_error)
+        std::rethrow_exception(m_error);
+}
+
+inline void ThreadPool::worker(const int id)
+{
+    unsigned generation = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [&]{return m_stop || (m_generation != generation);});
+            if(m_stop)
+                return;
+            generation = m_generation;
+        }
+
+        for(int i = m_next++; i < m_num_tasks; i = m_next++)
+        {
+            try
+            {
+                m_task(i, id);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(!m_error)
+                    m_error = std::current_exception();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_active == 0)
+            m_done.notify_all();
+    }
+}
+
+} // polympc namespace
+
+#endif // THREAD_POOL_HPP